@@ -27,6 +27,9 @@
 #ifndef _CRT_SECURE_NO_WARNINGS
 #define _CRT_SECURE_NO_WARNINGS
 #endif
+#include <atomic>
+#include <cstdlib>
+#include <new>
 #include "gtest/gtest.h"
 #include "tiny_dnn/tiny_dnn.h"
 
@@ -36,6 +39,8 @@ using namespace tiny_dnn::activation;
 #include "test_serialization.h"
 #endif
 #include "test_network.h"
+#include "test_activation.h"
+#include "test_dataset.h"
 #include "test_average_pooling_layer.h"
 // TODO(yida): fix broken test
 //#include "test_average_unpooling_layer.h"
@@ -46,6 +51,7 @@ using namespace tiny_dnn::activation;
 #include "test_convolutional_layer.h"
 #include "test_target_cost.h"
 #include "test_large_thread_count.h"
+#include "test_parallel_for.h"
 #include "test_lrn_layer.h"
 #include "test_batch_norm_layer.h"
 #include "test_nodes.h"
@@ -68,6 +74,42 @@ using namespace tiny_dnn::activation;
 #include "test_tensor.h"
 #include "test_image.h"
 
+// counting replacement of the global allocator, see count_allocations
+static std::atomic<bool>   count_enabled(false);
+static std::atomic<size_t> allocation_count(0);
+
+void* operator new(std::size_t size) {
+    if (count_enabled) allocation_count++;
+    void* p = std::malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpragmas"
+// operator new above is a malloc, gcc doesn't know after inlining
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+namespace tiny_dnn {
+
+size_t count_allocations(const std::function<void()>& f) {
+    allocation_count = 0;
+    count_enabled = true;
+    f();
+    count_enabled = false;
+    return allocation_count;
+}
+
+} // namespace tiny_dnn
+
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
@@ -0,0 +1,180 @@
+/*
+    Copyright (c) 2016, Taiga Nomi
+    All rights reserved.
+    
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY 
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY 
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND 
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS 
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+#include "gtest/gtest.h"
+#include "testhelper.h"
+#include "tiny_dnn/tiny_dnn.h"
+
+namespace tiny_dnn {
+
+TEST(activation, vectorized_math) {
+    // covers the polynomial ranges, the saturated ranges and the scalar tail
+    vec_t x;
+    for (float_t v = -30; v <= 30; v += float_t(0.0137)) x.push_back(v);
+    vec_t y(x.size());
+
+    vectorize::exp(&x[0], x.size(), &y[0]);
+    for (size_t i = 0; i < x.size(); i++) {
+        EXPECT_NEAR(float_t(1), y[i] / std::exp(x[i]), 1e-6);
+    }
+
+    vectorize::tanh(&x[0], x.size(), &y[0]);
+    for (size_t i = 0; i < x.size(); i++) {
+        EXPECT_NEAR(std::tanh(x[i]), y[i], 1e-6);
+    }
+
+    vectorize::sigmoid(&x[0], x.size(), &y[0]);
+    for (size_t i = 0; i < x.size(); i++) {
+        EXPECT_NEAR(float_t(1) / (float_t(1) + std::exp(-x[i])), y[i], 1e-6);
+    }
+}
+
+TEST(activation, cpu_dispatch) {
+    // every instruction set the cpu offers must match the portable path
+    // (without CNN_USE_RUNTIME_DISPATCH all runs take the compiled path)
+    const size_t n = 37, M = 5, N = 19, K = 23;
+    vec_t a(n), b(n), x(M * K), w(K * N);
+    uniform_rand(a.begin(), a.end(), -2.0, 2.0);
+    uniform_rand(b.begin(), b.end(), -2.0, 2.0);
+    uniform_rand(x.begin(), x.end(), -1.0, 1.0);
+    uniform_rand(w.begin(), w.end(), -1.0, 1.0);
+
+    struct result {
+        float_t dot;
+        vec_t muladd, reduce, exp, tanh, sigmoid, gemm;
+    };
+    auto run = [&]() {
+        result r;
+        r.dot = vectorize::dot(&a[0], &b[0], n);
+        r.muladd = b;
+        vectorize::muladd(&a[0], float_t(0.5), n, &r.muladd[0]);
+        r.reduce = b;
+        vectorize::reduce(&a[0], n, &r.reduce[0]);
+        r.exp = r.tanh = r.sigmoid = vec_t(n);
+        vectorize::exp(&a[0], n, &r.exp[0]);
+        vectorize::tanh(&a[0], n, &r.tanh[0]);
+        vectorize::sigmoid(&a[0], n, &r.sigmoid[0]);
+        r.gemm = vec_t(M * N, float_t(0));
+        kernels::gemm(M, N, K,
+            [&](size_t i, size_t k) { return x[i * K + k]; },
+            [&](size_t k, size_t j) { return w[k * N + j]; },
+            [&](size_t i) { return &r.gemm[i * N]; },
+            false);
+        return r;
+    };
+
+    const cpu_isa detected = detected_cpu_isa();
+    const cpu_isa active = active_cpu_isa();
+    set_cpu_isa(cpu_isa::generic);
+    const result ref = run();
+
+    const cpu_isa levels[] = { cpu_isa::sse2, cpu_isa::avx,
+                               cpu_isa::avx2, cpu_isa::avx512 };
+    for (cpu_isa isa : levels) {
+        if (isa > detected) break;
+        set_cpu_isa(isa);
+        const result r = run();
+        EXPECT_NEAR(ref.dot, r.dot, 1e-4) << to_string(isa);
+        for (size_t i = 0; i < n; i++) {
+            EXPECT_NEAR(ref.muladd[i], r.muladd[i], 1e-5) << to_string(isa);
+            EXPECT_NEAR(ref.reduce[i], r.reduce[i], 1e-5) << to_string(isa);
+            EXPECT_NEAR(float_t(1), r.exp[i] / ref.exp[i], 1e-6) << to_string(isa);
+            EXPECT_NEAR(ref.tanh[i], r.tanh[i], 1e-6) << to_string(isa);
+            EXPECT_NEAR(ref.sigmoid[i], r.sigmoid[i], 1e-6) << to_string(isa);
+        }
+        for (size_t i = 0; i < M * N; i++) {
+            EXPECT_NEAR(ref.gemm[i], r.gemm[i], 1e-4) << to_string(isa);
+        }
+    }
+    set_cpu_isa(active);
+}
+
+TEST(activation, itef_matches_f) {
+    vec_t a(37);
+    uniform_rand(a.begin(), a.end(), -5.0, 5.0);
+
+    std::vector<std::shared_ptr<activation::function>> functions = {
+        std::make_shared<activation::identity>(),
+        std::make_shared<activation::sigmoid>(),
+        std::make_shared<activation::relu>(),
+        std::make_shared<activation::leaky_relu>(),
+        std::make_shared<activation::elu>(),
+        std::make_shared<activation::softmax>(),
+        std::make_shared<activation::tan_h>(),
+        std::make_shared<activation::tan_hp1m2>()
+    };
+
+    for (const auto& h : functions) {
+        vec_t expected(a.size()), actual(a.size());
+        for (size_t i = 0; i < a.size(); i++) expected[i] = h->f(a, i);
+        h->itef(actual, a, a.size());
+        EXPECT_TRUE(is_near_container(expected, actual, float_t(1e-6)));
+
+        // itedf against the Jacobian rows of df(y, i)
+        vec_t dy(a.size()), dx(a.size());
+        uniform_rand(dy.begin(), dy.end(), -1.0, 1.0);
+        h->itedf(dx, dy, actual, a.size());
+        for (size_t c = 0; c < a.size(); c++) {
+            vec_t row = h->df(actual, c);
+            float_t v = float_t(0);
+            for (size_t i = 0; i < a.size(); i++) v += dy[i] * row[i];
+            EXPECT_NEAR(v, dx[c], 1e-6);
+        }
+    }
+}
+
+TEST(activation, fused_epilogue) {
+    fully_connected_layer<softmax> fc(20, 10);
+    convolutional_layer<tan_h> conv(6, 6, 3, 2, 3);
+    fc.init_weight();
+    conv.init_weight();
+
+    vec_t in_fc(20), in_conv(6 * 6 * 2);
+    uniform_rand(in_fc.begin(), in_fc.end(), -1.0, 1.0);
+    uniform_rand(in_conv.begin(), in_conv.end(), -1.0, 1.0);
+
+    fc.forward({ { in_fc } });
+    conv.forward({ { in_conv } });
+
+    // outputs are the activation of the pre-activation values
+    const vec_t& fc_a   = (*fc.outputs()[1]->get_data())[0];
+    const vec_t& fc_out = (*fc.outputs()[0]->get_data())[0];
+    float_t sum = float_t(0);
+    for (size_t i = 0; i < fc_a.size(); i++) {
+        EXPECT_NEAR(activation::softmax().f(fc_a, i), fc_out[i], 1e-6);
+        sum += fc_out[i];
+    }
+    EXPECT_NEAR(float_t(1), sum, 1e-5);
+
+    const vec_t& conv_a   = (*conv.outputs()[1]->get_data())[0];
+    const vec_t& conv_out = (*conv.outputs()[0]->get_data())[0];
+    for (size_t i = 0; i < conv_a.size(); i++) {
+        EXPECT_NEAR(std::tanh(conv_a[i]), conv_out[i], 1e-6);
+    }
+}
+
+} // namespace tiny_dnn
@@ -142,6 +142,39 @@ TEST(ave_pool, forward_stride) {
     }
 }
 
+TEST(ave_pool, backward_stride) {
+    // overlapping windows accumulate into the input gradient
+    average_pooling_layer<identity> l(4, 4, 1, 2, 1);
+    vec_t in(16, float_t(1));
+
+    vec_t out_grad = {
+        4, 4, 4,
+        4, 4, 4,
+        4, 4, 4
+    };
+
+    vec_t in_grad_expected = {
+        1, 2, 2, 1,
+        2, 4, 4, 2,
+        2, 4, 4, 2,
+        1, 2, 2, 1
+    };
+
+    l.weight_init(weight_init::constant(1.0));
+    l.bias_init(weight_init::constant(0.0));
+    l.init_weight();
+
+    EXPECT_EQ(serial_size_t(4), l.fan_in_size());
+    EXPECT_EQ(serial_size_t(4), l.fan_out_size());
+
+    l.forward({ { in } });
+    vec_t in_grad = l.backward(std::vector<tensor_t>{ {out_grad}})[0][0];
+
+    for (size_t i = 0; i < in_grad.size(); i++) {
+        EXPECT_FLOAT_EQ(in_grad_expected[i], in_grad[i]);
+    }
+}
+
 TEST(ave_pool, read_write) {
     average_pooling_layer<tan_h> l1(100, 100, 5, 2);
     average_pooling_layer<tan_h> l2(100, 100, 5, 2);
@@ -490,6 +490,66 @@ TEST(convolutional, bprop_avx_wstride) {
 
 #endif // CNN_USE_AVX
 
+// avx backend with general kernel shapes (falls back to internal when
+// no avx kernel is compiled in)
+inline void check_avx_matches_internal(convolutional_layer<sigmoid>& l) {
+    tensor_buf data(l), fwd1(l, false), fwd2(l, false), grad1(l);
+    tensor_buf grad2(grad1);
+
+    l.set_backend_type(core::backend_t::internal);
+    l.forward_propagation(data.in_buf(), fwd1.out_buf());
+    l.back_propagation(data.in_buf(), fwd1.out_buf(), grad1.out_buf(), grad1.in_buf());
+
+    l.set_backend_type(core::backend_t::avx);
+    l.forward_propagation(data.in_buf(), fwd2.out_buf());
+    l.back_propagation(data.in_buf(), fwd2.out_buf(), grad2.out_buf(), grad2.in_buf());
+
+    vec_t& out_internal = fwd1.out_at(0)[0];
+    vec_t& out_avx = fwd2.out_at(0)[0];
+    for (size_t i = 0; i < out_avx.size(); i++) {
+        EXPECT_NEAR(out_avx[i], out_internal[i], 1E-5);
+    }
+
+    // input, weight and bias gradients
+    for (size_t ch = 0; ch < l.in_channels(); ch++) {
+        vec_t& grad_internal = grad1.in_at(ch)[0];
+        vec_t& grad_avx = grad2.in_at(ch)[0];
+        for (size_t i = 0; i < grad_avx.size(); i++) {
+            EXPECT_NEAR(grad_avx[i], grad_internal[i], 1E-4);
+        }
+    }
+}
+
+TEST(convolutional, avx_1x1) {
+    convolutional_layer<sigmoid> l(19, 5, 1, 6, 9, padding::valid, true, 1, 1);
+    check_avx_matches_internal(l);
+
+    convolutional_layer<sigmoid> l2(19, 6, 1, 6, 5, padding::valid, true, 2, 2);
+    check_avx_matches_internal(l2);
+}
+
+TEST(convolutional, avx_3x3) {
+    bool tbl[6 * 3] = {
+        true, false, true, true, false, true,
+        false, true, false, true, true, false,
+        true, true, false, false, true, true };
+
+    convolutional_layer<sigmoid> l(21, 7, 3, 3, 6, connection_table(tbl, 3, 6),
+                                   padding::same, true, 1, 1);
+    check_avx_matches_internal(l);
+
+    convolutional_layer<sigmoid> l2(40, 9, 3, 3, 5, padding::valid, true, 2, 2);
+    check_avx_matches_internal(l2);
+}
+
+TEST(convolutional, avx_7x7) {
+    convolutional_layer<sigmoid> l(43, 12, 7, 2, 5, padding::same, true, 2, 1);
+    check_avx_matches_internal(l);
+
+    convolutional_layer<sigmoid> l2(30, 10, 7, 3, 4, padding::valid, true, 3, 2);
+    check_avx_matches_internal(l2);
+}
+
 #ifdef CNN_USE_NNPACK
 TEST(convolutional, fprop_nnp) {
 
@@ -716,6 +776,137 @@ TEST(convolutional, gradient_check12_pad_same) { // sigmoid - mse - padding same
 		epsilon<float_t>(), GRAD_CHECK_ALL));
 }
 
+TEST(convolutional, fprop_gemm) {
+    bool tbl[4 * 3] = {
+        true, false, true, true,
+        false, true, false, true,
+        true, true, false, false };
+
+    convolutional_layer<sigmoid> l(9, 8, 3, 2, 3, 4, connection_table(tbl, 3, 4),
+                                   padding::valid, true, 2, 1);
+
+    tensor_buf buf(l), buf2(l);
+
+    l.set_backend_type(tiny_dnn::core::backend_t::internal);
+    l.forward_propagation(buf.in_buf(), buf.out_buf());
+
+    l.set_backend_type(tiny_dnn::core::backend_t::gemm);
+    l.forward_propagation(buf.in_buf(), buf2.out_buf());
+
+    vec_t& out_gemm = buf2.out_at(0)[0];
+    vec_t& out_internal = buf.out_at(0)[0];
+
+    for (size_t i = 0; i < out_gemm.size(); i++) {
+        EXPECT_NEAR(out_gemm[i], out_internal[i], 1E-5);
+    }
+}
+
+TEST(convolutional, bprop_gemm) {
+    bool tbl[4 * 3] = {
+        true, false, true, true,
+        false, true, false, true,
+        true, true, false, false };
+
+    convolutional_layer<sigmoid> l(9, 8, 3, 2, 3, 4, connection_table(tbl, 3, 4),
+                                   padding::valid, true, 2, 1);
+
+    tensor_buf data(l), grad1(l);
+    tensor_buf grad2(grad1);
+
+    l.set_backend_type(tiny_dnn::core::backend_t::internal);
+    l.forward_propagation(data.in_buf(), data.out_buf());
+    l.back_propagation(data.in_buf(), data.out_buf(), grad1.out_buf(), grad1.in_buf());
+
+    l.set_backend_type(tiny_dnn::core::backend_t::gemm);
+    l.forward_propagation(data.in_buf(), data.out_buf());
+    l.back_propagation(data.in_buf(), data.out_buf(), grad2.out_buf(), grad2.in_buf());
+
+    // input, weight and bias gradients
+    for (size_t ch = 0; ch < l.in_channels(); ch++) {
+        vec_t& out_internal = grad1.in_at(ch)[0];
+        vec_t& out_gemm = grad2.in_at(ch)[0];
+        for (size_t i = 0; i < out_gemm.size(); i++) {
+            EXPECT_NEAR(out_gemm[i], out_internal[i], 1E-5);
+        }
+    }
+}
+
+TEST(convolutional, gradient_check13_gemm) { // sigmoid - mse - gemm backend
+    network<sequential> nn;
+    bool tbl[3 * 3] = {
+        true, false, true,
+        false, true, false,
+        true, true, false };
+
+    connection_table connections(tbl, 3, 3);
+
+    nn << convolutional_layer<sigmoid>(7, 6, 3, 3, 3, connections, padding::same,
+                                       true, 2, 1, core::backend_t::gemm);
+
+    const auto test_data = generate_gradient_check_data(nn.in_data_size());
+    nn.init_weight();
+    EXPECT_TRUE(nn.gradient_check<mse>(test_data.first,
+        test_data.second,
+        epsilon<float_t>(), GRAD_CHECK_ALL));
+}
+
+TEST(convolutional, fprop_winograd) {
+    bool tbl[4 * 3] = {
+        true, false, true, true,
+        false, true, false, true,
+        true, true, false, false };
+
+    // odd output size, so that the last row/column of 2x2 tiles is partial
+    convolutional_layer<identity> l(11, 8, 3, 3, 4, connection_table(tbl, 3, 4),
+                                    padding::valid, true, 1, 1);
+
+    tensor_buf buf(l), buf2(l);
+
+    for (int iter = 0; iter < 2; iter++) {
+        // the second pass checks that filter transforms follow weight updates
+        if (iter == 1) randomize_tensor(buf.in_at(1));
+
+        l.set_backend_type(tiny_dnn::core::backend_t::internal);
+        l.forward_propagation(buf.in_buf(), buf.out_buf());
+
+        l.set_backend_type(tiny_dnn::core::backend_t::gemm);
+        l.forward_propagation(buf.in_buf(), buf2.out_buf());
+
+        vec_t& out_winograd = buf.out_at(0)[0];
+        vec_t& out_gemm = buf2.out_at(0)[0];
+
+        for (size_t i = 0; i < out_gemm.size(); i++) {
+            EXPECT_NEAR(out_winograd[i], out_gemm[i], 1E-5);
+        }
+    }
+}
+
+TEST(convolutional, fprop_winograd_cached_filters) {
+    network<sequential> net;
+    net << convolutional_layer<identity>(6, 6, 3, 2, 2, padding::same);
+    net.init_weight();
+
+    vec_t in(6 * 6 * 2);
+    uniform_rand(in.begin(), in.end(), -1.0f, 1.0f);
+
+    for (int iter = 0; iter < 3; iter++) {
+        // the transformed filters are rebuilt after writes through weights()
+        if (iter == 2) {
+            for (auto& w : *net[0]->weights()[0]) w = -w;
+        }
+
+        net[0]->set_backend_type(core::backend_t::internal);
+        const vec_t out_winograd = net.predict(in);
+
+        net[0]->set_backend_type(core::backend_t::gemm);
+        const vec_t out_gemm = net.predict(in);
+
+        for (size_t i = 0; i < out_gemm.size(); i++) {
+            EXPECT_NEAR(out_winograd[i], out_gemm[i], 1E-5);
+        }
+    }
+}
+
 TEST(convolutional, read_write)
 {
     convolutional_layer<tan_h> l1(5, 5, 3, 1, 1);
@@ -77,6 +77,49 @@ device_t device_type(size_t *platform, size_t *device) {
     device_t device = device_t::NONE;
 #endif  // defined(USE_OPENCL) || defined(USE_CUDA)
 
+TEST(core, steady_state_without_allocation) {
+    network<sequential> net;
+    net << convolutional_layer<tan_h>(12, 12, 3, 2, 4, padding::same)
+        << max_pooling_layer<relu>(12, 12, 4, 2)
+        << convolutional_layer<tan_h>(6, 6, 1, 4, 4)  // 1x1 takes the gemm path
+        << convolutional_layer<tan_h>(6, 6, 3, 4, 6)
+        << fully_connected_layer<softmax>(96, 10);
+    net.init_weight();
+
+    vec_t in(12 * 12 * 2);
+    uniform_rand(in.begin(), in.end(), -1.0, 1.0);
+
+    auto forward = [&]() {
+        for (size_t i = 0; i < net.depth(); i++) net[i]->forward();
+    };
+    auto backward = [&]() {
+        for (size_t i = net.depth(); i > 0; i--) net[i - 1]->backward();
+    };
+
+    auto check = [&]() {
+        // the first passes size the buffers, build the contexts and fill
+        // the per-thread scratch buffers of the kernels
+        net.predict(in);
+        for (int i = 0; i < 8; i++) {
+            forward();
+            backward();
+        }
+        EXPECT_EQ(count_allocations(forward), 0u);
+        EXPECT_EQ(count_allocations(backward), 0u);
+    };
+
+    // layers run in parallel by default
+    check();
+
+#if !defined(CNN_USE_TBB) && !defined(CNN_USE_OMP) && !defined(CNN_SINGLE_THREAD)
+    // also with worker threads, whatever the core count of the machine
+    const size_t prev = num_threads();
+    set_num_threads(4);
+    check();
+    set_num_threads(prev);
+#endif
+}
+
 /*
 TEST(core, platforms_and_devices) {
     // Since Singleton has a general state,
@@ -0,0 +1,154 @@
+/*
+    Copyright (c) 2016, Taiga Nomi
+    All rights reserved.
+    
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY 
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY 
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND 
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS 
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+#include <fstream>
+#include "gtest/gtest.h"
+#include "testhelper.h"
+#include "tiny_dnn/tiny_dnn.h"
+
+namespace tiny_dnn {
+
+inline void write_u32_be(std::ofstream& ofs, uint32_t v) {
+    const char bytes[4] = { char(v >> 24), char(v >> 16), char(v >> 8), char(v) };
+    ofs.write(bytes, 4);
+}
+
+// n images of 3x2 pixels, pixel p of image i = (i * 6 + p) * 10, label i % 10
+inline void write_mnist(const std::string& images, const std::string& labels, uint32_t n) {
+    std::ofstream img(images.c_str(), std::ios::binary);
+    write_u32_be(img, 0x00000803);
+    write_u32_be(img, n);
+    write_u32_be(img, 2);  // rows
+    write_u32_be(img, 3);  // cols
+    for (uint32_t i = 0; i < n; i++)
+        for (uint32_t p = 0; p < 6; p++) img.put(char((i * 6 + p) * 10 % 256));
+
+    std::ofstream lbl(labels.c_str(), std::ios::binary);
+    write_u32_be(lbl, 0x00000801);
+    write_u32_be(lbl, n);
+    for (uint32_t i = 0; i < n; i++) lbl.put(char(i % 10));
+}
+
+TEST(dataset, mnist) {
+    const std::string images = unique_path(), labels = unique_path();
+    write_mnist(images, labels, 5);
+
+    std::vector<vec_t> parsed;
+    std::vector<label_t> parsed_labels;
+    parse_mnist_images(images, &parsed, -1.0f, 1.0f, 1, 2);
+    parse_mnist_labels(labels, &parsed_labels);
+
+    ASSERT_EQ(5u, parsed.size());
+    ASSERT_EQ(5u, parsed_labels.size());
+    for (size_t i = 0; i < parsed.size(); i++) {
+        EXPECT_EQ(label_t(i % 10), parsed_labels[i]);
+        ASSERT_EQ(size_t(5 * 6), parsed[i].size());
+        for (size_t y = 0; y < 6; y++) {
+            for (size_t x = 0; x < 5; x++) {
+                float_t expected = float_t(-1);
+                if (x >= 1 && x < 4 && y >= 2 && y < 4) {
+                    const size_t p = (y - 2) * 3 + (x - 1);
+                    expected = float_t((i * 6 + p) * 10 % 256) / 255 * 2 - 1;
+                }
+                EXPECT_NEAR(expected, parsed[i][y * 5 + x], 1e-6);
+            }
+        }
+    }
+
+    // random access gives the same images
+    mnist_dataset data(images, labels, -1.0f, 1.0f, 1, 2);
+    EXPECT_EQ(shape3d(5, 6, 1), data.shape());
+    vec_t img;
+    data.image(3, &img);
+    EXPECT_EQ(parsed[3], img);
+    EXPECT_EQ(label_t(3), data.label(3));
+
+    std::remove(images.c_str());
+    std::remove(labels.c_str());
+}
+
+TEST(dataset, cifar10) {
+    const std::string path = unique_path();
+    {
+        std::ofstream ofs(path.c_str(), std::ios::binary);
+        for (int i = 0; i < 3; i++) {
+            ofs.put(char(7 - i));
+            for (int p = 0; p < CIFAR10_IMAGE_SIZE; p++) ofs.put(char((p + i) % 256));
+        }
+        ofs.put(char(1));  // truncated record is ignored
+    }
+
+    std::vector<vec_t> images;
+    std::vector<label_t> labels;
+    parse_cifar10(path, &images, &labels, 0.0f, 1.0f, 0, 0);
+
+    ASSERT_EQ(3u, images.size());
+    for (int i = 0; i < 3; i++) {
+        EXPECT_EQ(label_t(7 - i), labels[i]);
+        ASSERT_EQ(size_t(CIFAR10_IMAGE_SIZE), images[i].size());
+        for (int p = 0; p < CIFAR10_IMAGE_SIZE; p += 97) {
+            EXPECT_NEAR(float_t((p + i) % 256) / 255, images[i][p], 1e-6);
+        }
+    }
+    std::remove(path.c_str());
+}
+
+TEST(dataset, image_batch_source) {
+    const std::string images = unique_path(), labels = unique_path();
+    write_mnist(images, labels, 10);
+    mnist_dataset data(images, labels);
+
+    image_batch_source src(data, 4, 10, 0.0f, 1.0f, true, 1);
+    EXPECT_EQ(3u, src.batch_count());
+
+    // one epoch covers every sample once, with one-hot targets
+    src.begin_epoch(0);
+    std::vector<int> seen(10, 0);
+    minibatch batch;
+    for (size_t b = 0; b < src.batch_count(); b++) {
+        src.make_batch(b, &batch);
+        for (size_t i = 0; i < batch.size(); i++) {
+            const size_t label = std::max_element(batch.target[i][0].begin(),
+                batch.target[i][0].end()) - batch.target[i][0].begin();
+            vec_t expected;
+            data.image(label, &expected);  // label i % 10 == i here
+            EXPECT_EQ(expected, batch.in[i][0]);
+            seen[label]++;
+        }
+    }
+    EXPECT_EQ(std::vector<int>(10, 1), seen);
+
+    network<sequential> net;
+    net << fully_connected_layer<softmax>(6, 10);
+    adagrad opt;
+    EXPECT_TRUE(net.fit<mse>(opt, src, 2, nop, nop));
+
+    std::remove(images.c_str());
+    std::remove(labels.c_str());
+}
+
+} // namespace tiny_dnn
@@ -177,4 +177,85 @@ TEST(fully_connected, forward_nobias)
     }
 }
 
+TEST(fully_connected, gemm_matches_internal)
+{
+    const serial_size_t in_dim = 37, out_dim = 53, batch = 7;
+
+    fully_connected_layer<identity> l1(in_dim, out_dim, true, core::backend_t::internal);
+    fully_connected_layer<identity> l2(in_dim, out_dim, true, core::backend_t::gemm);
+
+    l1.setup(true);
+    l2.setup(false);
+    *l2.weights()[0] = *l1.weights()[0];
+    uniform_rand(l1.weights()[1]->begin(), l1.weights()[1]->end(), -1.0f, 1.0f);
+    *l2.weights()[1] = *l1.weights()[1];
+
+    tensor_t in(batch, vec_t(in_dim)), grad(batch, vec_t(out_dim));
+    for (auto& v : in) uniform_rand(v.begin(), v.end(), -1.0f, 1.0f);
+    for (auto& v : grad) uniform_rand(v.begin(), v.end(), -1.0f, 1.0f);
+
+    tensor_t out1 = l1.forward({ in })[0];
+    tensor_t out2 = l2.forward({ in })[0];
+    for (serial_size_t i = 0; i < batch; i++) {
+        EXPECT_TRUE(is_near_container(out1[i], out2[i], float_t(1e-4)));
+    }
+
+    std::vector<tensor_t> g1 = l1.backward({ grad, grad });
+    std::vector<tensor_t> g2 = l2.backward({ grad, grad });
+
+    // input gradients are per-sample
+    for (serial_size_t i = 0; i < batch; i++) {
+        EXPECT_TRUE(is_near_container(g1[0][i], g2[0][i], float_t(1e-4)));
+    }
+
+    // weight/bias gradients are compared after reduction over the slots
+    for (size_t k = 1; k < 3; k++) {
+        vec_t sum1(g1[k][0].size()), sum2(g2[k][0].size());
+        for (auto& slot : g1[k]) {
+            vectorize::reduce<float_t>(&slot[0], sum1.size(), &sum1[0]);
+        }
+        for (auto& slot : g2[k]) {
+            vectorize::reduce<float_t>(&slot[0], sum2.size(), &sum2[0]);
+        }
+        EXPECT_TRUE(is_near_container(sum1, sum2, float_t(1e-4)));
+    }
+}
+
+TEST(fully_connected, gemm_splits_single_tile) {
+    // one output tile (batch x out fits MC x NC) is still spread over
+    // the threads; the result must not depend on it
+    const size_t M = 3, N = 100, K = 300;
+    vec_t a(M * K), b(K * N);
+    uniform_rand(a.begin(), a.end(), -1.0f, 1.0f);
+    uniform_rand(b.begin(), b.end(), -1.0f, 1.0f);
+
+    auto run = [&](bool parallelize) {
+        vec_t c(M * N, float_t(0));
+        kernels::gemm(M, N, K,
+            [&](size_t i, size_t k) { return a[i * K + k]; },
+            [&](size_t k, size_t j) { return b[k * N + j]; },
+            [&](size_t i) { return &c[i * N]; },
+            parallelize);
+        return c;
+    };
+
+    const vec_t serial = run(false);
+#if !defined(CNN_USE_TBB) && !defined(CNN_USE_OMP) && !defined(CNN_SINGLE_THREAD)
+    const size_t threads = num_threads();
+    set_num_threads(4);
+    EXPECT_TRUE(is_near_container(serial, run(true), float_t(0)));
+    set_num_threads(threads);
+#endif
+    EXPECT_TRUE(is_near_container(serial, run(true), float_t(0)));
+}
+
+TEST(fully_connected, gradient_check_gemm) {
+    network<sequential> nn;
+    nn << fully_connected_layer<tan_h>(50, 10, true, core::backend_t::gemm);
+
+    const auto test_data = generate_gradient_check_data(nn.in_data_size());
+    nn.init_weight();
+    EXPECT_TRUE(nn.gradient_check<mse>(test_data.first, test_data.second, epsilon<float_t>(), GRAD_CHECK_ALL));
+}
+
 } // namespace tiny-dnn
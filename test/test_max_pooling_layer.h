@@ -283,6 +283,88 @@ TEST(max_pool, backward) {
     }
 }
 
+TEST(max_pool, backward_stride) {
+    // overlapping windows route the gradient of each of them
+    max_pooling_layer<identity> l(4, 4, 1, 2, 1);
+    vec_t in = {
+        0, 1, 2, 3,
+        8, 7, 5, 6,
+        4, 3, 1, 2,
+        0,-1,-2,-3
+    };
+
+    vec_t out_grad = {
+        1, 2, 3,
+        4, 5, 6,
+        7, 8, 9
+    };
+
+    vec_t in_grad_expected = {
+        0,  0, 0,  0,
+        5,  7, 0,  9,
+        7,  8, 0,  9,
+        0,  0, 0,  0
+    };
+
+    l.forward({ {in} });
+    vec_t in_grad = l.backward(std::vector<tensor_t>{ {out_grad}})[0][0];
+
+    for (size_t i = 0; i < in_grad.size(); i++) {
+        EXPECT_FLOAT_EQ(in_grad_expected[i], in_grad[i]);
+    }
+}
+
+#ifdef CNN_USE_AVX
+TEST(max_pool, avx_equals_internal) {
+    max_pooling_layer<identity> l1(13, 11, 3, 3, 3, 2, 2, padding::same,
+                                   core::backend_t::internal);
+    max_pooling_layer<identity> l2(13, 11, 3, 3, 3, 2, 2, padding::same,
+                                   core::backend_t::avx);
+    vec_t in(13 * 11 * 3);
+    uniform_rand(in.begin(), in.end(), -1.0, 1.0);
+    // plateaus of equal values, as produced by a preceding relu
+    for (size_t i = 0; i < in.size(); i += 3) in[i] = float_t(0);
+
+    vec_t out_grad(l1.out_shape()[0].size());
+    uniform_rand(out_grad.begin(), out_grad.end(), -1.0, 1.0);
+
+    vec_t res1 = l1.forward({ { in } })[0][0];
+    vec_t res2 = l2.forward({ { in } })[0][0];
+    for (size_t i = 0; i < res1.size(); i++) {
+        EXPECT_FLOAT_EQ(res1[i], res2[i]);
+    }
+
+    vec_t grad1 = l1.backward(std::vector<tensor_t>{ {out_grad}})[0][0];
+    vec_t grad2 = l2.backward(std::vector<tensor_t>{ {out_grad}})[0][0];
+    for (size_t i = 0; i < grad1.size(); i++) {
+        EXPECT_FLOAT_EQ(grad1[i], grad2[i]);
+    }
+}
+
+TEST(max_pool, avx_ties_take_first_in_row_major_order) {
+    // every 2x2 window is [[0, 1], [1, 0]]: the maximum is taken from (1, 0)
+    const serial_size_t w = 18;
+    vec_t in(w * 2);
+    for (serial_size_t x = 0; x < w; x++) {
+        in[x]     = float_t(x % 2);
+        in[w + x] = float_t(1 - x % 2);
+    }
+    vec_t out_grad(w / 2, float_t(1));
+    vec_t expected(w * 2, float_t(0));
+    for (serial_size_t x = 1; x < w; x += 2) expected[x] = float_t(1);
+
+    for (auto backend : { core::backend_t::internal, core::backend_t::avx }) {
+        max_pooling_layer<identity> l(w, 2, 1, 2, 2, 2, 2, padding::valid,
+                                      backend);
+        l.forward({ { in } });
+        vec_t in_grad = l.backward(std::vector<tensor_t>{ { out_grad } })[0][0];
+        for (size_t i = 0; i < in_grad.size(); i++) {
+            EXPECT_FLOAT_EQ(expected[i], in_grad[i]);
+        }
+    }
+}
+#endif
+
 #ifndef CNN_NO_SERIALIZATION
 TEST(max_pool, serialization) {
     max_pooling_layer<identity> src(4, 4, 1, 2);
@@ -306,8 +306,72 @@ TEST(network, test) {
     }
 }
 
+TEST(network, test_batched) {
+    network<sequential> net;
+    net << fully_connected_layer<tan_h>(10, 16)
+        << fully_connected_layer<tan_h>(16, 4);
+    net.init_weight();
+
+    std::vector<vec_t> in;
+    std::vector<label_t> t;
+    for (int i = 0; i < 203; i++) {
+        vec_t v(10);
+        uniform_rand(v.begin(), v.end(), -1.0, 1.0);
+        in.push_back(v);
+        t.push_back(label_t(i % 4));
+    }
+
+    result expected;
+    for (size_t i = 0; i < in.size(); i++) {
+        const label_t predicted = net.predict_label(in[i]);
+        if (predicted == t[i]) expected.num_success++;
+        expected.num_total++;
+        expected.confusion_matrix[predicted][t[i]]++;
+    }
+
+    for (size_t batch_size : { 1, 7, 64, 500 }) {
+        result r = net.test(in, t, batch_size);
+        EXPECT_EQ(r.num_success, expected.num_success);
+        EXPECT_EQ(r.num_total, expected.num_total);
+        EXPECT_EQ(r.confusion_matrix, expected.confusion_matrix);
+
+        std::vector<vec_t> out = net.test(in, batch_size);
+        ASSERT_EQ(out.size(), in.size());
+        for (size_t i = 0; i < in.size(); i++) {
+            vec_t single = net.predict(in[i]);
+            for (size_t j = 0; j < single.size(); j++)
+                EXPECT_NEAR(out[i][j], single[j], 1E-5);
+        }
+    }
+
+    EXPECT_THROW(net.test(in, t, 0), nn_error);
+}
+
 TEST(network, get_loss) {
-    // TODO: add unit-test for public api
+    network<sequential> net;
+    net << fully_connected_layer<tan_h>(10, 3);
+    net.init_weight();
+
+    std::vector<vec_t> in, t;
+    std::vector<tensor_t> t_tensor;
+    for (int i = 0; i < 150; i++) {
+        vec_t v(10), target(3);
+        uniform_rand(v.begin(), v.end(), -1.0, 1.0);
+        uniform_rand(target.begin(), target.end(), -1.0, 1.0);
+        in.push_back(v);
+        t.push_back(target);
+        t_tensor.push_back(tensor_t{ target });
+    }
+
+    float_t expected = float_t(0);
+    for (size_t i = 0; i < in.size(); i++)
+        expected += mse::f(net.predict(in[i]), t[i]);
+
+    for (size_t batch_size : { 1, 8, 64, 1000 }) {
+        EXPECT_NEAR(net.get_loss<mse>(in, t, batch_size), expected, 1E-3);
+        EXPECT_NEAR(net.get_loss<mse>(in, t_tensor, batch_size), expected, 1E-3);
+    }
+    EXPECT_NEAR(net.get_loss<mse>(in, t), expected, 1E-3);
 }
 
 TEST(network, at) {
@@ -654,4 +718,677 @@ TEST(network, trainable) {
     EXPECT_NE(w2, w2_after_update);
 }
 
+TEST(network, inference_only) {
+    network<sequential> net;
+    net << convolutional_layer<tan_h>(6, 6, 3, 1, 2, padding::same)
+        << fully_connected_layer<softmax>(6 * 6 * 2, 3);
+
+    std::vector<vec_t> data;
+    std::vector<label_t> label;
+    for (int i = 0; i < 8; i++) {
+        data.push_back(vec_t(6 * 6, float_t(i) * float_t(0.1)));
+        label.push_back(static_cast<label_t>(i % 3));
+    }
+
+    adagrad opt;
+    net.train<mse>(opt, data, label, 4, 1);
+    const vec_t expected = net.predict(data[1]);
+
+    EXPECT_GT(net.set_inference_only(), 0u);
+
+    const vec_t actual = net.predict(data[1]);
+    EXPECT_TRUE(is_near_container(expected, actual, epsilon<float_t>()));
+
+    // gradients are neither allocated nor resized while inferring
+    for (auto l : net) {
+        EXPECT_TRUE(l->inference_only());
+        for (auto e : l->inputs()) EXPECT_TRUE(e->get_gradient()->empty());
+        for (auto e : l->outputs()) EXPECT_TRUE(e->get_gradient()->empty());
+    }
+
+    // training switches back to normal execution
+    net.train<mse>(opt, data, label, 4, 1);
+    EXPECT_FALSE(net[0]->inference_only());
+    EXPECT_FALSE(net[0]->inputs()[0]->get_gradient()->empty());
+}
+
+TEST(network, inference_only_shares_activations) {
+    auto net = make_mlp<tan_h>({ 10, 20, 30, 20, 10, 5 });
+    net.init_weight();
+
+    std::vector<tensor_t> in(3, tensor_t(1, vec_t(10)));
+    for (auto& t : in) uniform_rand(t[0].begin(), t[0].end(), -1.0f, 1.0f);
+
+    const std::vector<tensor_t> expected = net.predict(in);
+
+    net.set_inference_only();
+
+    // the 4 hidden activations fit in 2 ping-pong buffers
+    EXPECT_EQ(2u, net.memory_plan().arena_count());
+    EXPECT_EQ(20u + 30u + 20u + 10u, net.memory_plan().planned_size());
+    EXPECT_EQ(30u + 20u, net.memory_plan().arena_size());
+
+    for (int iter = 0; iter < 2; iter++) {
+        const std::vector<tensor_t> actual = net.predict(in);
+        for (size_t i = 0; i < expected.size(); i++) {
+            EXPECT_TRUE(is_near_container(expected[i][0], actual[i][0], epsilon<float_t>()));
+        }
+    }
+
+    net.set_netphase(net_phase::train);
+    EXPECT_EQ(0u, net.memory_plan().arena_count());
+    const std::vector<tensor_t> actual = net.predict(in);
+    EXPECT_TRUE(is_near_container(expected[0][0], actual[0][0], epsilon<float_t>()));
+}
+
+TEST(network, inference_only_graph) {
+    network<graph> net;
+
+    auto in = std::make_shared<input_layer>(shape3d(4, 1, 1));
+    auto fc1 = std::make_shared<fully_connected_layer<tan_h>>(4, 6);
+    auto fc2 = std::make_shared<fully_connected_layer<tan_h>>(6, 6);
+    auto fc3 = std::make_shared<fully_connected_layer<tan_h>>(6, 6);
+    auto add = std::make_shared<elementwise_add_layer>(2, 6);
+    auto out = std::make_shared<fully_connected_layer<tan_h>>(6, 3);
+
+    in << fc1 << fc2;
+    fc1 << fc3;
+    (fc2, fc3) << add << out;
+
+    construct_graph(net, { in }, { out });
+    net.init_weight();
+
+    const vec_t x = { 0.1f, -0.2f, 0.3f, 0.4f };
+    const vec_t expected = net.predict(x);
+
+    net.set_inference_only();
+
+    // fc1's output stays alive until both fc2 and fc3 ran
+    EXPECT_LT(net.memory_plan().arena_size(), net.memory_plan().planned_size());
+    EXPECT_TRUE(is_near_container(expected, net.predict(x), epsilon<float_t>()));
+}
+
+TEST(network, predict_bound) {
+    network<sequential> net;
+    net << fully_connected_layer<tan_h>(4, 8)
+        << fully_connected_layer<tan_h>(8, 3);
+    net.init_weight();
+
+    tensor_t in(5, vec_t(4));
+    for (auto& v : in) uniform_rand(v.begin(), v.end(), -1.0f, 1.0f);
+
+    std::vector<tensor_t> samples;
+    for (auto& v : in) samples.push_back({ v });
+    const std::vector<tensor_t> expected = net.predict(samples);
+
+    const float_t* in_ptr = &in[2][0];
+    const tensor_t& actual = net.predict_bound(in);
+
+    // the caller's buffers are handed back as they were
+    EXPECT_EQ(in_ptr, &in[2][0]);
+    ASSERT_EQ(expected.size(), actual.size());
+    for (size_t i = 0; i < expected.size(); i++) {
+        EXPECT_TRUE(is_near_container(expected[i][0], actual[i], epsilon<float_t>()));
+    }
+
+    // outputs are the network's own, reused storage
+    const float_t* out_ptr = &actual[0][0];
+    EXPECT_EQ(out_ptr, &net.predict_bound(in)[0][0]);
+
+    tensor_t wrong(2, vec_t(3));
+    EXPECT_THROW(net.predict_bound(wrong), nn_error);
+}
+
+TEST(network, predict_bound_graph) {
+    network<graph> net;
+
+    auto in1 = std::make_shared<input_layer>(shape3d(3, 1, 1));
+    auto in2 = std::make_shared<input_layer>(shape3d(3, 1, 1));
+    auto add = std::make_shared<elementwise_add_layer>(2, 3);
+    auto fc = std::make_shared<fully_connected_layer<tan_h>>(3, 2);
+
+    (in1, in2) << add << fc;
+    construct_graph(net, { in1, in2 }, { fc, add });
+    net.init_weight();
+
+    tensor_t x1 = { { 0.1f, 0.2f, 0.3f }, { -0.1f, 0.5f, 0.0f } };
+    tensor_t x2 = { { 0.4f, -0.2f, 0.1f }, { 0.2f, 0.2f, 0.2f } };
+
+    const std::vector<tensor_t> expected =
+        net.predict(std::vector<tensor_t>{ { x1[0], x2[0] }, { x1[1], x2[1] } });
+
+    const std::vector<const tensor_t*> actual = net.predict_bound({ &x1, &x2 });
+
+    ASSERT_EQ(2u, actual.size());
+    for (size_t sample = 0; sample < 2; sample++) {
+        for (size_t channel = 0; channel < 2; channel++) {
+            EXPECT_TRUE(is_near_container(expected[sample][channel],
+                                          (*actual[channel])[sample],
+                                          epsilon<float_t>()));
+        }
+    }
+}
+
+TEST(network, compile) {
+    network<sequential> net;
+    net << convolutional_layer<tan_h>(6, 6, 3, 1, 2, padding::same)
+        << max_pooling_layer<relu>(6, 6, 2, 2)
+        << fully_connected_layer<softmax>(3 * 3 * 2, 3);
+    net.init_weight();
+
+    std::vector<tensor_t> batch;
+    for (int i = 0; i < 4; i++) {
+        vec_t v(6 * 6);
+        uniform_rand(v.begin(), v.end(), -1.0, 1.0);
+        batch.push_back({ v });
+    }
+    const std::vector<tensor_t> expected = net.predict(batch);
+
+    EXPECT_EQ(0u, net.compiled_batch_size());
+    net.compile(4);
+    EXPECT_EQ(4u, net.compiled_batch_size());
+
+    // alternate compiled and regular batch sizes
+    for (int iter = 0; iter < 2; iter++) {
+        const std::vector<tensor_t> actual = net.predict(batch);
+        for (size_t i = 0; i < expected.size(); i++) {
+            EXPECT_TRUE(is_near_container(expected[i][0], actual[i][0], epsilon<float_t>()));
+        }
+        EXPECT_TRUE(is_near_container(expected[1][0], net.predict(batch[1][0]),
+                                      epsilon<float_t>()));
+    }
+
+    net.set_inference_only();
+    net.compile(1);
+    for (size_t i = 0; i < expected.size(); i++) {
+        EXPECT_TRUE(is_near_container(expected[i][0], net.predict(batch[i][0]),
+                                      epsilon<float_t>()));
+    }
+
+    EXPECT_THROW(net.compile(0), nn_error);
+}
+
+TEST(network, compile_train) {
+    auto make_net = []() {
+        network<sequential> net;
+        net << convolutional_layer<tan_h>(6, 6, 3, 1, 2, padding::same)
+            << fully_connected_layer<softmax>(6 * 6 * 2, 3);
+        return net;
+    };
+
+    std::vector<vec_t> data;
+    std::vector<label_t> label;
+    for (int i = 0; i < 12; i++) {
+        vec_t v(6 * 6);
+        uniform_rand(v.begin(), v.end(), -1.0, 1.0);
+        data.push_back(v);
+        label.push_back(static_cast<label_t>(i % 3));
+    }
+
+    set_random_seed(3);
+    auto net1 = make_net();
+    net1.init_weight();
+    set_random_seed(3);
+    auto net2 = make_net();
+    net2.init_weight();
+    ASSERT_TRUE(net1.has_same_weights(net2, 1E-10));
+
+    net2.compile(4);
+
+    // 10 samples per epoch: two compiled batches and a smaller one
+    data.resize(10);
+    label.resize(10);
+    adagrad opt1, opt2;
+    net1.train<mse>(opt1, data, label, 4, 3);
+    net2.train<mse>(opt2, data, label, 4, 3);
+    EXPECT_TRUE(net1.has_same_weights(net2, 1E-5));
+}
+
+TEST(network, compile_graph) {
+    network<graph> net;
+
+    auto in = std::make_shared<input_layer>(shape3d(4, 1, 1));
+    auto fc1 = std::make_shared<fully_connected_layer<tan_h>>(4, 6);
+    auto fc2 = std::make_shared<fully_connected_layer<tan_h>>(6, 6);
+    auto fc3 = std::make_shared<fully_connected_layer<tan_h>>(6, 6);
+    auto add = std::make_shared<elementwise_add_layer>(2, 6);
+    auto out = std::make_shared<fully_connected_layer<tan_h>>(6, 3);
+
+    in << fc1 << fc2;
+    fc1 << fc3;
+    (fc2, fc3) << add << out;
+
+    construct_graph(net, { in }, { out });
+    net.init_weight();
+
+    const vec_t x = { 0.1f, -0.2f, 0.3f, 0.4f };
+    const vec_t expected = net.predict(x);
+
+    net.compile();
+    EXPECT_TRUE(is_near_container(expected, net.predict(x), epsilon<float_t>()));
+
+    net.set_inference_only();
+    EXPECT_TRUE(is_near_container(expected, net.predict(x), epsilon<float_t>()));
+}
+
+TEST(network, fit_batch_source) {
+    network<sequential> net1, net2;
+    net1 << fully_connected_layer<tan_h>(3, 5) << fully_connected_layer<tan_h>(5, 2);
+    net2 << fully_connected_layer<tan_h>(3, 5) << fully_connected_layer<tan_h>(5, 2);
+    net1.init_weight();
+    net2.init_weight();
+    for (size_t i = 0; i < net1.depth(); i++) {
+        for (size_t j = 0; j < net1[i]->weights().size(); j++) {
+            *net2[i]->weights()[j] = *net1[i]->weights()[j];
+        }
+    }
+
+    std::vector<tensor_t> data, out;
+    for (int i = 0; i < 10; i++) {
+        vec_t x(3), t(2);
+        uniform_rand(x.begin(), x.end(), -1.0f, 1.0f);
+        uniform_rand(t.begin(), t.end(), -0.5f, 0.5f);
+        data.push_back({ x });
+        out.push_back({ t });
+    }
+
+    gradient_descent opt1, opt2;
+    int batches = 0, epochs = 0;
+
+    net1.fit<mse>(opt1, data, out, 4, 3);
+
+    // same batches in the same order, assembled by background workers
+    tensor_batch_source src(data, out, 4);
+    net2.fit<mse>(opt2, src, 3, [&]() { batches++; }, [&]() { epochs++; },
+                  false, 3, 2);
+
+    EXPECT_EQ(9, batches);
+    EXPECT_EQ(3, epochs);
+    for (size_t i = 0; i < net1.depth(); i++) {
+        for (size_t j = 0; j < net1[i]->weights().size(); j++) {
+            EXPECT_TRUE(is_near_container(*net1[i]->weights()[j],
+                                          *net2[i]->weights()[j],
+                                          epsilon<float_t>()));
+        }
+    }
+}
+
+TEST(network, batch_pipeline) {
+    struct counting_source : public batch_source {
+        size_t batch_count() const override { return 5; }
+        void begin_epoch(int epoch) override { epochs.push_back(epoch); }
+        void make_batch(size_t index, minibatch* batch) override {
+            if (index == 3 && fail) throw nn_error("broken sample");
+            batch->in.assign(1, tensor_t(1, vec_t(1, float_t(index))));
+        }
+        std::vector<int> epochs;
+        bool fail = false;
+    } src;
+
+    {
+        batch_pipeline pipeline(src, 3, 4, 3);
+        minibatch batch;
+        for (int epoch = 0; epoch < 3; epoch++) {
+            for (size_t i = 0; i < 5; i++) {
+                ASSERT_TRUE(pipeline.next(&batch));
+                EXPECT_EQ(float_t(i), batch.in[0][0][0]);
+            }
+        }
+        EXPECT_FALSE(pipeline.next(&batch));
+    }
+    EXPECT_EQ(std::vector<int>({ 0, 1, 2 }), src.epochs);
+
+    src.fail = true;
+    batch_pipeline pipeline(src, 1, 2, 2);
+    minibatch batch;
+    for (size_t i = 0; i < 3; i++) {
+        ASSERT_TRUE(pipeline.next(&batch));
+    }
+    EXPECT_THROW(pipeline.next(&batch), nn_error);
+}
+
+TEST(network, quantized_execution) {
+    network<sequential> net;
+    net << quantized_convolutional_layer<relu>(8, 8, 3, 2, 4, padding::same)
+        << quantized_convolutional_layer<tan_h>(8, 8, 3, 4, 4)
+        << max_pooling_layer<identity>(6, 6, 4, 2)
+        << quantized_convolutional_layer<identity>(3, 3, 3, 4, 6)
+        << quantized_fully_connected_layer<sigmoid>(6, 5)
+        << quantized_fully_connected_layer<softmax>(5, 3);
+    net.init_weight();
+
+    std::vector<tensor_t> in(3, tensor_t(1, vec_t(8 * 8 * 2)));
+    for (auto& t : in) uniform_rand(t[0].begin(), t[0].end(), -1.0f, 1.0f);
+
+    // each layer quantizes its input and dequantizes its output
+    const std::vector<tensor_t> expected = net.predict(in);
+
+    net.set_quantized_execution();
+    for (int iter = 0; iter < 2; iter++) {
+        const std::vector<tensor_t> actual = net.predict(in);
+        for (size_t i = 0; i < expected.size(); i++) {
+            EXPECT_TRUE(is_near_container(expected[i][0], actual[i][0], float_t(2e-2)));
+        }
+    }
+
+    // back to per-layer conversion
+    net.set_netphase(net_phase::train);
+    const std::vector<tensor_t> actual = net.predict(in);
+    EXPECT_TRUE(is_near_container(expected[0][0], actual[0][0], epsilon<float_t>()));
+}
+
+TEST(network, quantized_execution_graph) {
+    quantized_fully_connected_layer<relu> fc1(4, 3);
+    quantized_fully_connected_layer<identity> fc2(3, 2);
+    fc1 << fc2;
+
+    network<graph> net;
+    construct_graph(net, { &fc1 }, { &fc2 });
+
+    EXPECT_THROW(net.set_quantized_execution(), nn_not_implemented_error);
+    EXPECT_NO_THROW(net.set_quantized_execution(false));
+}
+
+#ifndef CNN_NO_SERIALIZATION
+TEST(network, quantization_calibration) {
+    network<sequential> net;
+    net << convolutional_layer<relu>(8, 8, 3, 2, 4, padding::same)
+        << max_pooling_layer<identity>(8, 8, 4, 2)
+        << fully_connected_layer<tan_h>(4 * 4 * 4, 10);
+    net.init_weight();
+
+    std::vector<vec_t> calib(20, vec_t(8 * 8 * 2));
+    for (auto& v : calib) uniform_rand(v.begin(), v.end(), -1.0f, 1.0f);
+
+    quantization_calibrator calibrator;
+    calibrator.calibrate(net, calib, 8);
+    ASSERT_EQ(3u, calibrator.layers().size());
+    EXPECT_EQ(float_t(0), calibrator.layers()[0].ranges.out_min);  // relu
+    EXPECT_LE(calibrator.layers()[0].ranges.in_min, float_t(-0.9));
+    EXPECT_GE(calibrator.layers()[0].ranges.in_max, float_t(0.9));
+
+    network<sequential> qnet;
+    calibrator.convert(net, qnet);
+    ASSERT_EQ(3u, qnet.layer_size());
+    EXPECT_TRUE(calibrator.layers()[0].quantized);
+    EXPECT_FALSE(calibrator.layers()[1].quantized);
+    EXPECT_TRUE(calibrator.layers()[2].quantized);
+    EXPECT_EQ("q_conv", qnet[0]->layer_type());
+    EXPECT_EQ("max-pool", qnet[1]->layer_type());
+    EXPECT_EQ("q_fully-connected", qnet[2]->layer_type());
+
+    const auto& drift = calibrator.measure_drift(net, qnet, calib);
+    EXPECT_GT(drift[2].max_error, float_t(0));
+    EXPECT_LT(drift[2].max_error, float_t(5e-2));
+    EXPECT_LE(drift[2].mean_error, drift[2].max_error);
+
+    std::ostringstream report;
+    calibrator.print_report(report);
+    EXPECT_NE(std::string::npos, report.str().find("max-pool"));
+
+    // static ranges are also used by the end-to-end uint8 execution
+    qnet.set_quantized_execution();
+    for (const vec_t& in : calib) {
+        EXPECT_TRUE(is_near_container(net.predict(in), qnet.predict(in), float_t(5e-2)));
+    }
+}
+#endif  // CNN_NO_SERIALIZATION
+
+// compare optimizer::update_parameters with a per-element reference
+// ref(dW, W, state, param, step), dW already merged and scaled
+template <typename Optimizer, typename Reference>
+void check_fused_update(Optimizer& opt, Reference ref) {
+    // the first parameter spans several blocks plus a tail,
+    // gradients are split over three per-thread slots
+    const size_t sizes[] = { 2500, 7 };
+    std::vector<vec_t> w_fused, w_ref;
+    std::vector<tensor_t> grads, state;
+    for (size_t size : sizes) {
+        vec_t w(size);
+        uniform_rand(w.begin(), w.end(), -1.0f, 1.0f);
+        w_fused.push_back(w);
+        w_ref.push_back(w);
+        grads.push_back(tensor_t(3, vec_t(size)));
+        state.push_back(tensor_t(2, vec_t(size, float_t(0))));
+    }
+    std::vector<trainable_parameter> params;
+    for (size_t p = 0; p < w_fused.size(); p++) {
+        params.emplace_back(&w_fused[p], &grads[p]);
+    }
+
+    const float_t scale = float_t(0.25);
+    for (int step = 1; step <= 3; step++) {
+        for (auto& g : grads) {
+            for (auto& slot : g) uniform_rand(slot.begin(), slot.end(), -1.0f, 1.0f);
+        }
+        opt.update_parameters(params, scale, true);
+
+        for (size_t p = 0; p < w_ref.size(); p++) {
+            vec_t dW(w_ref[p].size(), float_t(0));
+            for (const auto& slot : grads[p]) {
+                for (size_t i = 0; i < dW.size(); i++) dW[i] += slot[i];
+            }
+            for (auto& d : dW) d *= scale;
+            ref(dW, w_ref[p], state[p], step);
+        }
+    }
+
+    for (size_t p = 0; p < w_ref.size(); p++) {
+        EXPECT_TRUE(is_near_container(w_ref[p], w_fused[p], float_t(1e-5)));
+    }
+}
+
+TEST(network, fused_optimizer_update) {
+    adagrad ag;
+    check_fused_update(ag, [&](const vec_t& dW, vec_t& W, tensor_t& s, int) {
+        for (size_t i = 0; i < W.size(); i++) {
+            s[0][i] += dW[i] * dW[i];
+            W[i] -= ag.alpha * dW[i] / (std::sqrt(s[0][i]) + float_t(1e-8));
+        }
+    });
+
+    RMSprop rms;
+    check_fused_update(rms, [&](const vec_t& dW, vec_t& W, tensor_t& s, int) {
+        for (size_t i = 0; i < W.size(); i++) {
+            s[0][i] = rms.mu * s[0][i] + (1 - rms.mu) * dW[i] * dW[i];
+            W[i] -= rms.alpha * dW[i] / std::sqrt(s[0][i] + float_t(1e-8));
+        }
+    });
+
+    // bias correction advances once per update_parameters
+    adam ad;
+    check_fused_update(ad, [&](const vec_t& dW, vec_t& W, tensor_t& s, int step) {
+        const float_t b1_t = std::pow(ad.b1, float_t(step + 1));
+        const float_t b2_t = std::pow(ad.b2, float_t(step + 1));
+        for (size_t i = 0; i < W.size(); i++) {
+            s[0][i] = ad.b1 * s[0][i] + (1 - ad.b1) * dW[i];
+            s[1][i] = ad.b2 * s[1][i] + (1 - ad.b2) * dW[i] * dW[i];
+            W[i] -= ad.alpha * (s[0][i] / (1 - b1_t)) /
+                    std::sqrt(s[1][i] / (1 - b2_t) + float_t(1e-8));
+        }
+    });
+
+    gradient_descent gd;
+    gd.lambda = float_t(0.01);
+    check_fused_update(gd, [&](const vec_t& dW, vec_t& W, tensor_t&, int) {
+        for (size_t i = 0; i < W.size(); i++) {
+            W[i] = W[i] - gd.alpha * (dW[i] + gd.lambda * W[i]);
+        }
+    });
+
+    momentum mom;
+    mom.lambda = float_t(0.01);
+    check_fused_update(mom, [&](const vec_t& dW, vec_t& W, tensor_t& s, int) {
+        for (size_t i = 0; i < W.size(); i++) {
+            float_t V = mom.mu * s[0][i] - mom.alpha * (dW[i] + W[i] * mom.lambda);
+            W[i] += V;
+            s[0][i] = V;
+        }
+    });
+}
+
+
+TEST(network, parameter_arena) {
+    auto net = make_mlp<tan_h>({ 10, 20, 5 });
+    net.init_weight();
+
+    vec_t in(10);
+    uniform_rand(in.begin(), in.end(), -1.0f, 1.0f);
+    const vec_t expected = net.predict(in);
+
+    parameter_arena& arena = net.pack_parameters();
+    EXPECT_TRUE(arena.bound());
+    EXPECT_EQ(0u, reinterpret_cast<size_t>(arena.data()) % 64);
+
+    // weights are views in layer order, contents unchanged
+    size_t i = 0;
+    for (auto l : net) {
+        for (auto w : l->weights()) {
+            EXPECT_EQ(arena.data() + arena.offset(i++), w->data());
+        }
+    }
+    EXPECT_TRUE(is_near_container(expected, net.predict(in), float_t(0)));
+
+    // vec_t is unchanged by the arena
+    EXPECT_EQ(sizeof(std::vector<float_t>), sizeof(vec_t));
+    EXPECT_TRUE(vec_t::allocator_type() == vec_t::allocator_type());
+
+    // copies live on the heap, copy assignments write through
+    vec_t& w = *net[0]->weights()[0];
+    const vec_t original = w;
+    vec_t copy = w;
+    EXPECT_NE(copy.data(), w.data());
+    copy[0] += float_t(1);
+    w = copy;
+    EXPECT_EQ(arena.data(), w.data());
+    EXPECT_EQ(copy[0], arena.data()[0]);
+    w = original;
+    EXPECT_EQ(original[0], arena.data()[0]);
+    EXPECT_TRUE(arena.bound());
+
+    // training updates the arena in place
+    const vec_t before = arena.snapshot();
+    adagrad opt;
+    std::vector<vec_t> data(4, in);
+    std::vector<vec_t> out(4, vec_t(5, float_t(0.5)));
+    net.fit<mse>(opt, data, out, 2, 1);
+    EXPECT_TRUE(arena.bound());
+    EXPECT_FALSE(is_near_container(before, arena.snapshot(), float_t(0)));
+
+    arena.restore(before);
+    EXPECT_TRUE(is_near_container(expected, net.predict(in), float_t(0)));
+
+    arena.average({ before, before });
+    EXPECT_TRUE(is_near_container(expected, net.predict(in), epsilon<float_t>()));
+
+    // moving another vector in detaches a weight vector, so does growing it
+    vec_t replacement(original);
+    w = std::move(replacement);
+    EXPECT_FALSE(arena.bound());
+    EXPECT_EQ(original[0], w[0]);
+    net.pack_parameters();
+    EXPECT_TRUE(arena.bound());
+
+    net[1]->weights()[0]->resize(arena.size() + 1);
+    EXPECT_FALSE(arena.bound());
+
+    // the buffer outlives the network as long as views are left
+    vec_t kept;
+    vec_t values;
+    {
+        auto other = make_mlp<tan_h>({ 10, 20, 5 });
+        other.init_weight();
+        other.pack_parameters();
+        values = *other[0]->weights()[0];
+        kept.swap(*other[0]->weights()[0]);
+    }
+    EXPECT_TRUE(is_near_container(values, kept, float_t(0)));
+}
+
+TEST(network, parameter_arena_invalidates_weight_caches) {
+    // quantized layers cache their quantized weights by weights_version
+    network<sequential> net;
+    net << quantized_convolutional_layer<identity>(4, 4, 3, 1, 1);
+    net.init_weight();
+
+    vec_t in(4 * 4);
+    uniform_rand(in.begin(), in.end(), -1.0f, 1.0f);
+    const vec_t expected = net.predict(in);
+
+    parameter_arena& arena = net.pack_parameters();
+    EXPECT_TRUE(is_near_container(expected, net.predict(in), float_t(0)));
+
+    vec_t negated = arena.snapshot();
+    for (auto& w : negated) w = -w;
+    arena.restore(negated);
+
+    const vec_t out = net.predict(in);
+    for (size_t i = 0; i < out.size(); i++) {
+        EXPECT_NEAR(-expected[i], out[i], 5e-2);
+    }
+}
+
+TEST(network, map_weights) {
+    auto make_net = []() {
+        network<sequential> net;
+        net << convolutional_layer<tan_h>(6, 6, 3, 1, 2, padding::same)
+            << fully_connected_layer<softmax>(6 * 6 * 2, 3);
+        return net;
+    };
+    auto src = make_net();
+    src.init_weight();
+
+    const std::string path = unique_path();
+    src.save_weights_mappable(path);
+
+    vec_t in(6 * 6);
+    uniform_rand(in.begin(), in.end(), -1.0f, 1.0f);
+    const vec_t expected = src.predict(in);
+
+    auto dst = make_net();
+    dst.map_weights(path);
+    EXPECT_TRUE(dst.parameters().bound());
+    EXPECT_EQ(0u, reinterpret_cast<size_t>(dst.parameters().data()) % 64);
+    EXPECT_TRUE(src.has_same_weights(dst, float_t(0)));
+    EXPECT_TRUE(is_near_container(expected, dst.predict(in), float_t(0)));
+
+    // training writes to private copies of the pages, not to the file
+    adagrad opt;
+    std::vector<vec_t> data(2, in);
+    std::vector<label_t> label{ 0, 1 };
+    dst.train<mse>(opt, data, label, 2, 1);
+    EXPECT_FALSE(src.has_same_weights(dst, float_t(0)));
+
+    auto again = make_net();
+    again.map_weights(path);
+    EXPECT_TRUE(is_near_container(expected, again.predict(in), float_t(0)));
+
+    // the architecture has to match
+    network<sequential> other;
+    other << fully_connected_layer<softmax>(6 * 6, 3);
+    EXPECT_THROW(other.map_weights(path), nn_error);
+
+    std::remove(path.c_str());
+}
+
+TEST(network, map_weights_shared) {
+    // a vector listed twice is stored once, as in the arena
+    vec_t a(5), b(17);
+    uniform_rand(a.begin(), a.end(), -1.0f, 1.0f);
+    uniform_rand(b.begin(), b.end(), -1.0f, 1.0f);
+
+    const std::string path = unique_path();
+    save_weight_file(path, { &a, &b, &a });
+
+    vec_t x(5), y(17);
+    parameter_arena arena;
+    map_weight_file(path, { &x, &y, &x }, &arena);
+    EXPECT_TRUE(arena.bound());
+    EXPECT_EQ(parameter_arena::padded(5) + parameter_arena::padded(17), arena.size());
+    EXPECT_TRUE(is_near_container(a, x, float_t(0)));
+    EXPECT_TRUE(is_near_container(b, y, float_t(0)));
+
+    std::remove(path.c_str());
+}
+
 } // namespace tiny-dnn
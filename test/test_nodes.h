@@ -103,4 +103,119 @@ TEST(nodes, graph_branch2) {
     EXPECT_FLOAT_EQ(static_cast<float_t>(res[2]), static_cast<float_t>(0.0));
 }
 
+TEST(nodes, reuse_sample_buffers) {
+    fully_connected_layer<tan_h> fc(4, 3);
+
+    tensor_t in4(4, vec_t(4, float_t(1))), in2(2, vec_t(4, float_t(1)));
+
+    fc.forward({ in4 });
+    const tensor_t& out = *fc.outputs()[0]->get_data();
+    std::vector<const float_t*> ptrs;
+    for (auto& v : out) ptrs.push_back(&v[0]);
+
+    // shrink and grow back: the same per-sample buffers are reused
+    fc.forward({ in2 });
+    EXPECT_EQ(2u, out.size());
+    fc.forward({ in4 });
+    ASSERT_EQ(4u, out.size());
+
+    std::vector<const float_t*> ptrs2;
+    for (auto& v : out) ptrs2.push_back(&v[0]);
+    std::sort(ptrs.begin(), ptrs.end());
+    std::sort(ptrs2.begin(), ptrs2.end());
+    EXPECT_EQ(ptrs, ptrs2);
+}
+
+TEST(nodes, weight_grads_per_thread) {
+    const serial_size_t batch = 64;
+    fully_connected_layer<identity> fc(10, 3);
+
+    tensor_t in(batch), grad(batch, vec_t(3, float_t(1)));
+    for (serial_size_t i = 0; i < batch; i++) {
+        in[i] = vec_t(10, float_t(i));
+    }
+
+    fc.forward({ in });
+    fc.backward({ grad, grad });
+
+    // weight gradients have one slot per thread, not one per sample
+    const tensor_t& dW = *fc.weights_grads()[0];
+    EXPECT_EQ(std::min(batch, static_cast<serial_size_t>(num_threads())),
+              dW.size());
+
+    // dW[c * out + o] = sum_i in[i][c] * grad[i][o] = 0 + 1 + ... + 63
+    vec_t merged;
+    fc.inputs()[1]->merge_grads(&merged);
+    for (auto d : merged) {
+        EXPECT_FLOAT_EQ(float_t(batch * (batch - 1) / 2), d);
+    }
+}
+
+TEST(nodes, lazy_clear_grads) {
+    edge e(nullptr, shape3d(5000, 1, 1), vector_type::weight);
+    e.set_sample_count(3);
+    for (auto& g : *e.get_gradient()) std::fill(g.begin(), g.end(), float_t(2));
+
+    vec_t merged;
+    e.merge_grads(&merged);
+    EXPECT_FLOAT_EQ(float_t(6), merged[4999]);
+
+    // nothing is touched until the gradients are used again
+    e.clear_grads();
+    e.merge_grads(&merged);
+    EXPECT_EQ(5000u, merged.size());
+    EXPECT_FLOAT_EQ(float_t(0), merged[0]);
+
+    const tensor_t& grads = *e.get_gradient();
+    for (const auto& g : grads) {
+        EXPECT_FLOAT_EQ(float_t(0), *std::max_element(g.begin(), g.end()));
+    }
+}
+
+TEST(nodes, update_weights_parallelize) {
+    struct recording_optimizer : public gradient_descent {
+        void update_parameters(const std::vector<trainable_parameter>& params,
+                               float_t scale, bool parallelize) override {
+            calls.push_back(parallelize);
+            gradient_descent::update_parameters(params, scale, parallelize);
+        }
+        std::vector<bool> calls;
+    };
+
+    sequential seq;
+    seq.add(fc<tan_h>(10, 20));
+    seq.add(dropout_layer(20, float_t(0.5)));
+    seq.add(fc<tan_h>(20, 5));
+    seq.setup(true);
+
+    recording_optimizer opt;
+    seq.update_weights(&opt, 1);
+
+    // layers without parameters don't matter
+    seq[1]->set_parallelize(false);
+    seq.update_weights(&opt, 1);
+
+    seq[2]->set_parallelize(false);
+    seq.update_weights(&opt, 1);
+
+    EXPECT_EQ(std::vector<bool>({ true, true, false }), opt.calls);
+}
+
+TEST(nodes, backward_after_forward_bound) {
+    sequential seq;
+    seq.add(fc<tan_h>(4, 3));
+    seq.setup(true);
+
+    tensor_t in(2, vec_t(4, float_t(1)));
+    std::vector<tensor_t> samples(2, tensor_t(1, vec_t(4, float_t(1))));
+    std::vector<tensor_t> grad(2, tensor_t(1, vec_t(3, float_t(1))));
+
+    // the inputs were handed back, there is nothing to differentiate
+    seq.forward_bound({ &in });
+    EXPECT_THROW(seq.backward(grad), nn_error);
+
+    seq.forward(samples);
+    EXPECT_NO_THROW(seq.backward(grad));
+}
+
 } // namespace tiny-dnn
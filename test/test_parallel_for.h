@@ -0,0 +1,98 @@
+/*
+    Copyright (c) 2016, Taiga Nomi
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+#include <atomic>
+#include "gtest/gtest.h"
+#include "testhelper.h"
+#include "tiny_dnn/tiny_dnn.h"
+
+namespace tiny_dnn {
+
+TEST(parallel_for, visits_each_index_once) {
+    std::vector<std::atomic<int>> count(10000);
+    for (auto& c : count) c = 0;
+
+    for_i(count.size(), [&](int i) { count[i]++; });
+
+    for (auto& c : count) EXPECT_EQ(1, c.load());
+}
+
+TEST(parallel_for, honors_grainsize) {
+    std::atomic<int> too_small(0);
+
+    for_(true, 0, 1000, [&](const blocked_range& r) {
+        if (r.end() - r.begin() < 300 && r.end() != 1000) too_small++;
+    }, 300);
+
+    EXPECT_EQ(0, too_small.load());
+}
+
+TEST(parallel_for, nested) {
+    std::atomic<int> sum(0);
+
+    for_i(64, [&](int) {
+        for_i(64, [&](int j) { sum += j; });
+    });
+
+    EXPECT_EQ(64 * (63 * 64 / 2), sum.load());
+}
+
+#if !defined(CNN_USE_TBB) && !defined(CNN_USE_OMP) && !defined(CNN_SINGLE_THREAD)
+
+TEST(parallel_for, set_num_threads) {
+    const size_t prev = num_threads();
+
+    set_num_threads(3);
+    EXPECT_EQ(3u, num_threads());
+
+    std::atomic<int> sum(0);
+    for_i(1000, [&](int i) { sum += i; }, 1);
+    EXPECT_EQ(999 * 1000 / 2, sum.load());
+
+    set_num_threads(prev);
+    EXPECT_EQ(prev, num_threads());
+}
+
+TEST(parallel_for, propagates_exception) {
+    const size_t prev = num_threads();
+    set_num_threads(4);
+
+    EXPECT_THROW(for_i(1000, [&](int i) {
+        if (i == 777) throw nn_error("error in worker");
+    }, 1), nn_error);
+
+    // the pool is still usable
+    std::atomic<int> sum(0);
+    for_i(100, [&](int i) { sum += i; }, 1);
+    EXPECT_EQ(99 * 100 / 2, sum.load());
+
+    set_num_threads(prev);
+}
+
+#endif
+
+} // namespace tiny_dnn
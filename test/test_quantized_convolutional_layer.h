@@ -123,6 +123,35 @@ TEST(quantized_convolutional, fprop) {
     }
 }
 
+TEST(quantized_convolutional, fprop_weight_cache) {
+    network<sequential> net1, net2;
+    net1 << quantized_convolutional_layer<tan_h>(5, 5, 3, 2, 4);
+    net2 << quantized_convolutional_layer<tan_h>(5, 5, 3, 2, 4);
+    net1.init_weight();
+
+    vec_t in(50);
+    uniform_rand(in.begin(), in.end(), -1.0f, 1.0f);
+
+    const size_t version = net1[0]->weights_version();
+    const vec_t out1 = net1.predict(in);
+    EXPECT_TRUE(is_near_container(out1, net1.predict(in), epsilon<float_t>()));
+    // forward passes reuse the quantized weights
+    EXPECT_EQ(version, net1[0]->weights_version());
+
+    // mutable access to the weights invalidates the quantized copy
+    (*net1[0]->weights()[0])[0] += float_t(0.5);
+    EXPECT_NE(version, net1[0]->weights_version());
+    const vec_t out2 = net1.predict(in);
+
+    net2.init_weight();
+    for (size_t j = 0; j < net1[0]->weights().size(); j++) {
+        *net2[0]->weights()[j] = *net1[0]->weights()[j];
+    }
+
+    EXPECT_FALSE(is_near_container(out1, out2, epsilon<float_t>()));
+    EXPECT_TRUE(is_near_container(out2, net2.predict(in), epsilon<float_t>()));
+}
+
 /*#ifdef CNN_USE_NNPACK
 TEST(quantized_convolutional, fprop_npp) {
     typedef network<sequential> CNN;
@@ -25,6 +25,7 @@
     SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 #pragma once
+#include <functional>
 #include <string>
 #include <iostream>
 #include <cstdio>
@@ -33,6 +34,12 @@
 
 namespace tiny_dnn {
 
+/**
+ * number of global operator new calls, on any thread, made while f runs.
+ * defined in test.cpp, which replaces the global allocator
+ **/
+size_t count_allocations(const std::function<void()>& f);
+
 template <typename Container, typename T>
 inline bool is_near_container(const Container& expected, const Container& actual, T abs_error) {
     auto i1 = std::begin(expected);
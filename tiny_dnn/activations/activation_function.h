@@ -26,6 +26,7 @@
 */
 #pragma once
 #include "tiny_dnn/util/util.h"
+#include "tiny_dnn/util/vectorized_math.h"
 #include <algorithm>
 
 namespace tiny_dnn {
@@ -45,7 +46,9 @@ public:
     virtual ~function() = default;
 
     virtual float_t f(const vec_t& v, size_t index) const = 0;
-    void itef(vec_t& out, const vec_t& in, size_t cnt) const {
+
+    // out[i] = f(in, i) for i < cnt. out and in may be the same vector
+    virtual void itef(vec_t& out, const vec_t& in, size_t cnt) const {
         for (size_t i = 0; i < cnt; i++) {
             out[i] = f(in, i);
         }
@@ -57,6 +60,21 @@ public:
     // dfi/dyk (k=0,1,..n)
     virtual vec_t df(const vec_t& y, size_t i) const { vec_t v(y.size(), 0); v[i] = df(y[i]); return v; }
 
+    // dx[c] = sum_i dy[i] * dfi/dyc for c < cnt, given the outputs y
+    virtual void itedf(vec_t& dx, const vec_t& dy, const vec_t& y, size_t cnt) const {
+        if (one_hot()) {
+            for (size_t c = 0; c < cnt; c++) {
+                dx[c] = dy[c] * df(y[c]);
+            }
+        }
+        else {
+            for (size_t c = 0; c < cnt; c++) {
+                vec_t d = df(y, c);
+                dx[c] = vectorize::dot(dy.data(), d.data(), cnt);
+            }
+        }
+    }
+
     // return if dfi/dyk is one-hot vector
     virtual bool one_hot() const { return true; }
 
@@ -64,11 +82,49 @@ public:
     virtual std::pair<float_t, float_t> scale() const = 0;
 };
 
+/**
+ * applies an activation to each sample of a tensor right after a kernel
+ * has computed it, while the sample is still in cache. kernels supporting
+ * it call the epilogue at the end of their per-sample loop.
+ **/
+class epilogue {
+public:
+    epilogue() : h_(nullptr), out_(nullptr) {}
+    epilogue(const function* h, tensor_t* out) : h_(h), out_(out) {}
+
+    explicit operator bool() const { return h_ != nullptr; }
+
+    // out[sample] = h(a[sample])
+    void operator()(const tensor_t& a, size_t sample) const {
+        if (h_) {
+            const vec_t& in = a[sample];
+            h_->itef((*out_)[sample], in, in.size());
+        }
+    }
+
+    // for kernels without a per-sample loop
+    void apply_all(const tensor_t& a) const {
+        for (size_t sample = 0; sample < a.size(); sample++) {
+            (*this)(a, sample);
+        }
+    }
+
+private:
+    const function* h_;
+    tensor_t* out_;
+};
+
 class identity : public function {
 public:
     using function::df;
     float_t f(const vec_t& v, size_t i) const override { return v[i]; }
+    void itef(vec_t& out, const vec_t& in, size_t cnt) const override {
+        if (&out != &in) std::copy(in.begin(), in.begin() + cnt, out.begin());
+    }
     float_t df(float_t /*y*/) const override { return float_t(1); }
+    void itedf(vec_t& dx, const vec_t& dy, const vec_t& /*y*/, size_t cnt) const override {
+        if (&dx != &dy) std::copy(dy.begin(), dy.begin() + cnt, dx.begin());
+    }
     std::pair<float_t, float_t> scale() const override { return std::make_pair(float_t(0.1), float_t(0.9)); }
 };
 
@@ -76,7 +132,13 @@ class sigmoid : public function {
 public:
     using function::df;
     float_t f(const vec_t& v, size_t i) const override { return float_t(1) / (float_t(1) + std::exp(-v[i])); }
+    void itef(vec_t& out, const vec_t& in, size_t cnt) const override {
+        vectorize::sigmoid(in.data(), cnt, out.data());
+    }
     float_t df(float_t y) const override { return y * (float_t(1) - y); }
+    void itedf(vec_t& dx, const vec_t& dy, const vec_t& y, size_t cnt) const override {
+        for (size_t i = 0; i < cnt; i++) dx[i] = dy[i] * y[i] * (float_t(1) - y[i]);
+    }
     std::pair<float_t, float_t> scale() const override { return std::make_pair(float_t(0.1), float_t(0.9)); }
 };
 
@@ -84,7 +146,13 @@ class relu : public function {
 public:
     using function::df;
     float_t f(const vec_t& v, size_t i) const override { return std::max(float_t(0), v[i]); }
+    void itef(vec_t& out, const vec_t& in, size_t cnt) const override {
+        for (size_t i = 0; i < cnt; i++) out[i] = std::max(float_t(0), in[i]);
+    }
     float_t df(float_t y) const override { return y > float_t(0) ? float_t(1) : float_t(0); }
+    void itedf(vec_t& dx, const vec_t& dy, const vec_t& y, size_t cnt) const override {
+        for (size_t i = 0; i < cnt; i++) dx[i] = y[i] > float_t(0) ? dy[i] : float_t(0);
+    }
     std::pair<float_t, float_t> scale() const override { return std::make_pair(float_t(0.1), float_t(0.9)); }
 };
 
@@ -94,7 +162,13 @@ class leaky_relu : public function {
 public:
     using function::df;
     float_t f(const vec_t& v, size_t i) const override { return (v[i] > float_t(0)) ? v[i] : float_t(0.01) * v[i]; }
+    void itef(vec_t& out, const vec_t& in, size_t cnt) const override {
+        for (size_t i = 0; i < cnt; i++) out[i] = in[i] > float_t(0) ? in[i] : float_t(0.01) * in[i];
+    }
     float_t df(float_t y) const override { return y > float_t(0) ? float_t(1) : float_t(0.01); }
+    void itedf(vec_t& dx, const vec_t& dy, const vec_t& y, size_t cnt) const override {
+        for (size_t i = 0; i < cnt; i++) dx[i] = y[i] > float_t(0) ? dy[i] : float_t(0.01) * dy[i];
+    }
     std::pair<float_t, float_t> scale() const override { return std::make_pair(float_t(0.1), float_t(0.9)); }
 };
 
@@ -102,8 +176,23 @@ class elu : public function {
 public:
     using function::df;
     float_t f(const vec_t& v, size_t i) const override { return (v[i]<float_t(0) ? (exp(v[i])- float_t(1)) : v[i]); }
+    void itef(vec_t& out, const vec_t& in, size_t cnt) const override {
+        vec_t& e = buffer(cnt);
+        vectorize::exp(in.data(), cnt, e.data());
+        for (size_t i = 0; i < cnt; i++) out[i] = in[i] < float_t(0) ? e[i] - float_t(1) : in[i];
+    }
     float_t df(float_t y) const override { return (y > float_t(0) ? float_t(1) : (float_t(1)+y)); }
+    void itedf(vec_t& dx, const vec_t& dy, const vec_t& y, size_t cnt) const override {
+        for (size_t i = 0; i < cnt; i++) dx[i] = y[i] > float_t(0) ? dy[i] : dy[i] * (float_t(1) + y[i]);
+    }
     std::pair<float_t, float_t> scale() const override { return std::make_pair(float_t(0.1), float_t(0.9)); }
+
+private:
+    static vec_t& buffer(size_t size) {
+        static thread_local vec_t buf;
+        if (buf.size() < size) buf.resize(size);
+        return buf;
+    }
 };
 
 class softmax : public function {
@@ -117,6 +206,19 @@ public:
         return numer / denom;
     }
 
+    // single pass over the sample instead of one per output
+    void itef(vec_t& out, const vec_t& in, size_t cnt) const override {
+        if (cnt == 0) return;
+        const float_t alpha = *std::max_element(in.begin(), in.begin() + cnt);
+        for (size_t i = 0; i < cnt; i++) out[i] = in[i] - alpha;
+        vectorize::exp(out.data(), cnt, out.data());
+
+        float_t denom = float_t(0);
+        for (size_t i = 0; i < cnt; i++) denom += out[i];
+        const float_t inv = float_t(1) / denom;
+        for (size_t i = 0; i < cnt; i++) out[i] *= inv;
+    }
+
     float_t df(float_t y) const override {
         return y * (float_t(1) - y);
     }
@@ -129,6 +231,14 @@ public:
         return v;
     }
 
+    // dx[c] = y[c] * (dy[c] - sum_i dy[i] * y[i]), O(n) instead of
+    // building the Jacobian
+    void itedf(vec_t& dx, const vec_t& dy, const vec_t& y, size_t cnt) const override {
+        if (cnt == 0) return;
+        const float_t s = vectorize::dot(dy.data(), y.data(), cnt);
+        for (size_t c = 0; c < cnt; c++) dx[c] = y[c] * (dy[c] - s);
+    }
+
     virtual bool one_hot() const override { return false; }
 
     std::pair<float_t, float_t> scale() const override { return std::make_pair(float_t(0), float_t(1)); }
@@ -142,32 +252,15 @@ public:
         return std::tanh(v[i]);
     }
 
-    void itef(vec_t& out, const vec_t& in, size_t cnt) const {
-        for (size_t i = 0; i < cnt; i++) {
-            out[i] = std::tanh(in[i]);
-        }
+    void itef(vec_t& out, const vec_t& in, size_t cnt) const override {
+        vectorize::tanh(in.data(), cnt, out.data());
     }
 
-    // fast approximation of tanh (improve 2-3% speed in LeNet-5)
-    /*float_t f(float_t x) const {
-        const float_t x2 = x * x;
-        x *= 1.0 + x2 * (0.1653 + x2 * 0.0097);
-        return x / std::sqrt(1.0 + x * x);// invsqrt(static_cast<float>(1.0 + x * x));
-    }*/
-
     float_t df(float_t y) const override { return float_t(1) - sqr(y); }
+    void itedf(vec_t& dx, const vec_t& dy, const vec_t& y, size_t cnt) const override {
+        for (size_t i = 0; i < cnt; i++) dx[i] = dy[i] * (float_t(1) - y[i] * y[i]);
+    }
     std::pair<float_t, float_t> scale() const override { return std::make_pair(float_t(-0.8), float_t(0.8)); }
-
-private:
-    /*float invsqrt(float x) const {
-        float x2 = x * 0.5f;
-        long i = *reinterpret_cast<long*>(&x);
-
-        i = 0x5f3759df - (i >> 1);
-        x = *reinterpret_cast<float*>(&i);
-        x = x * (1.5f - (x2 * x * x));
-        return x;
-    }*/
 };
 
 // s tan_h, but scaled to match the other functions
@@ -179,7 +272,16 @@ public:
         return ep / (ep + std::exp(-v[i]));
     }
 
+    // e^x / (e^x + e^-x) = sigmoid(2x)
+    void itef(vec_t& out, const vec_t& in, size_t cnt) const override {
+        for (size_t i = 0; i < cnt; i++) out[i] = in[i] + in[i];
+        vectorize::sigmoid(out.data(), cnt, out.data());
+    }
+
     float_t df(float_t y) const override { return 2 * y *(float_t(1) - y); }
+    void itedf(vec_t& dx, const vec_t& dy, const vec_t& y, size_t cnt) const override {
+        for (size_t i = 0; i < cnt; i++) dx[i] = dy[i] * 2 * y[i] * (float_t(1) - y[i]);
+    }
     std::pair<float_t, float_t> scale() const override { return std::make_pair(float_t(0.1), float_t(0.9)); }
 };
 
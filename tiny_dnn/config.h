@@ -43,6 +43,16 @@
  */
 //#define CNN_USE_SSE
 
+/**
+ * define to compile sse2/avx/avx2/avx-512 variants of the vectorized
+ * primitives (dot, muladd, reduce, gemm, exp/tanh/sigmoid, max-pooling) and
+ * select one at runtime from the cpu features, so that one binary built
+ * without -mavx runs at full speed on newer machines.
+ * the environment variable TINY_DNN_ISA=generic|sse2|avx|avx2|avx512
+ * lowers the selected level.
+ */
+//#define CNN_USE_RUNTIME_DISPATCH
+
 /**
  * define to enable OMP parallelization
  */
@@ -76,6 +86,24 @@
 #define CNN_TASK_SIZE 8
 #endif
 
+/**
+ * number of threads used by the default parallel_for backend (when neither
+ * TBB nor OMP is enabled), including the calling thread.
+ * 0 means std::thread::hardware_concurrency().
+ * can also be changed at runtime by set_num_threads().
+ */
+#ifndef CNN_THREAD_POOL_SIZE
+#define CNN_THREAD_POOL_SIZE 0
+#endif
+
+/**
+ * default number of samples network::test / get_loss push through the
+ * network at once.
+ */
+#ifndef CNN_EVAL_BATCH_SIZE
+#define CNN_EVAL_BATCH_SIZE 64
+#endif
+
 #if !defined(_MSC_VER) && !defined(_WIN32) && !defined(WIN32)
 #define CNN_USE_GEMMLOWP // gemmlowp doesn't support MSVC/mingw
 #endif
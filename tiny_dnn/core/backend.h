@@ -31,6 +31,7 @@
 #include "tiny_dnn/core/params/deconv_params.h"
 #include "tiny_dnn/core/params/maxpool_params.h"
 #include "tiny_dnn/core/params/fully_params.h"
+#include "tiny_dnn/core/kernels/tiny_quantization_kernel.h"
 
 #ifdef CNN_USE_NNPACK
 #include "nnpack.h"
@@ -42,7 +43,7 @@ namespace core {
 // TODO(edgar): remove this
 class context;
 
-enum class backend_t { internal, nnpack, libdnn, avx, opencl };
+enum class backend_t { internal, nnpack, libdnn, avx, opencl, gemm };
 
 inline std::ostream& operator << (std::ostream& os, backend_t type) {
     switch (type) {
@@ -51,6 +52,7 @@ inline std::ostream& operator << (std::ostream& os, backend_t type) {
         case backend_t::libdnn:   os << "LibDNN";   break;
         case backend_t::avx:      os << "AVX";      break;
         case backend_t::opencl:   os << "OpenCL";   break;
+        case backend_t::gemm:     os << "GEMM";     break;
         default:
             throw nn_error("Not supported ostream enum.");
             break;
@@ -64,6 +66,10 @@ inline backend_t default_engine() {
     return backend_t::avx;
 #endif
 #endif // CNN_USE_AVX
+#ifdef CNN_MULTIVERSION
+    // dispatch builds carry the avx kernels; run them where the cpu allows
+    if (use_isa(cpu_isa::avx2)) return backend_t::avx;
+#endif
     return backend_t::internal;
 }
 
@@ -195,6 +201,34 @@ class backend {
                          std::vector<tensor_t*>&       out_grad,
                          std::vector<tensor_t*>&       in_grad) = 0;
 
+    // uint8 activations in and out, see layer::forward_quantized.
+    // only backends with uint8 kernels override these.
+    virtual void conv2d_qq(const vec_t&                       W,
+                           const vec_t&                       bias,
+                           const quantized_tensor&            in,
+                           const kernels::quantized_epilogue& ep,
+                           quantized_tensor&                  out) {
+        CNN_UNREFERENCED_PARAMETER(W);
+        CNN_UNREFERENCED_PARAMETER(bias);
+        CNN_UNREFERENCED_PARAMETER(in);
+        CNN_UNREFERENCED_PARAMETER(ep);
+        CNN_UNREFERENCED_PARAMETER(out);
+        throw nn_not_implemented_error("uint8 convolution is not supported by this backend");
+    }
+
+    virtual void fully_qq(const vec_t&                       W,
+                          const vec_t&                       bias,
+                          const quantized_tensor&            in,
+                          const kernels::quantized_epilogue& ep,
+                          quantized_tensor&                  out) {
+        CNN_UNREFERENCED_PARAMETER(W);
+        CNN_UNREFERENCED_PARAMETER(bias);
+        CNN_UNREFERENCED_PARAMETER(in);
+        CNN_UNREFERENCED_PARAMETER(ep);
+        CNN_UNREFERENCED_PARAMETER(out);
+        throw nn_not_implemented_error("uint8 fully-connected is not supported by this backend");
+    }
+
     context* get_context() const { return ctx_; }
 
     void set_layer(layerptr_t layer) { layer_ = layer; }
@@ -114,9 +114,32 @@ class tiny_backend : public backend {
 
         fill_tensor(a, float_t(0));
 
+        const kernels::quantized_weights& q = quantized_weights_of(W, bias,
+            [&](kernels::quantized_weights* dst) {
+                kernels::tiny_quantize_conv2d_weights(*params_c_, W, bias, dst);
+            });
+
         for (serial_size_t i = 0; i < in.size(); i++) {
             kernels::tiny_quantized_conv2d_kernel(*params_c_,
-                *in[i], W, bias, a[i], layer_->parallelize());
+                *in[i], q, a[i], layer_->parallelize());
+        }
+    }
+
+    // uint8 convolution, input unpadded
+    void conv2d_qq(const vec_t&                       W,
+                   const vec_t&                       bias,
+                   const quantized_tensor&            in,
+                   const kernels::quantized_epilogue& ep,
+                   quantized_tensor&                  out) override {
+        const kernels::quantized_weights& q = quantized_weights_of(W, bias,
+            [&](kernels::quantized_weights* dst) {
+                kernels::tiny_quantize_conv2d_weights(*params_c_, W, bias, dst);
+            });
+
+        out.resize(in.size());
+        for (size_t i = 0; i < in.size(); i++) {
+            kernels::tiny_quantized_conv2d_kernel(*params_c_,
+                in[i], q, ep, out[i], layer_->parallelize());
         }
     }
 
@@ -197,10 +220,10 @@ class tiny_backend : public backend {
 
         fill_tensor(*prev_delta, float_t(0));
 
-        for (serial_size_t i = 0; i < prev_out.size(); i++) {
+        for_i_slotted(false, prev_out.size(), dW.size(), [&](int slot, int i) {
             kernels::tiny_quantized_conv2d_back_kernel(*params_c_,
-                *prev_out[i], W, dW[i], db[i], curr_delta[i], &(*prev_delta)[i]);
-        }
+                *prev_out[i], W, dW[slot], db[slot], curr_delta[i], &(*prev_delta)[i]);
+        });
 
         if (params_c_->pad_type == padding::same) {
             copy_and_unpad_delta(cws.prev_delta_padded_, *in_grad[0]);
@@ -235,9 +258,14 @@ class tiny_backend : public backend {
 
         fill_tensor(a, float_t(0), params_d_->out.size()); // deconv2d-kernel requires padded size buffer
 
+        const kernels::quantized_weights& q = quantized_weights_of(W, bias,
+            [&](kernels::quantized_weights* dst) {
+                kernels::tiny_quantize_deconv2d_weights(*params_d_, W, bias, dst);
+            });
+
         for (serial_size_t i = 0; i < in.size(); i++) {
             kernels::tiny_quantized_deconv2d_kernel(*params_d_,
-                in[i], W, bias, a[i], layer_->parallelize());
+                in[i], q, a[i], layer_->parallelize());
         }
 
         copy_and_unpad_output(a);
@@ -320,10 +348,10 @@ class tiny_backend : public backend {
 
         fill_tensor(*prev_delta, float_t(0));
 
-        for (serial_size_t i = 0; i < prev_out.size(); i++) {
+        for_i_slotted(false, prev_out.size(), dW.size(), [&](int slot, int i) {
             kernels::tiny_quantized_deconv2d_back_kernel(*params_d_,
-                prev_out[i], W, dW[i], db[i], curr_delta[i], &(*prev_delta)[i]);
-        }
+                prev_out[i], W, dW[slot], db[slot], curr_delta[i], &(*prev_delta)[i]);
+        });
     }
 
     void maxpool(const std::vector<tensor_t*>& in_data,
@@ -381,18 +409,50 @@ class tiny_backend : public backend {
 #ifdef CNN_USE_GEMMLOWP
         const tensor_t& in = *in_data[0];
         const vec_t&    W  = (*in_data[1])[0];
+        const vec_t     no_bias;
+        const vec_t&    b  = params_f_->has_bias_ ? (*in_data[2])[0] : no_bias;
         tensor_t&       a  = *out_data[1];
 
+        const kernels::quantized_weights& q = quantized_weights_of(W, b,
+            [&](kernels::quantized_weights* dst) {
+                kernels::tiny_quantize_fully_connected_weights(*params_f_, W, b, dst);
+            });
+
         for (serial_size_t i = 0; i < in.size(); i++) {
             kernels::tiny_quantized_fully_connected_kernel(*params_f_,
-                in[i], W,  params_f_->has_bias_ ? (*in_data[2])[0] : vec_t(),
-                a[i], layer_->parallelize());
+                in[i], q, a[i], layer_->parallelize());
         }
 #else
         throw nn_not_implemented_error("quantized fully op requires gemmlowp library. please define CNN_USE_GEMMLOWP");
 #endif
     }
 
+    void fully_qq(const vec_t&                       W,
+                  const vec_t&                       bias,
+                  const quantized_tensor&            in,
+                  const kernels::quantized_epilogue& ep,
+                  quantized_tensor&                  out) override {
+#ifdef CNN_USE_GEMMLOWP
+        const kernels::quantized_weights& q = quantized_weights_of(W, bias,
+            [&](kernels::quantized_weights* dst) {
+                kernels::tiny_quantize_fully_connected_weights(*params_f_, W, bias, dst);
+            });
+
+        out.resize(in.size());
+        for (size_t i = 0; i < in.size(); i++) {
+            kernels::tiny_quantized_fully_connected_kernel(*params_f_,
+                in[i], q, ep, out[i], layer_->parallelize());
+        }
+#else
+        CNN_UNREFERENCED_PARAMETER(W);
+        CNN_UNREFERENCED_PARAMETER(bias);
+        CNN_UNREFERENCED_PARAMETER(in);
+        CNN_UNREFERENCED_PARAMETER(ep);
+        CNN_UNREFERENCED_PARAMETER(out);
+        throw nn_not_implemented_error("quantized fully op requires gemmlowp library. please define CNN_USE_GEMMLOWP");
+#endif
+    }
+
     void fully_eq(const std::vector<tensor_t*>& in_data,
                   std::vector<tensor_t*>&       out_data) override {
 #ifdef CNN_USE_GEMMLOWP
@@ -449,10 +509,10 @@ class tiny_backend : public backend {
 
         backward_activation(*out_grad[0], *out_data[0], curr_delta);
 
-        for (serial_size_t i = 0; i < prev_out.size(); i++) {
+        for_i_slotted(false, prev_out.size(), dW.size(), [&](int slot, int i) {
             kernels::tiny_quantized_fully_connected_back_kernel(*params_f_, prev_out[i],
-                W, dW[i], prev_delta[i], curr_delta[i], db[i], layer_->parallelize());
-        }
+                W, dW[slot], prev_delta[i], curr_delta[i], db[slot], layer_->parallelize());
+        });
 #else
         throw nn_not_implemented_error("quantized fully op requires gemmlowp library. please define CNN_USE_GEMMLOWP");
 #endif
@@ -461,6 +521,34 @@ class tiny_backend : public backend {
     backend_t type() const override { return default_engine(); }
 
  private:
+    /* quantized form of the layer's own weights, rebuilt only when
+     * layer::weights_version changes. weights which don't belong to the
+     * layer (e.g. tensors passed to forward_propagation directly) are
+     * quantized on every call. */
+    template <typename Quantize>
+    const kernels::quantized_weights& quantized_weights_of(const vec_t& W,
+                                                           const vec_t& bias,
+                                                           Quantize quantize) {
+        const layer* l = layer_;
+
+        // an empty bias stands for a layer without one
+        if (!l->owns_weight(W) || (!bias.empty() && !l->owns_weight(bias))) {
+            quantize(&scratch_weights_);
+            return scratch_weights_;
+        }
+
+        if (!cached_weights_.valid ||
+            cached_weights_.version != l->weights_version()) {
+            quantize(&cached_weights_);
+            cached_weights_.version = l->weights_version();
+            cached_weights_.valid = true;
+        }
+        return cached_weights_;
+    }
+
+    kernels::quantized_weights cached_weights_;
+    kernels::quantized_weights scratch_weights_;
+
     /* Pointer to the convolution parameters */
     conv_params* params_c_;
     deconv_params* params_d_;
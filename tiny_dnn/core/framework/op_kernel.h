@@ -46,6 +46,7 @@
 
 #include "tiny_dnn/core/framework/device.fwd.h"
 #include "tiny_dnn/core/params/conv_params.h"
+#include "tiny_dnn/activations/activation_function.h"
 
 namespace tiny_dnn {
 namespace core {
@@ -88,13 +89,16 @@ class OpKernelContext {
         bool parallelize = false;
 
         backend_t engine = default_engine();
+
+        // activation applied by the kernel to each computed sample
+        activation::epilogue epilogue;
     };
 
+    OpKernelContext() {}
+
     explicit OpKernelContext(const std::vector<tensor_t*>& in_data,
                              std::vector<tensor_t*>&       out_data)
-            : in_data_(in_data), out_data_(out_data) {
-        op_params_ = std::unique_ptr<OpParams>(new OpParams());
-    }
+            : in_data_(in_data), out_data_(out_data) {}
 
     explicit OpKernelContext(const std::vector<tensor_t*>& in_data,
                              const std::vector<tensor_t*>& out_data,
@@ -103,8 +107,26 @@ class OpKernelContext {
             : in_data_(in_data)
             , out_data_(out_data)
             , out_grad_(out_grad)
-            , in_grad_(in_grad) {
-        op_params_ = std::unique_ptr<OpParams>(new OpParams());
+            , in_grad_(in_grad) {}
+
+    /**
+     * rebind the tensors of a context kept across calls.
+     * the pointer vectors keep their capacity, so once a layer has run
+     * this does not allocate.
+     **/
+    void bind(const std::vector<tensor_t*>& in_data,
+              const std::vector<tensor_t*>& out_data) {
+        in_data_.assign(in_data.begin(), in_data.end());
+        out_data_.assign(out_data.begin(), out_data.end());
+    }
+
+    void bind(const std::vector<tensor_t*>& in_data,
+              const std::vector<tensor_t*>& out_data,
+              const std::vector<tensor_t*>& out_grad,
+              const std::vector<tensor_t*>& in_grad) {
+        bind(in_data, out_data);
+        out_grad_.assign(out_grad.begin(), out_grad.end());
+        in_grad_.assign(in_grad.begin(), in_grad.end());
     }
 
     tensor_t& input(const int idx) const {
@@ -124,43 +146,51 @@ class OpKernelContext {
     }
 
     void setParams(Params* params) {
-        op_params_->params_ptr_ = params;
+        op_params_.params_ptr_ = params;
     }
 
     Params* params() const {
-        return op_params_->params_ptr_;
+        return op_params_.params_ptr_;
     }
 
     void setParallelize(const bool parallelize) {
-        op_params_->parallelize = parallelize;
+        op_params_.parallelize = parallelize;
     }
 
     bool parallelize() const {
-        return op_params_->parallelize;
+        return op_params_.parallelize;
     }
 
     void setDevice(Device* device) {
-        op_params_->device_ptr = device;
+        op_params_.device_ptr = device;
     }
 
     Device* device() const {
-        return op_params_->device_ptr;
+        return op_params_.device_ptr;
     }
 
     void setLayer(layer* layer) {
-        op_params_->layer_ptr_ = layer;
+        op_params_.layer_ptr_ = layer;
     }
 
     layer* Layer() const {
-        return op_params_->layer_ptr_;
+        return op_params_.layer_ptr_;
     }
 
     backend_t engine() const {
-        return op_params_->engine;
+        return op_params_.engine;
     }
 
     void setEngine(const backend_t engine) {
-        op_params_->engine = engine;
+        op_params_.engine = engine;
+    }
+
+    const activation::epilogue& epilogue() const {
+        return op_params_.epilogue;
+    }
+
+    void setEpilogue(const activation::epilogue& epilogue) {
+        op_params_.epilogue = epilogue;
     }
 
  private:
@@ -169,7 +199,7 @@ class OpKernelContext {
     std::vector<tensor_t*> out_grad_;
     std::vector<tensor_t*> in_grad_;
 
-    std::unique_ptr<OpParams> op_params_;
+    OpParams op_params_;
 };
 
 class OpKernel {
@@ -183,6 +213,9 @@ class OpKernel {
 
     virtual void compute(const OpKernelContext& context) = 0;
 
+    // true if compute() applies the epilogue set in the context
+    virtual bool fusesEpilogue() const { return false; }
+
  protected:
     Device* device_ = nullptr;
     Params* params_ = nullptr;
@@ -0,0 +1,566 @@
+/*
+    Copyright (c) 2016, Taiga Nomi
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+#include "tiny_dnn/activations/activation_function.h"
+#include "tiny_dnn/core/params/conv_params.h"
+#include "tiny_dnn/util/cpu_features.h"
+
+/**
+ * register-blocked convolution kernels for any kernel shape and stride,
+ * used by the avx backend where no specialized kernel exists.
+ * float only; compiled with -mavx (fma if enabled) or, with runtime
+ * dispatch, for avx2+fma and chosen when the cpu supports it.
+ */
+#if (defined(CNN_USE_AVX) || defined(CNN_MULTIVERSION)) && !defined(CNN_USE_DOUBLE)
+#define CNN_AVX_CONV_BLOCKED
+#endif
+
+#ifdef CNN_AVX_CONV_BLOCKED
+
+namespace tiny_dnn {
+namespace kernels {
+namespace avx_conv_detail {
+
+// channels per register block: output channels in the forward pass and
+// for dW, input channels when propagating delta. the tiles below are
+// written out for 4 accumulator rows.
+static const serial_size_t CB = 4;
+
+/**
+ * CHW tensor with each row split into stride phases: column j * s + p of
+ * row r in channel c is row(c, r, p)[j]. with s == 1 this is the tensor
+ * itself. horizontally strided taps thus read consecutive addresses.
+ **/
+struct phase_view {
+    float* data;
+    serial_size_t height;
+    serial_size_t width;   // of a phase row
+    serial_size_t stride;
+
+    float* row(serial_size_t c, serial_size_t r, serial_size_t p) const {
+        return data + ((static_cast<size_t>(c) * height + r) * stride + p) * width;
+    }
+
+    size_t channel_size() const { return static_cast<size_t>(height) * stride * width; }
+    size_t row_size() const { return static_cast<size_t>(stride) * width; }
+
+    // offset of the input read by tap (ky, kx) for output (0, 0)
+    size_t tap(serial_size_t ky, serial_size_t kx) const {
+        return (static_cast<size_t>(ky) * stride + kx % stride) * width + kx / stride;
+    }
+};
+
+inline bool use_blocked_kernels() {
+#ifdef CNN_MULTIVERSION
+    return use_isa(cpu_isa::avx2);
+#else
+    return true;
+#endif
+}
+
+inline vec_t& packed_weights() {
+    static thread_local vec_t buf;
+    return buf;
+}
+
+inline std::vector<char>& packed_connections() {
+    static thread_local std::vector<char> buf;
+    return buf;
+}
+
+inline std::vector<char>& forward_connections() {
+    static thread_local std::vector<char> buf;
+    return buf;
+}
+
+inline vec_t& phase_buffer() {
+    static thread_local vec_t buf;
+    return buf;
+}
+
+inline vec_t& delta_phase_buffer() {
+    static thread_local vec_t buf;
+    return buf;
+}
+
+// tap offsets in ky, kx order
+inline const size_t* tap_offsets(const core::conv_params& params,
+                                 const phase_view& v) {
+    static thread_local std::vector<size_t> taps;
+    taps.resize(params.weight.height_ * params.weight.width_);
+    for (serial_size_t ky = 0, k = 0; ky < params.weight.height_; ky++)
+        for (serial_size_t kx = 0; kx < params.weight.width_; kx++) taps[k++] = v.tap(ky, kx);
+    return &taps[0];
+}
+
+// zero-filled phase view of a depth x height x width tensor
+inline phase_view make_phases(serial_size_t depth, serial_size_t height,
+                              serial_size_t width, serial_size_t s, vec_t& buf) {
+    const serial_size_t wq = (width + s - 1) / s;
+    buf.assign(static_cast<size_t>(depth) * height * s * wq, float_t(0));
+    phase_view v = { &buf[0], height, wq, s };
+    return v;
+}
+
+inline phase_view split_phases(const float* src, serial_size_t depth,
+                               serial_size_t height, serial_size_t width,
+                               serial_size_t s, vec_t& buf) {
+    if (s == 1) {
+        phase_view v = { const_cast<float*>(src), height, width, 1 };
+        return v;
+    }
+    phase_view v = make_phases(depth, height, width, s, buf);
+    for (serial_size_t c = 0; c < depth; c++) {
+        for (serial_size_t r = 0; r < height; r++, src += width) {
+            for (serial_size_t p = 0; p < s; p++) {
+                float* dst = v.row(c, r, p);
+                for (serial_size_t x = p, j = 0; x < width; x += s, j++) dst[j] = src[x];
+            }
+        }
+    }
+    return v;
+}
+
+// dst += v, dst in plain CHW layout
+inline void merge_phases(const phase_view& v, serial_size_t depth,
+                         serial_size_t width, float* dst) {
+    for (serial_size_t c = 0; c < depth; c++) {
+        for (serial_size_t r = 0; r < v.height; r++, dst += width) {
+            for (serial_size_t p = 0; p < v.stride; p++) {
+                const float* src = v.row(c, r, p);
+                for (serial_size_t x = p, j = 0; x < width; x += v.stride, j++) dst[x] += src[j];
+            }
+        }
+    }
+}
+
+/**
+ * forward weights as [out block][in][ky][kx][CB], backward weights as
+ * [in block][ky][kx][out][CB]. pairs missing from the connection table and
+ * channels past the last block are zero; connected[block * n + other]
+ * tells whether any channel of the block uses the other one.
+ **/
+inline void pack_weights(const core::conv_params& params, const vec_t& W,
+                         bool backward, vec_t& packed,
+                         std::vector<char>& connected) {
+    const serial_size_t ic = params.in.depth_;
+    const serial_size_t oc = params.out.depth_;
+    const serial_size_t ksize = params.weight.width_ * params.weight.height_;
+    const serial_size_t blocked = backward ? ic : oc;
+    const serial_size_t other = backward ? oc : ic;
+    const serial_size_t nblocks = (blocked + CB - 1) / CB;
+
+    packed.assign(static_cast<size_t>(nblocks) * other * ksize * CB, float_t(0));
+    connected.assign(static_cast<size_t>(nblocks) * other, 0);
+
+    for (serial_size_t o = 0; o < oc; o++) {
+        for (serial_size_t i = 0; i < ic; i++) {
+            if (!params.tbl.is_connected(o, i)) continue;
+            const float* w = &W[params.weight.get_index(0, 0, ic * o + i)];
+            const serial_size_t b = backward ? i / CB : o / CB;
+            const serial_size_t c = backward ? i % CB : o % CB;
+            const serial_size_t n = backward ? o : i;
+            connected[b * other + n] = 1;
+            for (serial_size_t k = 0; k < ksize; k++) {
+                const size_t idx = backward
+                    ? ((static_cast<size_t>(b) * ksize + k) * other + n) * CB + c
+                    : ((static_cast<size_t>(b) * other + n) * ksize + k) * CB + c;
+                packed[idx] = w[k];
+            }
+        }
+    }
+}
+
+CNN_TARGET_PUSH("avx2,fma")
+
+inline __m256 fmadd_ps(__m256 a, __m256 b, __m256 c) {
+#if defined(__FMA__) || defined(CNN_MULTIVERSION)
+    return _mm256_fmadd_ps(a, b, c);
+#else
+    return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#endif
+}
+
+inline float hsum_ps(__m256 x) {
+    __m128 y = _mm_add_ps(_mm256_castps256_ps128(x), _mm256_extractf128_ps(x, 1));
+    y = _mm_add_ps(y, _mm_movehl_ps(y, y));
+    y = _mm_add_ss(y, _mm_shuffle_ps(y, y, 1));
+    return _mm_cvtss_f32(y);
+}
+
+// dst[0 : 8 * NV] = (a, b) + bias
+template <int NV>
+inline void store_tile(float* dst, __m256 a, __m256 b, float bias) {
+    const __m256 vb = _mm256_set1_ps(bias);
+    _mm256_storeu_ps(dst, _mm256_add_ps(a, vb));
+    if (NV == 2) _mm256_storeu_ps(dst + 8, _mm256_add_ps(b, vb));
+}
+
+// dst[0 : 8 * NV] += (a, b)
+template <int NV>
+inline void add_tile(float* dst, __m256 a, __m256 b) {
+    _mm256_storeu_ps(dst, _mm256_add_ps(_mm256_loadu_ps(dst), a));
+    if (NV == 2) _mm256_storeu_ps(dst + 8, _mm256_add_ps(_mm256_loadu_ps(dst + 8), b));
+}
+
+// out[o0 + c][y][x : x + 8 * NV] = bias + sum over inputs and taps,
+// src points to input (0, y * h_stride, x * w_stride) of channel 0
+template <int NV>
+inline void forward_tile(const core::conv_params& params, const float* src,
+                         size_t channel_size, const size_t* taps,
+                         const float* w, const char* connected,
+                         const float* bias, float* const* dst,
+                         serial_size_t nb, serial_size_t x) {
+    const serial_size_t ksize = params.weight.height_ * params.weight.width_;
+
+    // columns x .. x + 7 in a*, x + 8 .. x + 15 in b* (NV == 2)
+    __m256 a0 = _mm256_setzero_ps(), a1 = a0, a2 = a0, a3 = a0;
+    __m256 b0 = a0, b1 = a0, b2 = a0, b3 = a0;
+
+    for (serial_size_t inc = 0; inc < params.in.depth_;
+         inc++, w += ksize * CB, src += channel_size) {
+        if (!connected[inc]) continue;
+        const float* pw = w;
+        for (serial_size_t k = 0; k < ksize; k++, pw += CB) {
+            const float* pi = src + taps[k];
+            const __m256 w0 = _mm256_broadcast_ss(pw + 0);
+            const __m256 w1 = _mm256_broadcast_ss(pw + 1);
+            const __m256 w2 = _mm256_broadcast_ss(pw + 2);
+            const __m256 w3 = _mm256_broadcast_ss(pw + 3);
+            const __m256 i0 = _mm256_loadu_ps(pi);
+            a0 = fmadd_ps(w0, i0, a0);
+            a1 = fmadd_ps(w1, i0, a1);
+            a2 = fmadd_ps(w2, i0, a2);
+            a3 = fmadd_ps(w3, i0, a3);
+            if (NV == 2) {
+                const __m256 i1 = _mm256_loadu_ps(pi + 8);
+                b0 = fmadd_ps(w0, i1, b0);
+                b1 = fmadd_ps(w1, i1, b1);
+                b2 = fmadd_ps(w2, i1, b2);
+                b3 = fmadd_ps(w3, i1, b3);
+            }
+        }
+    }
+
+    store_tile<NV>(dst[0] + x, a0, b0, bias[0]);
+    if (nb > 1) store_tile<NV>(dst[1] + x, a1, b1, bias[1]);
+    if (nb > 2) store_tile<NV>(dst[2] + x, a2, b2, bias[2]);
+    if (nb > 3) store_tile<NV>(dst[3] + x, a3, b3, bias[3]);
+}
+
+// forward pass of one sample; out is written, not accumulated
+inline void forward_sample(const core::conv_params& params, const phase_view& in,
+                           const size_t* taps, const float* wpk,
+                           const char* connected, const vec_t& bias, float* out) {
+    const serial_size_t ic = params.in.depth_;
+    const serial_size_t oc = params.out.depth_;
+    const serial_size_t oh = params.out.height_;
+    const serial_size_t ow = params.out.width_;
+    const serial_size_t ksize = params.weight.height_ * params.weight.width_;
+    const size_t chan = in.channel_size();
+
+    for (serial_size_t o0 = 0; o0 < oc; o0 += CB) {
+        const serial_size_t nb = std::min(CB, oc - o0);
+        const float* w = wpk + static_cast<size_t>(o0) * ic * ksize;
+        const char* conn = connected + (o0 / CB) * ic;
+        float b[CB] = { 0 };
+        for (serial_size_t c = 0; c < nb && params.has_bias; c++) b[c] = bias[o0 + c];
+
+        for (serial_size_t y = 0; y < oh; y++) {
+            const float* src = in.data + y * params.h_stride * in.row_size();
+            float* dst[CB];
+            for (serial_size_t c = 0; c < nb; c++) dst[c] = out + ((o0 + c) * oh + y) * ow;
+
+            serial_size_t x = 0;
+            for (; x + 16 <= ow; x += 16)
+                forward_tile<2>(params, src + x, chan, taps, w, conn, b, dst, nb, x);
+            for (; x + 8 <= ow; x += 8)
+                forward_tile<1>(params, src + x, chan, taps, w, conn, b, dst, nb, x);
+
+            for (; x < ow; x++) {
+                float acc[CB] = { 0 };
+                const float* pw = w;
+                for (serial_size_t inc = 0; inc < ic; inc++, pw += ksize * CB) {
+                    if (!conn[inc]) continue;
+                    const float* pi = src + inc * chan + x;
+                    for (serial_size_t k = 0; k < ksize; k++) {
+                        for (serial_size_t c = 0; c < CB; c++) acc[c] += pw[k * CB + c] * pi[taps[k]];
+                    }
+                }
+                for (serial_size_t c = 0; c < nb; c++) dst[c][x] = acc[c] + b[c];
+            }
+        }
+    }
+}
+
+// prev_delta[c0 + c][y * h_stride + ky][(x + j) * w_stride + kx] +=
+//     sum_o W[o][c0 + c][ky][kx] * delta[o][y][x + j], for j < 8 * NV.
+// dst points to prev_delta (0, y * h_stride, x * w_stride) of channel c0
+template <int NV>
+inline void delta_tile(const core::conv_params& params, const float* w,
+                       const char* connected, const float* delta,
+                       float* dst, size_t channel_size, const size_t* taps,
+                       serial_size_t nb) {
+    const serial_size_t oc = params.out.depth_;
+    const size_t oarea = params.out.area();
+    const serial_size_t ksize = params.weight.height_ * params.weight.width_;
+
+    for (serial_size_t k = 0; k < ksize; k++, w += oc * CB) {
+        __m256 a0 = _mm256_setzero_ps(), a1 = a0, a2 = a0, a3 = a0;
+        __m256 b0 = a0, b1 = a0, b2 = a0, b3 = a0;
+
+        const float* pw = w;
+        const float* pd = delta;
+        for (serial_size_t o = 0; o < oc; o++, pw += CB, pd += oarea) {
+            if (!connected[o]) continue;
+            const __m256 w0 = _mm256_broadcast_ss(pw + 0);
+            const __m256 w1 = _mm256_broadcast_ss(pw + 1);
+            const __m256 w2 = _mm256_broadcast_ss(pw + 2);
+            const __m256 w3 = _mm256_broadcast_ss(pw + 3);
+            const __m256 d0 = _mm256_loadu_ps(pd);
+            a0 = fmadd_ps(w0, d0, a0);
+            a1 = fmadd_ps(w1, d0, a1);
+            a2 = fmadd_ps(w2, d0, a2);
+            a3 = fmadd_ps(w3, d0, a3);
+            if (NV == 2) {
+                const __m256 d1 = _mm256_loadu_ps(pd + 8);
+                b0 = fmadd_ps(w0, d1, b0);
+                b1 = fmadd_ps(w1, d1, b1);
+                b2 = fmadd_ps(w2, d1, b2);
+                b3 = fmadd_ps(w3, d1, b3);
+            }
+        }
+
+        float* p = dst + taps[k];
+        add_tile<NV>(p, a0, b0);
+        if (nb > 1) add_tile<NV>(p + channel_size, a1, b1);
+        if (nb > 2) add_tile<NV>(p + 2 * channel_size, a2, b2);
+        if (nb > 3) add_tile<NV>(p + 3 * channel_size, a3, b3);
+    }
+}
+
+// propagate delta of one sample into pd (accumulated)
+inline void delta_sample(const core::conv_params& params, const float* wpk,
+                         const char* connected, const float* delta,
+                         const phase_view& pd, const size_t* taps) {
+    const serial_size_t ic = params.in.depth_;
+    const serial_size_t oc = params.out.depth_;
+    const serial_size_t oh = params.out.height_;
+    const serial_size_t ow = params.out.width_;
+    const serial_size_t ksize = params.weight.height_ * params.weight.width_;
+    const size_t oarea = params.out.area();
+    const size_t chan = pd.channel_size();
+
+    for (serial_size_t c0 = 0; c0 < ic; c0 += CB) {
+        const serial_size_t nb = std::min(CB, ic - c0);
+        const char* conn = connected + (c0 / CB) * oc;
+        const float* w = wpk + static_cast<size_t>(c0) * ksize * oc;
+
+        for (serial_size_t y = 0; y < oh; y++) {
+            float* dst = pd.data + c0 * chan + y * params.h_stride * pd.row_size();
+            const float* src = delta + y * ow;
+
+            serial_size_t x = 0;
+            for (; x + 16 <= ow; x += 16)
+                delta_tile<2>(params, w, conn, src + x, dst + x, chan, taps, nb);
+            for (; x + 8 <= ow; x += 8)
+                delta_tile<1>(params, w, conn, src + x, dst + x, chan, taps, nb);
+
+            for (; x < ow; x++) {
+                const float* pw = w;
+                for (serial_size_t k = 0; k < ksize; k++, pw += oc * CB) {
+                    float acc[CB] = { 0 };
+                    for (serial_size_t o = 0; o < oc; o++) {
+                        if (!conn[o]) continue;
+                        const float d = src[o * oarea + x];
+                        for (serial_size_t c = 0; c < CB; c++) acc[c] += pw[o * CB + c] * d;
+                    }
+                    for (serial_size_t c = 0; c < nb; c++) dst[c * chan + taps[k] + x] += acc[c];
+                }
+            }
+        }
+    }
+}
+
+// dW[o][inc][ky][kx] += sum_{y,x} delta[o][y][x] * in[inc][y * hs + ky][x * ws + kx]
+// for connected pairs, CB output channels sharing each input load
+inline void weight_grad_sample(const core::conv_params& params,
+                               const phase_view& in, const size_t* taps,
+                               const char* connected, const float* delta,
+                               float* dw) {
+    const serial_size_t ic = params.in.depth_;
+    const serial_size_t oc = params.out.depth_;
+    const serial_size_t oh = params.out.height_;
+    const serial_size_t ow = params.out.width_;
+    const serial_size_t ksize = params.weight.height_ * params.weight.width_;
+    const size_t in_row = params.h_stride * in.row_size();
+
+    for (serial_size_t o0 = 0; o0 < oc; o0 += CB) {
+        const serial_size_t nb = std::min(CB, oc - o0);
+        // channels past the last block repeat o0 and are discarded
+        const float* d0[CB];
+        for (serial_size_t c = 0; c < CB; c++)
+            d0[c] = delta + (o0 + (c < nb ? c : 0)) * oh * ow;
+
+        for (serial_size_t inc = 0; inc < ic; inc++) {
+            if (!connected[(o0 / CB) * ic + inc]) continue;
+
+            for (serial_size_t k = 0; k < ksize; k++) {
+                __m256 a0 = _mm256_setzero_ps(), a1 = a0, a2 = a0, a3 = a0;
+                float tail[CB] = { 0 };
+
+                const float* src = in.data + inc * in.channel_size() + taps[k];
+                for (serial_size_t y = 0; y < oh; y++, src += in_row) {
+                    const size_t row = static_cast<size_t>(y) * ow;
+                    serial_size_t x = 0;
+                    for (; x + 8 <= ow; x += 8) {
+                        const __m256 i = _mm256_loadu_ps(src + x);
+                        a0 = fmadd_ps(_mm256_loadu_ps(d0[0] + row + x), i, a0);
+                        a1 = fmadd_ps(_mm256_loadu_ps(d0[1] + row + x), i, a1);
+                        a2 = fmadd_ps(_mm256_loadu_ps(d0[2] + row + x), i, a2);
+                        a3 = fmadd_ps(_mm256_loadu_ps(d0[3] + row + x), i, a3);
+                    }
+                    for (; x < ow; x++) {
+                        for (serial_size_t c = 0; c < CB; c++) tail[c] += d0[c][row + x] * src[x];
+                    }
+                }
+
+                const float sum[CB] = { hsum_ps(a0), hsum_ps(a1), hsum_ps(a2), hsum_ps(a3) };
+                for (serial_size_t c = 0; c < nb; c++) {
+                    if (!params.tbl.is_connected(o0 + c, inc)) continue;
+                    dw[(static_cast<size_t>(ic) * (o0 + c) + inc) * ksize + k] +=
+                        sum[c] + tail[c];
+                }
+            }
+        }
+    }
+}
+
+CNN_TARGET_POP
+
+}  // namespace avx_conv_detail
+
+/**
+ * forward convolution, CB output channels x 8/16 output columns per
+ * register tile. the input of each tap is one unaligned load, for strided
+ * layers after splitting input rows into stride phases.
+ **/
+inline void
+conv2d_op_avx_blocked(const tensor_t&          in_data,
+                      const vec_t&             W,
+                      const vec_t&             bias,
+                      tensor_t&                out_data,
+                      const core::conv_params& params,
+                      const bool               parallelize,
+                      const activation::epilogue& ep) {
+    using namespace avx_conv_detail;
+
+    vec_t& wpk = packed_weights();
+    std::vector<char>& connected = packed_connections();
+    pack_weights(params, W, false, wpk, connected);
+
+    for_i(parallelize, in_data.size(), [&](int sample) {
+        const phase_view in = split_phases(
+            &in_data[sample][0], params.in.depth_, params.in_padded.height_,
+            params.in_padded.width_, params.w_stride, phase_buffer());
+        forward_sample(params, in, tap_offsets(params, in), &wpk[0],
+                       &connected[0], bias, &out_data[sample][0]);
+        ep(out_data, sample);
+    });
+}
+
+/**
+ * backward convolution: delta is propagated with CB input channels per
+ * tile (reducing over output channels), dW with CB output channels per
+ * input load. stride phases are used as in the forward pass.
+ **/
+inline void
+conv2d_grad_op_avx_blocked(const tensor_t&          prev_out,
+                           const vec_t&             W,
+                           tensor_t&                dW,
+                           tensor_t&                db,
+                           tensor_t&                curr_delta,
+                           tensor_t&                prev_delta,
+                           const core::conv_params& params,
+                           const bool               parallelize) {
+    using namespace avx_conv_detail;
+
+    vec_t& wpk = packed_weights();
+    std::vector<char>& connected = packed_connections();
+    pack_weights(params, W, true, wpk, connected);
+
+    // forward layout connections, for dW
+    std::vector<char>& out_connected = forward_connections();
+    out_connected.assign((params.out.depth_ + CB - 1) / CB * params.in.depth_, 0);
+    for (serial_size_t o = 0; o < params.out.depth_; o++)
+        for (serial_size_t i = 0; i < params.in.depth_; i++)
+            if (params.tbl.is_connected(o, i)) out_connected[(o / CB) * params.in.depth_ + i] = 1;
+
+    const serial_size_t s = params.w_stride;
+    const serial_size_t ih = params.in_padded.height_;
+    const serial_size_t iw = params.in_padded.width_;
+
+    for_i_slotted(parallelize, prev_out.size(), dW.size(), [&](int slot, int sample) {
+        const float* delta = &curr_delta[sample][0];
+
+        const phase_view in = split_phases(&prev_out[sample][0], params.in.depth_,
+                                           ih, iw, s, phase_buffer());
+        weight_grad_sample(params, in, tap_offsets(params, in), &out_connected[0],
+                           delta, &dW[slot][0]);
+
+        float* pdelta = &prev_delta[sample][0];
+        if (s == 1) {
+            const phase_view pd = { pdelta, ih, iw, 1 };
+            delta_sample(params, &wpk[0], &connected[0], delta, pd,
+                         tap_offsets(params, pd));
+        } else {
+            const phase_view pd = make_phases(params.in.depth_, ih, iw, s,
+                                              delta_phase_buffer());
+            delta_sample(params, &wpk[0], &connected[0], delta, pd,
+                         tap_offsets(params, pd));
+            merge_phases(pd, params.in.depth_, iw, pdelta);
+        }
+
+        if (params.has_bias) {
+            const size_t area = params.out.area();
+            for (serial_size_t o = 0; o < params.out.depth_; o++) {
+                db[slot][o] += std::accumulate(delta + o * area,
+                                               delta + (o + 1) * area, float_t(0));
+            }
+        }
+    });
+}
+
+}  // namespace kernels
+}  // namespace tiny_dnn
+
+#endif  // CNN_AVX_CONV_BLOCKED
@@ -47,6 +47,7 @@
 #include "tiny_dnn/core/framework/op_kernel.h"
 
 #include "tiny_dnn/core/kernels/conv2d_grad_op_avx.h"
+#include "tiny_dnn/core/kernels/conv2d_op_gemm.h"
 #include "tiny_dnn/core/kernels/conv2d_op_internal.h"
 
 namespace tiny_dnn {
@@ -57,7 +58,7 @@ class Conv2dGradOp : public core::OpKernel {
         : core::OpKernel(context) {}
 
     void compute(const core::OpKernelContext& context) override {
-        auto params = OpKernel::params_->conv();
+        const auto& params = OpKernel::params_->conv();
 
         // incoming/outcoming data
         const tensor_t& prev_out = context.input(0);
@@ -95,12 +96,28 @@ class Conv2dGradOp : public core::OpKernel {
                 curr_delta,
                 prev_delta,
                 params,
+                im2col_,
+                context.parallelize());
+        }
+        else if (engine == core::backend_t::gemm) {
+            kernels::conv2d_op_gemm(
+                prev_out,
+                W[0],
+                dW,
+                db,
+                curr_delta,
+                prev_delta,
+                params,
+                im2col_.get(params),
                 context.parallelize());
         }
         else {
             throw nn_error("Not supported engine: " + to_string(engine));
         }
     }
+
+ private:
+    kernels::im2col_index_cache im2col_;
 };
 
 }  // namespace tiny_dnn
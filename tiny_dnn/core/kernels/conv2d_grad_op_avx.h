@@ -7,6 +7,8 @@
 #include <vector>
 #include "tiny_dnn/core/params/conv_params.h"
 #include "tiny_dnn/core/kernels/conv2d_op_internal.h"
+#include "tiny_dnn/core/kernels/conv2d_op_gemm.h"
+#include "tiny_dnn/core/kernels/avx_conv2d_blocked_kernel.h"
 
 #ifdef CNN_USE_AVX
 #include "tiny_dnn/core/kernels/avx_kernel_common.h"
@@ -578,9 +580,9 @@ void avx_conv2d_5x5_back_kernel(
     std::vector<std::vector<float, Allocator>>&       curr_delta,
     std::vector<std::vector<float, Allocator>>&       prev_delta
 ) {
-    for_i(prev_out.size(), [&](int sample) {
+    for_i_slotted(true, prev_out.size(), dW.size(), [&](int slot, int sample) {
         avx_conv2d_5x5_back_kernel_one(
-            params, prev_out[sample], W, dW[sample], db[sample],
+            params, prev_out[sample], W, dW[slot], db[slot],
             curr_delta[sample], &prev_delta[sample]);
     });
 } 
@@ -596,6 +598,7 @@ conv2d_grad_op_avx(const tensor_t&        prev_out,
                    tensor_t&            curr_delta,
                    tensor_t&            prev_delta,
                    const core::conv_params& params,
+                   im2col_index_cache&      im2col,
                    const bool    layer_parallelize) {
 #ifdef CNN_USE_AVX
     if (params.weight.height_ == 5 && params.weight.width_ == 5) {
@@ -604,6 +607,18 @@ conv2d_grad_op_avx(const tensor_t&        prev_out,
         return;
     }
 #endif
+    if (params.weight.height_ == 1 && params.weight.width_ == 1) {
+        conv2d_op_gemm(prev_out, W, dW, db, curr_delta,
+                       prev_delta, params, im2col.get(params), layer_parallelize);
+        return;
+    }
+#ifdef CNN_AVX_CONV_BLOCKED
+    if (avx_conv_detail::use_blocked_kernels()) {
+        conv2d_grad_op_avx_blocked(prev_out, W, dW, db, curr_delta,
+                                   prev_delta, params, layer_parallelize);
+        return;
+    }
+#endif
 
     conv2d_op_internal(prev_out, W, dW, db, curr_delta,
                        prev_delta, params, layer_parallelize);
@@ -45,10 +45,13 @@
 #pragma once
 
 #include "tiny_dnn/core/framework/op_kernel.h"
+#include "tiny_dnn/layers/layer.h"
 
 #include "tiny_dnn/core/kernels/conv2d_op_avx.h"
+#include "tiny_dnn/core/kernels/conv2d_op_gemm.h"
 #include "tiny_dnn/core/kernels/conv2d_op_internal.h"
 #include "tiny_dnn/core/kernels/conv2d_op_nnpack.h"
+#include "tiny_dnn/core/kernels/conv2d_op_winograd.h"
 
 namespace tiny_dnn {
 
@@ -57,8 +60,10 @@ class Conv2dOp : public core::OpKernel {
     explicit Conv2dOp(const core::OpKernelConstruction& context)
         : core::OpKernel(context) {}
 
+    bool fusesEpilogue() const override { return true; }
+
     void compute(const core::OpKernelContext& context) override {
-        auto params = OpKernel::params_->conv();
+        const auto& params = OpKernel::params_->conv();
 
         // incomimg/outcoming data 
         const tensor_t& in_data = context.input(0);
@@ -74,14 +79,35 @@ class Conv2dOp : public core::OpKernel {
 
         const core::backend_t engine = context.engine();
 
-        if (engine == core::backend_t::internal) {
+        // 3x3 stride-1 convolutions on the cpu backends take the Winograd path
+        if ((engine == core::backend_t::internal ||
+             engine == core::backend_t::avx) &&
+            kernels::conv2d_winograd_applicable(params)) {
+            // the filters are transformed again only when the layer's
+            // weights change, or for weights the layer doesn't own
+            const layer* l = context.Layer();
+            size_t version = 0;
+            const bool own = l && l->owns_weight(W[0]);
+            if (own) version = l->weights_version();
+
+            kernels::conv2d_op_winograd(
+                in_data,
+                winograd_filters_.get(W[0], own ? &version : nullptr, params),
+                bias[0],
+                out_data,
+                params,
+                context.parallelize(),
+                context.epilogue());
+        }
+        else if (engine == core::backend_t::internal) {
             kernels::conv2d_op_internal(
                 in_data,
                 W[0],
                 bias[0],
                 out_data,
                 params,
-                context.parallelize());
+                context.parallelize(),
+                context.epilogue());
         }
         else if (engine == core::backend_t::nnpack) {
             kernels::conv2d_op_nnpack(
@@ -90,6 +116,7 @@ class Conv2dOp : public core::OpKernel {
                 bias[0],
                 out_data,
                 params);
+            context.epilogue().apply_all(out_data);
         }
         else if (engine == core::backend_t::avx) {
             kernels::conv2d_op_avx(
@@ -98,12 +125,29 @@ class Conv2dOp : public core::OpKernel {
                 bias[0],
                 out_data,
                 params,
-                context.parallelize());
+                im2col_,
+                context.parallelize(),
+                context.epilogue());
+        }
+        else if (engine == core::backend_t::gemm) {
+            kernels::conv2d_op_gemm(
+                in_data,
+                W[0],
+                bias[0],
+                out_data,
+                params,
+                im2col_.get(params),
+                context.parallelize(),
+                context.epilogue());
         }
         else {
             throw nn_error("Not supported engine: " + to_string(engine));
         }
     }
+
+ private:
+    kernels::winograd_filter_cache winograd_filters_;
+    kernels::im2col_index_cache im2col_;
 };
 
 }  // namespace tiny_dnn
@@ -29,6 +29,8 @@
 #include <vector>
 #include "tiny_dnn/core/params/conv_params.h"
 #include "tiny_dnn/core/kernels/conv2d_op_internal.h"
+#include "tiny_dnn/core/kernels/conv2d_op_gemm.h"
+#include "tiny_dnn/core/kernels/avx_conv2d_blocked_kernel.h"
 
 #ifdef CNN_USE_AVX
 #include "tiny_dnn/core/kernels/avx_kernel_common.h"
@@ -402,17 +404,32 @@ inline void conv2d_op_avx(const tensor_t&         in_data,
                           const vec_t&               bias,
                           tensor_t&              out_data,
                           const core::conv_params& params,
-                          const bool    layer_parallelize) {
+                          im2col_index_cache&      im2col,
+                          const bool    layer_parallelize,
+                          const activation::epilogue& ep = activation::epilogue()) {
 #ifdef CNN_USE_AVX
     if (params.weight.height_ == 5 && params.weight.width_ == 5) {
         // @todo consider better parallelization
         for_i(layer_parallelize, in_data.size(), [&](int i) {
             avx_conv2d_5x5_kernel(params, in_data[i], W, bias, out_data[i], layer_parallelize);
+            ep(out_data, i);
         });
         return;
     }
 #endif
-    conv2d_op_internal(in_data, W, bias, out_data, params, layer_parallelize);
+    // 1x1 convolution is a plain matrix product
+    if (params.weight.height_ == 1 && params.weight.width_ == 1) {
+        conv2d_op_gemm(in_data, W, bias, out_data, params, im2col.get(params),
+                       layer_parallelize, ep);
+        return;
+    }
+#ifdef CNN_AVX_CONV_BLOCKED
+    if (avx_conv_detail::use_blocked_kernels()) {
+        conv2d_op_avx_blocked(in_data, W, bias, out_data, params, layer_parallelize, ep);
+        return;
+    }
+#endif
+    conv2d_op_internal(in_data, W, bias, out_data, params, layer_parallelize, ep);
 }
 
 }  // namespace kernels
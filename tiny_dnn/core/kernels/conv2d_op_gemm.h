@@ -0,0 +1,264 @@
+/*
+    COPYRIGHT
+
+    All contributions by Taiga Nomi
+    Copyright (c) 2013, Taiga Nomi
+    All rights reserved.
+
+    All other contributions:
+    Copyright (c) 2013-2016, the respective contributors.
+    All rights reserved.
+
+    Each contributor holds copyright over their respective contributions.
+    The project versioning (Git) records all such contribution source information.
+
+    LICENSE
+
+    The BSD 3-Clause License
+
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+    * Neither the name of tiny-dnn nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+#include "tiny_dnn/core/params/conv_params.h"
+#include "tiny_dnn/core/kernels/gemm_kernel.h"
+
+namespace tiny_dnn {
+namespace kernels {
+
+namespace conv2d_gemm_detail {
+
+/**
+ * offsets for implicit im2col.
+ *
+ * the lowered input matrix col[K x P] (K = in_depth * kernel_h * kernel_w,
+ * P = out_h * out_w) is never materialized; its element (k, p) is read
+ * directly from the padded input at koff[k] + poff[p].
+ **/
+struct im2col_index {
+    im2col_index() {}
+
+    explicit im2col_index(const core::conv_params& params) {
+        build(params);
+    }
+
+    void build(const core::conv_params& params) {
+        koff.resize(params.in.depth_ * params.weight.height_ * params.weight.width_);
+        poff.resize(params.out.height_ * params.out.width_);
+
+        const serial_size_t iw = params.in_padded.width_;
+        const serial_size_t ih = params.in_padded.height_;
+        serial_size_t k = 0;
+        for (serial_size_t c = 0; c < params.in.depth_; c++) {
+            for (serial_size_t wy = 0; wy < params.weight.height_; wy++) {
+                for (serial_size_t wx = 0; wx < params.weight.width_; wx++) {
+                    koff[k++] = c * ih * iw + wy * iw + wx;
+                }
+            }
+        }
+        serial_size_t p = 0;
+        for (serial_size_t y = 0; y < params.out.height_; y++) {
+            for (serial_size_t x = 0; x < params.out.width_; x++) {
+                poff[p++] = y * params.h_stride * iw + x * params.w_stride;
+            }
+        }
+    }
+
+    std::vector<serial_size_t> koff;
+    std::vector<serial_size_t> poff;
+};
+
+inline vec_t& col_buffer() {
+    static thread_local vec_t buf;
+    return buf;
+}
+
+}  // namespace conv2d_gemm_detail
+
+/**
+ * im2col_index of a convolution op, built on the first call and again only
+ * when the geometry of the params changes.
+ **/
+class im2col_index_cache {
+ public:
+    const conv2d_gemm_detail::im2col_index& get(const core::conv_params& params) {
+        const serial_size_t key[n_key] = {
+            params.in.depth_, params.in_padded.width_, params.in_padded.height_,
+            params.weight.width_, params.weight.height_,
+            params.out.width_, params.out.height_,
+            params.w_stride, params.h_stride
+        };
+        if (!valid_ || !std::equal(key, key + n_key, key_)) {
+            index_.build(params);
+            std::copy(key, key + n_key, key_);
+            valid_ = true;
+        }
+        return index_;
+    }
+
+ private:
+    enum { n_key = 9 };
+    bool valid_ = false;
+    serial_size_t key_[n_key];
+    conv2d_gemm_detail::im2col_index index_;
+};
+
+/**
+ * forward convolution as out[o x P] = W[o x K] * col[K x P] + bias
+ *
+ * the weight vector is already laid out as a row-major out_depth x K
+ * matrix; pairs not present in the connection table are read as zero.
+ **/
+inline void
+conv2d_op_gemm(const tensor_t&          in_data,
+               const vec_t&             W,
+               const vec_t&             bias,
+               tensor_t&                out_data,
+               const core::conv_params& params,
+               const conv2d_gemm_detail::im2col_index& index,
+               const bool               parallelize,
+               const activation::epilogue& ep = activation::epilogue()) {
+    const size_t M = params.out.depth_;
+    const size_t K = index.koff.size();
+    const size_t P = index.poff.size();
+    const size_t ksize = params.weight.width_ * params.weight.height_;
+    const bool inner_parallelize = parallelize && in_data.size() == 1;
+
+    for_i(parallelize && !inner_parallelize, in_data.size(), [&](int sample) {
+        const float_t* in = &in_data[sample][0];
+        vec_t& out = out_data[sample];
+
+        if (params.has_bias) {
+            for (size_t o = 0; o < M; o++) {
+                std::fill(&out[o * P], &out[o * P] + P, bias[o]);
+            }
+        }
+
+        gemm(M, P, K,
+             [&](size_t o, size_t k) {
+                 return params.tbl.is_connected(o, k / ksize) ? W[o * K + k]
+                                                              : float_t(0);
+             },
+             [&](size_t k, size_t p) { return in[index.koff[k] + index.poff[p]]; },
+             [&](size_t o) { return &out[o * P]; },
+             inner_parallelize);
+        ep(out_data, sample);
+    });
+}
+
+/**
+ * backward convolution:
+ *   col_delta[K x P]   = W^T * curr_delta[o x P], scattered to prev_delta (col2im)
+ *   dW[o x K]         += curr_delta * col^T
+ *   db[o]             += row sums of curr_delta
+ **/
+inline void
+conv2d_op_gemm(const tensor_t&          prev_out,
+               const vec_t&             W,
+               tensor_t&                dW,
+               tensor_t&                db,
+               tensor_t&                curr_delta,
+               tensor_t&                prev_delta,
+               const core::conv_params& params,
+               const conv2d_gemm_detail::im2col_index& index,
+               const bool               parallelize) {
+    const size_t M = params.out.depth_;
+    const size_t K = index.koff.size();
+    const size_t P = index.poff.size();
+    const size_t ksize = params.weight.width_ * params.weight.height_;
+    const bool inner_parallelize = parallelize && dW.size() == 1;
+
+    auto weight = [&](size_t o, size_t k) {
+        return params.tbl.is_connected(o, k / ksize) ? W[o * K + k]
+                                                     : float_t(0);
+    };
+
+    for_i_slotted(parallelize && !inner_parallelize, prev_out.size(), dW.size(),
+                  [&](int slot, int sample) {
+        const float_t* in = &prev_out[sample][0];
+        const float_t* delta = &curr_delta[sample][0];
+
+        // propagate delta to previous layer
+        vec_t& col = conv2d_gemm_detail::col_buffer();
+        col.assign(K * P, float_t(0));
+
+        gemm(K, P, M,
+             [&](size_t k, size_t o) { return weight(o, k); },
+             [&](size_t o, size_t p) { return delta[o * P + p]; },
+             [&](size_t k) { return &col[k * P]; },
+             inner_parallelize);
+
+        float_t* pdelta = &prev_delta[sample][0];
+        for (size_t k = 0; k < K; k++) {
+            float_t* dst = pdelta + index.koff[k];
+            const float_t* src = &col[k * P];
+            for (size_t p = 0; p < P; p++) {
+                dst[index.poff[p]] += src[p];
+            }
+        }
+
+        // accumulate dw. with a connection table the product is computed
+        // into a scratch matrix and only connected kernels are added, so
+        // that unconnected entries of dW are never touched.
+        const bool masked = !params.tbl.is_empty();
+        vec_t& dw = dW[slot];
+        if (masked) col.assign(M * K, float_t(0));
+        float_t* pdw = masked ? &col[0] : &dw[0];
+
+        gemm(M, K, P,
+             [&](size_t o, size_t p) { return delta[o * P + p]; },
+             [&](size_t p, size_t k) { return in[index.koff[k] + index.poff[p]]; },
+             [&](size_t o) { return pdw + o * K; },
+             inner_parallelize);
+
+        if (masked) {
+            for (serial_size_t o = 0; o < M; o++) {
+                for (serial_size_t inc = 0; inc < params.in.depth_; inc++) {
+                    if (!params.tbl.is_connected(o, inc)) continue;
+                    const size_t offset = o * K + inc * ksize;
+                    vectorize::reduce<float_t>(&col[offset], ksize, &dw[offset]);
+                }
+            }
+        }
+
+        // accumulate db
+        if (params.has_bias) {
+            for (size_t o = 0; o < M; o++) {
+                db[slot][o] += std::accumulate(delta + o * P,
+                                                 delta + (o + 1) * P,
+                                                 float_t(0));
+            }
+        }
+    });
+}
+
+}  // namespace kernels
+}  // namespace tiny_dnn
@@ -44,6 +44,8 @@
 */
 #pragma once
 
+#include "tiny_dnn/activations/activation_function.h"
+
 namespace tiny_dnn {
 namespace kernels {
 
@@ -53,7 +55,8 @@ conv2d_op_internal(const tensor_t&         in_data,
                    const vec_t&               bias,
                    tensor_t&              out_data,
                    const core::conv_params& params,
-                   const bool          parallelize) {
+                   const bool          parallelize,
+                   const activation::epilogue& ep = activation::epilogue()) {
     for_i(parallelize, in_data.size(), [&](int sample) {
         const vec_t& in = in_data[sample];
         vec_t& a = out_data[sample];
@@ -99,6 +102,7 @@ conv2d_op_internal(const tensor_t&         in_data,
                 std::for_each(pa, paa, [&](float_t& f) { f += bias[o]; });
             }
         }
+        ep(out_data, sample);
     });
 }
 
@@ -119,7 +123,7 @@ conv2d_op_internal(const tensor_t&        prev_out,
 
     typedef typename vec_t::value_type float_t;
 
-    for_i(parallelize, prev_out.size(), [&](int sample) {
+    for_i_slotted(parallelize, prev_out.size(), dW.size(), [&](int slot, int sample) {
         // propagate delta to previous layer
         for (serial_size_t inc = 0; inc < params.in.depth_; inc++) {
             for (serial_size_t outc = 0; outc < params.out.depth_; outc++) {
@@ -195,7 +199,7 @@ conv2d_op_internal(const tensor_t&        prev_out,
 
 
                         idx = params.in.depth_ * outc + inc;
-                        dW[sample][params.weight.get_index(wx, wy, idx)] += dst;
+                        dW[slot][params.weight.get_index(wx, wy, idx)] += dst;
                     }
                 }
             }
@@ -208,7 +212,7 @@ conv2d_op_internal(const tensor_t&        prev_out,
                 const float_t * delta = &curr_delta[sample][idx];
                 const float_t * deltaa = delta + params.out.width_ *
                     params.out.height_;
-                db[sample][outc] += std::accumulate(delta, deltaa, float_t(0));
+                db[slot][outc] += std::accumulate(delta, deltaa, float_t(0));
             }
         }
     });
@@ -63,7 +63,7 @@ class Conv2dLibDNNForwardOp : public core::OpKernel {
         // TODO(edgar): remove this if statement when refactor
         // the init_backend() routine at layer level.
         if (OpKernel::device_ != nullptr) {
-            auto params = OpKernel::params_->conv();
+            const auto& params = OpKernel::params_->conv();
             init_libdnn(OpKernel::device_, params);
         }
     }
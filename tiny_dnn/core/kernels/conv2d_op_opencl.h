@@ -55,7 +55,7 @@ class Conv2dOpenCLForwardOp : public core::OpKernel {
 
     void compute(const core::OpKernelContext& context) override {
 #if defined(USE_OPENCL) || defined(USE_CUDA)
-        auto params = OpKernel::params_->conv();
+        const auto& params = OpKernel::params_->conv();
 
         // incoming/outcoming data
         const tensor_t& in_data = context.input(0);
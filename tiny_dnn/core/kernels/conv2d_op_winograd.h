@@ -0,0 +1,340 @@
+/*
+    COPYRIGHT
+
+    All contributions by Taiga Nomi
+    Copyright (c) 2013, Taiga Nomi
+    All rights reserved.
+
+    All other contributions:
+    Copyright (c) 2013-2016, the respective contributors.
+    All rights reserved.
+
+    Each contributor holds copyright over their respective contributions.
+    The project versioning (Git) records all such contribution source information.
+
+    LICENSE
+
+    The BSD 3-Clause License
+
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+    * Neither the name of tiny-dnn nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+
+#include <algorithm>
+
+#include "tiny_dnn/core/params/conv_params.h"
+#include "tiny_dnn/core/kernels/gemm_kernel.h"
+
+namespace tiny_dnn {
+namespace kernels {
+
+/**
+ * Winograd minimal filtering F(2x2, 3x3) for 3x3, stride-1 convolution.
+ *
+ * each 2x2 output tile is computed from a 4x4 input tile with 16 instead of
+ * 36 multiplications per channel pair:
+ *   Y = A^T [ sum_c (G g G^T) .* (B^T d B) ] A
+ * the elementwise products summed over input channels are 16 independent
+ * (out_depth x in_depth) * (in_depth x tiles) matrix products, done with
+ * the packed GEMM kernel.
+ **/
+namespace winograd_detail {
+
+typedef gemm_detail::vec_type vec_type;
+
+// 16 transformed matrices of a 4x4 tile
+static const size_t n_xi = 16;
+
+struct workspace {
+    vec_t v;      // transformed input tiles   [16][in_depth][tiles]
+    vec_t m;      // transformed output tiles  [16][out_depth][tiles]
+    vec_t rows;   // per-channel scratch of the tile transforms
+};
+
+inline workspace& thread_workspace() {
+    static thread_local workspace ws;
+    return ws;
+}
+
+// dst[i] = a[i] + b[i]
+inline void vadd(float_t* dst, const float_t* a, const float_t* b, size_t n) {
+    const size_t U = vec_type::unroll_size;
+    size_t i = 0;
+    for (; i + U <= n; i += U) {
+        vec_type::storeu(dst + i, vec_type::add(vec_type::loadu(a + i),
+                                                vec_type::loadu(b + i)));
+    }
+    for (; i < n; i++) dst[i] = a[i] + b[i];
+}
+
+// dst[i] = a[i] - b[i]
+inline void vsub(float_t* dst, const float_t* a, const float_t* b, size_t n) {
+    const size_t U = vec_type::unroll_size;
+    size_t i = 0;
+    for (; i + U <= n; i += U) {
+        vec_type::storeu(dst + i, vec_type::sub(vec_type::loadu(a + i),
+                                                vec_type::loadu(b + i)));
+    }
+    for (; i < n; i++) dst[i] = a[i] - b[i];
+}
+
+/**
+ * input transform B^T d B of every tile of one (padded) input channel.
+ * tiles of a tile-row are processed as vectors: the columns of each input
+ * row are split into even/odd halves, so that the column transform of
+ * consecutive tiles becomes contiguous vector arithmetic.
+ * tile values are written to v[xi * xi_stride + t].
+ **/
+inline void transform_input(const float_t* in,
+                            size_t iw, size_t ih,
+                            size_t tx, size_t ty,
+                            float_t* v, size_t xi_stride,
+                            vec_t& rows) {
+    const size_t nrows = 2 * ty + 2;
+    rows.resize(4 * nrows * tx + 2 * (tx + 1));
+    float_t* h = &rows[0];                  // [4][nrows][tx]
+    float_t* e = h + 4 * nrows * tx;        // even columns of a row
+    float_t* o = e + tx + 1;                // odd columns of a row
+
+    for (size_t y = 0; y < nrows; y++) {
+        std::fill(e, e + 2 * (tx + 1), float_t(0));
+        if (y < ih) {
+            const float_t* row = in + y * iw;
+            for (size_t t = 0; t <= tx; t++) {
+                if (2 * t < iw)     e[t] = row[2 * t];
+                if (2 * t + 1 < iw) o[t] = row[2 * t + 1];
+            }
+        }
+        vsub(h + (0 * nrows + y) * tx, e, e + 1, tx);
+        vadd(h + (1 * nrows + y) * tx, o, e + 1, tx);
+        vsub(h + (2 * nrows + y) * tx, e + 1, o, tx);
+        vsub(h + (3 * nrows + y) * tx, o, o + 1, tx);
+    }
+
+    for (size_t by = 0; by < ty; by++) {
+        for (size_t j = 0; j < 4; j++) {
+            const float_t* r0 = h + (j * nrows + 2 * by) * tx;
+            const float_t* r1 = r0 + tx;
+            const float_t* r2 = r1 + tx;
+            const float_t* r3 = r2 + tx;
+            float_t* dst = v + by * tx;
+            vsub(dst + (0 * 4 + j) * xi_stride, r0, r2, tx);
+            vadd(dst + (1 * 4 + j) * xi_stride, r1, r2, tx);
+            vsub(dst + (2 * 4 + j) * xi_stride, r2, r1, tx);
+            vsub(dst + (3 * 4 + j) * xi_stride, r1, r3, tx);
+        }
+    }
+}
+
+/**
+ * output transform A^T m A of every tile of one output channel, written
+ * (with bias) to the ow x oh output plane.
+ * m[xi * xi_stride + t] holds the transformed tiles.
+ **/
+inline void transform_output(const float_t* m, size_t xi_stride,
+                             size_t tx, size_t ty,
+                             float_t* out, size_t ow, size_t oh,
+                             float_t bias,
+                             vec_t& rows) {
+    rows.resize(12 * tx);
+    float_t* s0 = &rows[0];       // [4][tx], A^T applied to rows
+    float_t* s1 = s0 + 4 * tx;    // [4][tx]
+    float_t* y = s1 + 4 * tx;     // [4][tx], y00, y01, y10, y11
+
+    for (size_t by = 0; by < ty; by++) {
+        for (size_t j = 0; j < 4; j++) {
+            const float_t* m0 = m + (0 * 4 + j) * xi_stride + by * tx;
+            const float_t* m1 = m + (1 * 4 + j) * xi_stride + by * tx;
+            const float_t* m2 = m + (2 * 4 + j) * xi_stride + by * tx;
+            const float_t* m3 = m + (3 * 4 + j) * xi_stride + by * tx;
+            vadd(s0 + j * tx, m0, m1, tx);
+            vadd(s0 + j * tx, s0 + j * tx, m2, tx);
+            vsub(s1 + j * tx, m1, m2, tx);
+            vsub(s1 + j * tx, s1 + j * tx, m3, tx);
+        }
+        for (size_t r = 0; r < 2; r++) {
+            const float_t* s = r == 0 ? s0 : s1;
+            float_t* y0 = y + (2 * r) * tx;
+            float_t* y1 = y0 + tx;
+            vadd(y0, s, s + tx, tx);
+            vadd(y0, y0, s + 2 * tx, tx);
+            vsub(y1, s + tx, s + 2 * tx, tx);
+            vsub(y1, y1, s + 3 * tx, tx);
+        }
+
+        for (size_t r = 0; r < 2; r++) {
+            const size_t oy = 2 * by + r;
+            if (oy >= oh) break;
+            float_t* dst = out + oy * ow;
+            const float_t* y0 = y + (2 * r) * tx;
+            const float_t* y1 = y0 + tx;
+            for (size_t t = 0; t < tx; t++) {
+                dst[2 * t] = y0[t] + bias;
+                if (2 * t + 1 < ow) dst[2 * t + 1] = y1[t] + bias;
+            }
+        }
+    }
+}
+
+}  // namespace winograd_detail
+
+/**
+ * cache of the Winograd-domain filters U = G g G^T of a layer,
+ * laid out as [16][out_depth][in_depth].
+ *
+ * the transform is redone only when layer::weights_version changes, so
+ * inference pays for it once.
+ **/
+class winograd_filter_cache {
+ public:
+    /**
+     * @param version  layer::weights_version of W, if W is a weight of the
+     *                 layer owning the cache. the transformed filters are
+     *                 reused as long as it stays the same. filters given
+     *                 without a version are transformed on every call
+     **/
+    const vec_t& get(const vec_t& W, const size_t* version,
+                     const core::conv_params& params) {
+        if (!version || !valid_ || *version != version_ || &W != source_) {
+            transform(W, params);
+            valid_ = version != nullptr;
+            if (valid_) version_ = *version;
+            source_ = &W;
+        }
+        return filters_;
+    }
+
+ private:
+    void transform(const vec_t& W, const core::conv_params& params) {
+        const size_t in_depth = params.in.depth_;
+        const size_t out_depth = params.out.depth_;
+        const size_t xi_stride = in_depth * out_depth;
+        const float_t half = float_t(0.5);
+
+        filters_.assign(winograd_detail::n_xi * xi_stride, float_t(0));
+
+        for (size_t o = 0; o < out_depth; o++) {
+            for (size_t c = 0; c < in_depth; c++) {
+                if (!params.tbl.is_connected(o, c)) continue;
+
+                const float_t* g = &W[(in_depth * o + c) * 9];
+
+                // G g (4x3)
+                float_t gg[4][3];
+                for (size_t j = 0; j < 3; j++) {
+                    gg[0][j] = g[j];
+                    gg[1][j] = half * (g[j] + g[3 + j] + g[6 + j]);
+                    gg[2][j] = half * (g[j] - g[3 + j] + g[6 + j]);
+                    gg[3][j] = g[6 + j];
+                }
+
+                // (G g) G^T (4x4)
+                float_t* dst = &filters_[o * in_depth + c];
+                for (size_t i = 0; i < 4; i++) {
+                    dst[(i * 4 + 0) * xi_stride] = gg[i][0];
+                    dst[(i * 4 + 1) * xi_stride] = half * (gg[i][0] + gg[i][1] + gg[i][2]);
+                    dst[(i * 4 + 2) * xi_stride] = half * (gg[i][0] - gg[i][1] + gg[i][2]);
+                    dst[(i * 4 + 3) * xi_stride] = gg[i][2];
+                }
+            }
+        }
+    }
+
+    bool valid_ = false;
+    size_t version_ = 0;
+    const vec_t* source_ = nullptr;
+    vec_t filters_;
+};
+
+inline bool conv2d_winograd_applicable(const core::conv_params& params) {
+    return params.weight.width_  == 3 &&
+           params.weight.height_ == 3 &&
+           params.w_stride == 1 &&
+           params.h_stride == 1;
+}
+
+/**
+ * @param U  transformed filters, see winograd_filter_cache
+ **/
+inline void
+conv2d_op_winograd(const tensor_t&          in_data,
+                   const vec_t&             U,
+                   const vec_t&             bias,
+                   tensor_t&                out_data,
+                   const core::conv_params& params,
+                   const bool               parallelize,
+                   const activation::epilogue& ep = activation::epilogue()) {
+    using namespace winograd_detail;
+
+    const size_t C  = params.in.depth_;
+    const size_t O  = params.out.depth_;
+    const size_t iw = params.in_padded.width_;
+    const size_t ih = params.in_padded.height_;
+    const size_t ow = params.out.width_;
+    const size_t oh = params.out.height_;
+    const size_t tx = (ow + 1) / 2;
+    const size_t ty = (oh + 1) / 2;
+    const size_t T  = tx * ty;
+    const bool inner_parallelize = parallelize && in_data.size() == 1;
+
+    for_i(parallelize && !inner_parallelize, in_data.size(), [&](int sample) {
+        workspace& ws = thread_workspace();
+        ws.v.resize(n_xi * C * T);
+        ws.m.assign(n_xi * O * T, float_t(0));
+        float_t* v = &ws.v[0];
+        float_t* m = &ws.m[0];
+        const float_t* in = &in_data[sample][0];
+        float_t* out = &out_data[sample][0];
+
+        for_i(inner_parallelize, C, [&](int c) {
+            transform_input(in + c * iw * ih, iw, ih, tx, ty,
+                            v + c * T, C * T, thread_workspace().rows);
+        });
+
+        for_i(inner_parallelize, n_xi, [&](int xi) {
+            const float_t* u = &U[xi * O * C];
+            const float_t* vx = v + xi * C * T;
+            float_t* mx = m + xi * O * T;
+            gemm(O, T, C,
+                 [&](size_t o, size_t c) { return u[o * C + c]; },
+                 [&](size_t c, size_t t) { return vx[c * T + t]; },
+                 [&](size_t o) { return mx + o * T; },
+                 false);
+        });
+
+        for_i(inner_parallelize, O, [&](int o) {
+            transform_output(m + o * T, O * T, tx, ty,
+                             out + o * ow * oh, ow, oh,
+                             params.has_bias ? bias[o] : float_t(0),
+                             thread_workspace().rows);
+        });
+        ep(out_data, sample);
+    });
+}
+
+}  // namespace kernels
+}  // namespace tiny_dnn
@@ -47,6 +47,7 @@
 #include "tiny_dnn/core/framework/op_kernel.h"
 
 #include "tiny_dnn/core/kernels/fully_connected_op_avx.h"
+#include "tiny_dnn/core/kernels/fully_connected_op_gemm.h"
 #include "tiny_dnn/core/kernels/fully_connected_op_internal.h"
 
 namespace tiny_dnn {
@@ -57,7 +58,7 @@ class FullyConnectedGradOp : public core::OpKernel {
         : core::OpKernel(context) {}
 
     void compute(const core::OpKernelContext& context) override {
-        auto params = OpKernel::params_->fully();
+        const auto& params = OpKernel::params_->fully();
 
         // incoming/outcoming data
         const tensor_t& prev_out = context.input(0);
@@ -97,6 +98,17 @@ class FullyConnectedGradOp : public core::OpKernel {
                 params,
                 context.parallelize());
         }
+        else if (engine == core::backend_t::gemm) {
+            kernels::fully_connected_op_gemm(
+                prev_out,
+                W[0],
+                dW,
+                params.has_bias_ ? *db : dummy,
+                curr_delta,
+                prev_delta,
+                params,
+                context.parallelize());
+        }
         else {
             throw nn_error("Not supported engine: " + to_string(engine));
         }
@@ -47,6 +47,7 @@
 #include "tiny_dnn/core/framework/op_kernel.h"
 
 #include "tiny_dnn/core/kernels/fully_connected_op_avx.h"
+#include "tiny_dnn/core/kernels/fully_connected_op_gemm.h"
 #include "tiny_dnn/core/kernels/fully_connected_op_internal.h"
 #include "tiny_dnn/core/kernels/fully_connected_op_nnpack.h"
 
@@ -57,13 +58,16 @@ class FullyConnectedOp : public core::OpKernel {
     explicit FullyConnectedOp(const core::OpKernelConstruction& context)
         : core::OpKernel(context) {}
 
+    bool fusesEpilogue() const override { return true; }
+
     void compute(const core::OpKernelContext& context) override {
-        auto params = OpKernel::params_->fully();
+        const auto& params = OpKernel::params_->fully();
 
         // incomimg/outcoming data 
         const tensor_t& in_data = context.input(0);
         const tensor_t&       W = context.input(1);
-        const tensor_t*    bias = params.has_bias_ ? &context.input(2) : nullptr;
+        // referenced rather than copied, empty without bias
+        const vec_t&       bias = params.has_bias_ ? context.input(2)[0] : no_bias_;
         tensor_t&      out_data = context.output(1);
 
         // initialize outputs
@@ -77,33 +81,49 @@ class FullyConnectedOp : public core::OpKernel {
             kernels::fully_connected_op_internal(
                 in_data,
                 W[0],
-                params.has_bias_ ? (*bias)[0] : vec_t(),
+                bias,
                 out_data,
                 params,
-                context.parallelize());
+                context.parallelize(),
+                context.epilogue());
         }
         else if (engine == core::backend_t::nnpack) {
             kernels::fully_connected_op_nnpack(
                 in_data,
                 W[0],
-                params.has_bias_ ? (*bias)[0] : vec_t(),
+                bias,
                 out_data,
                 params,
                 context.parallelize());
+            context.epilogue().apply_all(out_data);
         }
         else if (engine == core::backend_t::avx) {
             kernels::fully_connected_op_avx(
                 in_data,
                 W[0],
-                params.has_bias_ ? (*bias)[0] : vec_t(),
+                bias,
                 out_data,
                 params,
-                context.parallelize());
+                context.parallelize(),
+                context.epilogue());
+        }
+        else if (engine == core::backend_t::gemm) {
+            kernels::fully_connected_op_gemm(
+                in_data,
+                W[0],
+                bias,
+                out_data,
+                params,
+                context.parallelize(),
+                context.epilogue());
         }
         else {
             throw nn_error("Not supported engine: " + to_string(engine));
         }
     }
+
+ private:
+    vec_t no_bias_;
 };
 
 }  // namespace tiny_dnn
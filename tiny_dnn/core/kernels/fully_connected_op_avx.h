@@ -37,8 +37,9 @@ fully_connected_op_avx(const tensor_t& in_data,
                        const vec_t&    bias,
                        tensor_t&       out_data,
                        const fully_params& params,
-                       const bool      layer_parallelize) {
-#ifdef CNN_USE_AVX
+                       const bool      layer_parallelize,
+                       const activation::epilogue& ep = activation::epilogue()) {
+#if defined(CNN_USE_AVX) || defined(CNN_MULTIVERSION)
     // TODO(nyanp/beru): is this really AVX ??
     fully_connected_op_internal(
         in_data,
@@ -46,7 +47,8 @@ fully_connected_op_avx(const tensor_t& in_data,
         bias,
         out_data,
         params,
-        layer_parallelize);
+        layer_parallelize,
+        ep);
 #else
     CNN_UNREFERENCED_PARAMETER(in_data);
     CNN_UNREFERENCED_PARAMETER(W);
@@ -54,6 +56,7 @@ fully_connected_op_avx(const tensor_t& in_data,
     CNN_UNREFERENCED_PARAMETER(out_data);
     CNN_UNREFERENCED_PARAMETER(params);
     CNN_UNREFERENCED_PARAMETER(layer_parallelize);
+    CNN_UNREFERENCED_PARAMETER(ep);
     throw nn_error("TinyDNN has not been compiled with AVX support.");
 #endif
 }
@@ -67,7 +70,7 @@ fully_connected_op_avx(const tensor_t& prev_out,
                        tensor_t&       prev_delta,
                        const fully_params& params,
                        const bool      layer_parallelize) {
-#ifdef CNN_USE_AVX
+#if defined(CNN_USE_AVX) || defined(CNN_MULTIVERSION)
     // TODO(nyanp/beru): is this really AVX ??
     fully_connected_op_internal(
         prev_out,
@@ -0,0 +1,128 @@
+/*
+    COPYRIGHT
+
+    All contributions by Taiga Nomi
+    Copyright (c) 2013, Taiga Nomi
+    All rights reserved.
+
+    All other contributions:
+    Copyright (c) 2013-2016, the respective contributors.
+    All rights reserved.
+
+    Each contributor holds copyright over their respective contributions.
+    The project versioning (Git) records all such contribution source information.
+
+    LICENSE
+
+    The BSD 3-Clause License
+
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+    * Neither the name of tiny-dnn nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+
+#include "tiny_dnn/core/params/fully_params.h"
+#include "tiny_dnn/core/kernels/gemm_kernel.h"
+
+namespace tiny_dnn {
+namespace kernels {
+
+// out[batch x out_size] = in[batch x in_size] * W[in_size x out_size] + bias
+inline void
+fully_connected_op_gemm(const tensor_t&     in_data,
+                        const vec_t&        W,
+                        const vec_t&        bias,
+                        tensor_t&           out_data,
+                        const fully_params& params,
+                        const bool          layer_parallelize,
+                        const activation::epilogue& ep = activation::epilogue()) {
+    const size_t out_size = params.out_size_;
+
+    for (size_t sample = 0; sample < out_data.size(); sample++) {
+        vec_t& out = out_data[sample];
+        if (params.has_bias_) {
+            std::copy(bias.begin(), bias.begin() + out_size, out.begin());
+        } else {
+            std::fill(out.begin(), out.begin() + out_size, float_t(0));
+        }
+    }
+
+    gemm(in_data.size(), out_size, params.in_size_,
+         [&](size_t i, size_t k) { return in_data[i][k]; },
+         [&](size_t k, size_t n) { return W[k * out_size + n]; },
+         [&](size_t i) { return &out_data[i][0]; },
+         layer_parallelize);
+
+    // activations like softmax need the whole row, which is complete only
+    // after the last K block, so the epilogue runs per sample afterwards
+    if (ep) {
+        for_i(layer_parallelize, out_data.size(), [&](int sample) {
+            ep(out_data, sample);
+        });
+    }
+}
+
+// prev_delta[batch x in_size] += curr_delta[batch x out_size] * W^T
+// dW[in_size x out_size]      += prev_out^T * curr_delta
+// db[out_size]                += sum of curr_delta over the batch
+//
+// the weight gradients of the whole batch are accumulated into the first
+// slot of dW/db, the other slots are left untouched.
+inline void
+fully_connected_op_gemm(const tensor_t&     prev_out,
+                        const vec_t&        W,
+                        tensor_t&           dW,
+                        tensor_t&           db,
+                        tensor_t&           curr_delta,
+                        tensor_t&           prev_delta,
+                        const fully_params& params,
+                        const bool          layer_parallelize) {
+    const size_t batch = prev_out.size();
+    const size_t in_size = params.in_size_;
+    const size_t out_size = params.out_size_;
+
+    gemm(batch, in_size, out_size,
+         [&](size_t i, size_t k) { return curr_delta[i][k]; },
+         [&](size_t k, size_t n) { return W[n * out_size + k]; },
+         [&](size_t i) { return &prev_delta[i][0]; },
+         layer_parallelize);
+
+    float_t* pdW = &dW[0][0];
+    gemm(in_size, out_size, batch,
+         [&](size_t i, size_t k) { return prev_out[k][i]; },
+         [&](size_t k, size_t n) { return curr_delta[k][n]; },
+         [&](size_t i) { return pdW + i * out_size; },
+         layer_parallelize);
+
+    if (params.has_bias_) {
+        for (size_t sample = 0; sample < batch; sample++) {
+            vectorize::reduce<float_t>(&curr_delta[sample][0], out_size, &db[0][0]);
+        }
+    }
+}
+
+}  // namespace kernels
+}  // namespace tiny_dnn
@@ -27,6 +27,7 @@
 #pragma once
 
 #include "tiny_dnn/core/params/fully_params.h"
+#include "tiny_dnn/activations/activation_function.h"
 
 namespace tiny_dnn {
 namespace kernels {
@@ -37,7 +38,8 @@ fully_connected_op_internal(const tensor_t&     in_data,
                             const vec_t&        bias,
                             tensor_t&           out_data,
                             const fully_params& params,
-                            const bool          layer_parallelize) {
+                            const bool          layer_parallelize,
+                            const activation::epilogue& ep = activation::epilogue()) {
     for_i(layer_parallelize, in_data.size(), [&](int sample) {
         const vec_t& in = in_data[sample];
         vec_t& out = out_data[sample];
@@ -52,6 +54,7 @@ fully_connected_op_internal(const tensor_t&     in_data,
                 out[i] += bias[i];
             }
         }
+        ep(out_data, sample);
     });
 }
 
@@ -64,7 +67,7 @@ fully_connected_op_internal(const tensor_t& prev_out,
                             tensor_t&       prev_delta,
                             const fully_params& params,
                             const bool      layer_parallelize) {
-    for (serial_size_t sample = 0; sample < prev_out.size(); sample++) {
+    for_i_slotted(false, prev_out.size(), dW.size(), [&](int slot, int sample) {
         for (serial_size_t c = 0; c < params.in_size_; c++) {
             // propagate delta to previous layer
             // prev_delta[c] += current_delta[r] * W_[c * out_size_ + r]
@@ -79,17 +82,17 @@ fully_connected_op_internal(const tensor_t& prev_out,
             for (serial_size_t c = 0; c < params.in_size_; c++) {
                 vectorize::muladd(&curr_delta[sample][r.begin()],
                     prev_out[sample][c], r.end() - r.begin(),
-                    &dW[sample][c * params.out_size_ + r.begin()]);
+                    &dW[slot][c * params.out_size_ + r.begin()]);
             }
 
             if (params.has_bias_) {
                 // vec_t& db = *in_grad[2];
                 for (int i = r.begin(); i < r.end(); i++) {
-                    db[sample][i] += curr_delta[sample][i];
+                    db[slot][i] += curr_delta[sample][i];
                 }
             }
         });
-    }
+    });
 }
 
 }  // namespace kernels
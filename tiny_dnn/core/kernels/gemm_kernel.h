@@ -0,0 +1,259 @@
+/*
+    COPYRIGHT
+
+    All contributions by Taiga Nomi
+    Copyright (c) 2013, Taiga Nomi
+    All rights reserved.
+
+    All other contributions:
+    Copyright (c) 2013-2016, the respective contributors.
+    All rights reserved.
+
+    Each contributor holds copyright over their respective contributions.
+    The project versioning (Git) records all such contribution source information.
+
+    LICENSE
+
+    The BSD 3-Clause License
+
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+    * Neither the name of tiny-dnn nor the names of its
+      contributors may be used to endorse or promote products derived from
+      this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+
+#include <algorithm>
+
+#include "tiny_dnn/util/util.h"
+#include "tiny_dnn/util/product.h"
+
+namespace tiny_dnn {
+namespace kernels {
+
+namespace gemm_detail {
+
+#if defined(CNN_USE_AVX)
+typedef vectorize::detail::avx<float_t> vec_type;
+#elif defined(CNN_USE_SSE)
+typedef vectorize::detail::sse<float_t> vec_type;
+#else
+typedef vectorize::detail::generic_vec_type<float_t> vec_type;
+#endif
+
+// register tile computed by the micro-kernel: MR rows x NR columns of C,
+// held in MR * (NR / unroll_size) vector registers.
+// with runtime dispatch the tile is fixed to 4 x 16, which every instruction
+// set covers with whole registers (4 x 4 sse ... 4 x 1 avx-512).
+#if defined(CNN_MULTIVERSION) && !defined(CNN_USE_DOUBLE)
+#define CNN_GEMM_DISPATCH
+static const size_t MR = 4;
+static const size_t NR = 16;
+#else
+static const size_t MR = 4;
+static const size_t NR = 2 * vec_type::unroll_size;
+#endif
+
+// cache blocking: per task a MC x KC block of A (64 KiB) is packed to stay
+// in L2, and a KC x NC panel of B, of which the micro-kernel streams one
+// KC x NR micro-panel at a time through L1.
+static const size_t KC = 256;
+static const size_t MC = 64;
+static const size_t NC = 256;
+
+inline vec_t& pack_buffer_a() {
+    static thread_local vec_t buf;
+    return buf;
+}
+
+inline vec_t& pack_buffer_b() {
+    static thread_local vec_t buf;
+    return buf;
+}
+
+#ifdef CNN_GEMM_DISPATCH
+// portable fallback of vectorize::isa::*::gemm_tile_4x16
+inline void generic_tile(size_t kc, const float_t* ap, const float_t* bp,
+                         float_t* tile) {
+    std::fill(tile, tile + MR * NR, float_t(0));
+    for (size_t p = 0; p < kc; p++) {
+        for (size_t r = 0; r < MR; r++)
+            for (size_t j = 0; j < NR; j++) tile[r * NR + j] += ap[r] * bp[j];
+        ap += MR;
+        bp += NR;
+    }
+}
+#endif
+
+// C[0:MR][0:NR] += Ap[kc x MR]^T * Bp[kc x NR], only the top-left mr x nr
+// part is written back.
+template <typename AccessC>
+inline void micro_kernel(size_t kc,
+                         const float_t* ap,
+                         const float_t* bp,
+                         AccessC& c,
+                         size_t row, size_t col, size_t mr, size_t nr) {
+#ifdef CNN_GEMM_DISPATCH
+    VECTORIZE_ALIGN(64) float_t tile[MR * NR];
+    switch (active_cpu_isa()) {
+        case cpu_isa::avx512: vectorize::isa::avx512::gemm_tile_4x16(kc, ap, bp, tile); break;
+        case cpu_isa::avx2:   vectorize::isa::avx2::gemm_tile_4x16(kc, ap, bp, tile); break;
+        case cpu_isa::avx:    vectorize::isa::avx::gemm_tile_4x16(kc, ap, bp, tile); break;
+        case cpu_isa::sse2:   vectorize::isa::sse2::gemm_tile_4x16(kc, ap, bp, tile); break;
+        default:              generic_tile(kc, ap, bp, tile); break;
+    }
+    for (size_t r = 0; r < mr; r++) {
+        float_t* dst = c(row + r) + col;
+        for (size_t j = 0; j < nr; j++) dst[j] += tile[r * NR + j];
+    }
+#else
+    typedef vec_type::register_type reg;
+    const size_t U = vec_type::unroll_size;
+
+    reg acc[MR][2];
+    for (size_t r = 0; r < MR; r++) {
+        acc[r][0] = vec_type::zero();
+        acc[r][1] = vec_type::zero();
+    }
+
+    for (size_t p = 0; p < kc; p++) {
+        const reg b0 = vec_type::load(bp);
+        const reg b1 = vec_type::load(bp + U);
+        for (size_t r = 0; r < MR; r++) {
+            const reg a = vec_type::set1(ap[r]);
+            acc[r][0] = vec_type::add(acc[r][0], vec_type::mul(a, b0));
+            acc[r][1] = vec_type::add(acc[r][1], vec_type::mul(a, b1));
+        }
+        ap += MR;
+        bp += NR;
+    }
+
+    VECTORIZE_ALIGN(64) float_t tmp[NR];
+    for (size_t r = 0; r < mr; r++) {
+        vec_type::store(tmp, acc[r][0]);
+        vec_type::store(tmp + U, acc[r][1]);
+        float_t* dst = c(row + r) + col;
+        for (size_t j = 0; j < nr; j++) dst[j] += tmp[j];
+    }
+#endif
+}
+
+}  // namespace gemm_detail
+
+/**
+ * blocked, packed matrix multiplication: C[M x N] += A[M x K] * B[K x N]
+ *
+ * operands are given by accessors, so that transposed matrices and
+ * batches stored as one vec_t per sample can be used without copies:
+ *   a(i, k) -> float_t    element of A
+ *   b(k, n) -> float_t    element of B
+ *   c(i)    -> float_t*   pointer to the first element of the i-th row of C
+ *
+ * A and B are packed into SIMD friendly micro-panels (zero padded at the
+ * edges), so their memory layout does not affect the inner kernel.
+ * output tiles are distributed to worker threads if parallelize is true;
+ * when there are fewer tiles than threads, the NR-column panels of each tile
+ * are split among the threads as well.
+ **/
+template <typename AccessA, typename AccessB, typename AccessC>
+void gemm(size_t M, size_t N, size_t K,
+          AccessA a, AccessB b, AccessC c,
+          bool parallelize) {
+    using namespace gemm_detail;
+
+    if (M == 0 || N == 0 || K == 0) return;
+
+    const size_t m_blocks = (M + MC - 1) / MC;
+    const size_t n_blocks = (N + NC - 1) / NC;
+    const size_t tiles = m_blocks * n_blocks;
+
+    // e.g. a fully connected layer is often a single tile. each thread
+    // then takes a slice of its B panels, packing the A block on its own.
+    size_t splits = 1;
+    if (parallelize && tiles < num_threads()) {
+        const size_t max_panels = (std::min(NC, N) + NR - 1) / NR;
+        splits = std::min(max_panels, (num_threads() + tiles - 1) / tiles);
+    }
+
+    for (size_t pc = 0; pc < K; pc += KC) {
+        const size_t kc = std::min(KC, K - pc);
+
+        for_i(parallelize, tiles * splits, [&](int task) {
+            const size_t tile = task / splits;
+            const size_t slice = task % splits;
+            const size_t ic = (tile / n_blocks) * MC;
+            const size_t jc = (tile % n_blocks) * NC;
+            const size_t mc = std::min(MC, M - ic);
+            const size_t nc = std::min(NC, N - jc);
+            const size_t m_panels = (mc + MR - 1) / MR;
+            const size_t n_panels = (nc + NR - 1) / NR;
+            const size_t jp_begin = n_panels * slice / splits;
+            const size_t jp_end = n_panels * (slice + 1) / splits;
+            if (jp_begin == jp_end) return;
+
+            vec_t& apack = pack_buffer_a();
+            vec_t& bpack = pack_buffer_b();
+            if (apack.size() < m_panels * MR * kc) apack.resize(MC * KC);
+            if (bpack.size() < n_panels * NR * kc) bpack.resize(NC * KC);
+
+            // pack A: for each MR-row panel, kc columns of MR values
+            for (size_t ip = 0; ip < m_panels; ip++) {
+                float_t* dst = &apack[ip * MR * kc];
+                const size_t i0 = ic + ip * MR;
+                const size_t mr = std::min(MR, M - i0);
+                for (size_t p = 0; p < kc; p++) {
+                    for (size_t r = 0; r < mr; r++) dst[r] = a(i0 + r, pc + p);
+                    for (size_t r = mr; r < MR; r++) dst[r] = float_t(0);
+                    dst += MR;
+                }
+            }
+
+            // pack B: for each NR-column panel, kc rows of NR values
+            for (size_t jp = jp_begin; jp < jp_end; jp++) {
+                float_t* dst = &bpack[jp * NR * kc];
+                const size_t j0 = jc + jp * NR;
+                const size_t nr = std::min(NR, N - j0);
+                for (size_t p = 0; p < kc; p++) {
+                    for (size_t j = 0; j < nr; j++) dst[j] = b(pc + p, j0 + j);
+                    for (size_t j = nr; j < NR; j++) dst[j] = float_t(0);
+                    dst += NR;
+                }
+            }
+
+            for (size_t jp = jp_begin; jp < jp_end; jp++) {
+                const size_t j0 = jc + jp * NR;
+                const size_t nr = std::min(NR, N - j0);
+                for (size_t ip = 0; ip < m_panels; ip++) {
+                    const size_t i0 = ic + ip * MR;
+                    const size_t mr = std::min(MR, M - i0);
+                    micro_kernel(kc, &apack[ip * MR * kc], &bpack[jp * NR * kc],
+                                 c, i0, j0, mr, nr);
+                }
+            }
+        }, 1);
+    }
+}
+
+}  // namespace kernels
+}  // namespace tiny_dnn
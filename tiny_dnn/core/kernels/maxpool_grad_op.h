@@ -75,14 +75,12 @@ class MaxPoolGradOp : public core::OpKernel {
                 prev_delta,
                 curr_delta,
                 params.out2inmax,
-                params.in2out,
                 context.parallelize());
         } else if (engine == core::backend_t::avx) {
 	    kernels::maxpool_grad_op_avx(
                 prev_delta,
                 curr_delta,
                 params.out2inmax,
-                params.in2out,
                 context.parallelize());
         } else {
             throw nn_error("Not supported engine: " + to_string(engine));
@@ -77,7 +77,7 @@ class MaxPoolOp : public core::OpKernel {
                 in_data,
                 out_data,
                 params.out2inmax,
-                params.out2in,
+                params,
                 context.parallelize());
         } else if (engine == core::backend_t::nnpack) {
             // NNPACK supports stride != 2 or pool_size !=2
@@ -101,7 +101,7 @@ class MaxPoolOp : public core::OpKernel {
                 in_data,
                 out_data,
                 params.out2inmax,
-                params.out2in,
+                params,
                 context.parallelize());
         } else {
             throw nn_error("Not supported engine: " + to_string(engine));
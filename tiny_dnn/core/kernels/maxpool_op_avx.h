@@ -27,27 +27,129 @@
 #pragma once
 
 #include "tiny_dnn/core/kernels/maxpool_op_internal.h"
+#include "tiny_dnn/util/cpu_features.h"
+
+#ifdef CNN_USE_AVX
+#include "tiny_dnn/core/kernels/avx_kernel_common.h"
+#endif
 
 namespace tiny_dnn {
 namespace kernels {
 
+#if defined(CNN_USE_AVX) || defined(CNN_MULTIVERSION)
+
+CNN_TARGET_PUSH("avx")
+
+// float ver
+// the window rows are first reduced column-wise with 8-wide compares
+// (keeping the row of each column maximum), then each output scans
+// pool_size_x columns of that reduced row.
+template <typename Allocator>
+void avx_maxpool_kernel(const std::vector<std::vector<float, Allocator>>& in_data,
+                        std::vector<std::vector<float, Allocator>>&       out_data,
+                        std::vector<std::vector<serial_size_t>>& max_idx,
+                        const core::maxpool_params& params,
+                        const bool layer_parallelize) {
+    const index3d<serial_size_t>& in  = params.in;
+    const index3d<serial_size_t>& out = params.out;
+    const serial_size_t width = in.width_;
+    const serial_size_t width8 = width & ~serial_size_t(7);
+
+    for_i(layer_parallelize, in_data.size(), [&](int sample) {
+        static thread_local std::vector<float> col_max, col_row;
+        col_max.resize(width);
+        col_row.resize(width);
+
+        const float* src = &in_data[sample][0];
+        float* a = &out_data[sample][0];
+        serial_size_t* max = &max_idx[sample][0];
+
+        serial_size_t o = 0;
+        for (serial_size_t c = 0; c < out.depth_; c++) {
+            for (serial_size_t oy = 0; oy < out.height_; oy++) {
+                const serial_size_t y0 = oy * params.stride_y;
+                const serial_size_t dymax = std::min(params.pool_size_y, in.height_ - y0);
+                const float* rows = src + in.get_index(0, y0, c);
+
+                std::copy(rows, rows + width, col_max.begin());
+                std::fill(col_row.begin(), col_row.end(), 0.0f);
+
+                for (serial_size_t dy = 1; dy < dymax; dy++) {
+                    const float* row = rows + dy * width;
+                    const __m256 vdy = _mm256_set1_ps(static_cast<float>(dy));
+                    serial_size_t x = 0;
+                    for (; x < width8; x += 8) {
+                        __m256 v  = _mm256_loadu_ps(row + x);
+                        __m256 m  = _mm256_loadu_ps(&col_max[x]);
+                        __m256 gt = _mm256_cmp_ps(v, m, _CMP_GT_OQ);
+                        _mm256_storeu_ps(&col_max[x], _mm256_blendv_ps(m, v, gt));
+                        _mm256_storeu_ps(&col_row[x], _mm256_blendv_ps(
+                            _mm256_loadu_ps(&col_row[x]), vdy, gt));
+                    }
+                    for (; x < width; x++) {
+                        if (row[x] > col_max[x]) {
+                            col_max[x] = row[x];
+                            col_row[x] = static_cast<float>(dy);
+                        }
+                    }
+                }
+
+                for (serial_size_t ox = 0; ox < out.width_; ox++, o++) {
+                    const serial_size_t x0 = ox * params.stride_x;
+                    const serial_size_t dxmax = std::min(params.pool_size_x, width - x0);
+
+                    // ties go to the upper row, then the left column, as
+                    // in the row-major scan of maxpool_op_internal
+                    serial_size_t best = x0;
+                    for (serial_size_t x = x0 + 1; x < x0 + dxmax; x++) {
+                        if (col_max[x] > col_max[best] ||
+                            (col_max[x] == col_max[best] && col_row[x] < col_row[best])) {
+                            best = x;
+                        }
+                    }
+                    a[o] = col_max[best];
+                    max[o] = in.get_index(best, y0 + static_cast<serial_size_t>(col_row[best]), c);
+                }
+            }
+        }
+    });
+}
+
+// double ver
+template <typename Allocator>
+void avx_maxpool_kernel(const std::vector<std::vector<double, Allocator>>& in_data,
+                        std::vector<std::vector<double, Allocator>>&       out_data,
+                        std::vector<std::vector<serial_size_t>>& max_idx,
+                        const core::maxpool_params& params,
+                        const bool layer_parallelize) {
+    maxpool_op_internal(in_data, out_data, max_idx, params, layer_parallelize);
+}
+
+CNN_TARGET_POP
+
+#endif  // CNN_USE_AVX || CNN_MULTIVERSION
+
 inline void
 maxpool_op_avx(const tensor_t& in_data,
                tensor_t&       out_data,
                std::vector<std::vector<serial_size_t>>& max_idx,
-               const std::vector<std::vector<serial_size_t>>& out2in,
+               const core::maxpool_params& params,
                const bool layer_parallelize) {
-    maxpool_op_internal(in_data, out_data, max_idx, out2in, layer_parallelize);
+#if defined(CNN_USE_AVX) || defined(CNN_MULTIVERSION)
+    if (use_isa(cpu_isa::avx)) {
+        avx_maxpool_kernel(in_data, out_data, max_idx, params, layer_parallelize);
+        return;
+    }
+#endif
+    maxpool_op_internal(in_data, out_data, max_idx, params, layer_parallelize);
 }
 
 inline void
 maxpool_grad_op_avx(tensor_t& prev_delta,
                     const tensor_t&  curr_delta,
-                    std::vector<std::vector<serial_size_t>>& max_idx,
-                    const std::vector<serial_size_t>& in2out,
+                    const std::vector<std::vector<serial_size_t>>& max_idx,
                     const bool layer_parallelize) {
-    maxpool_grad_op_internal(prev_delta, curr_delta, max_idx, in2out,
-                             layer_parallelize);
+    maxpool_grad_op_internal(prev_delta, curr_delta, max_idx, layer_parallelize);
 }
 
 }  // namespace kernels
@@ -26,52 +26,81 @@
 */
 #pragma once
 
+#include <algorithm>
+
+#include "tiny_dnn/core/params/maxpool_params.h"
+
 namespace tiny_dnn {
 namespace kernels {
 
+/**
+ * direct strided max-pooling.
+ * output (x, y, c) covers the input window starting at
+ * (x * stride_x, y * stride_y), clipped at the right/bottom border.
+ * max_idx receives, per output, the input index of its maximum.
+ **/
 inline void
 maxpool_op_internal(const tensor_t& in_data,
                     tensor_t&       out_data,
                     std::vector<std::vector<serial_size_t>>& max_idx,
-                    const std::vector<std::vector<serial_size_t>>& out2in,
+                    const core::maxpool_params& params,
                     const bool layer_parallelize) {
+    const index3d<serial_size_t>& in  = params.in;
+    const index3d<serial_size_t>& out = params.out;
+
     for_i(layer_parallelize, in_data.size(), [&](int sample) {
-        const vec_t& in = in_data[sample];
+        const vec_t& src = in_data[sample];
         vec_t& a = out_data[sample];
         std::vector<serial_size_t>& max = max_idx[sample];
 
-        for (serial_size_t i = 0; i < out2in.size(); i++) {
-            const auto& in_index = out2in[i];
-            float_t max_value = std::numeric_limits<float_t>::lowest();
+        serial_size_t o = 0;
+        for (serial_size_t c = 0; c < out.depth_; c++) {
+            for (serial_size_t oy = 0; oy < out.height_; oy++) {
+                const serial_size_t y0 = oy * params.stride_y;
+                const serial_size_t dymax = std::min(params.pool_size_y, in.height_ - y0);
 
-            for (auto j : in_index) {
-                if (in[j] > max_value) {
-                    max_value = in[j];
-                    max[i] = j;
+                for (serial_size_t ox = 0; ox < out.width_; ox++, o++) {
+                    const serial_size_t x0 = ox * params.stride_x;
+                    const serial_size_t dxmax = std::min(params.pool_size_x, in.width_ - x0);
+
+                    serial_size_t arg = in.get_index(x0, y0, c);
+                    float_t max_value = src[arg];
+
+                    for (serial_size_t dy = 0; dy < dymax; dy++) {
+                        const serial_size_t row = in.get_index(x0, y0 + dy, c);
+                        for (serial_size_t dx = 0; dx < dxmax; dx++) {
+                            if (src[row + dx] > max_value) {
+                                max_value = src[row + dx];
+                                arg = row + dx;
+                            }
+                        }
+                    }
+                    a[o] = max_value;
+                    max[o] = arg;
                 }
             }
-            a[i] = max_value;
         }
     });
 }
 
+/**
+ * routes each output gradient to the input its maximum was taken from.
+ * prev_delta must be zero-filled; overlapping windows accumulate.
+ **/
 inline void
 maxpool_grad_op_internal(tensor_t& prev_delta,
                          const tensor_t&  curr_delta,
-                         std::vector<std::vector<serial_size_t>>& max_idx,
-                         const std::vector<serial_size_t>& in2out,
+                         const std::vector<std::vector<serial_size_t>>& max_idx,
                          const bool layer_parallelize) {
     for_i(layer_parallelize, prev_delta.size(), [&](int sample) {
         vec_t& prev       = prev_delta[sample];
         const vec_t& curr = curr_delta[sample];
         const std::vector<serial_size_t>& max = max_idx[sample];
 
-        for (serial_size_t i = 0; i < in2out.size(); i++) {
-            serial_size_t outi = in2out[i];
-            prev[i] = (max[outi] == static_cast<serial_size_t>(i)) ?
-                       curr[outi] : float_t(0);
+        for (serial_size_t o = 0; o < static_cast<serial_size_t>(curr.size()); o++) {
+            prev[max[o]] += curr[o];
         }
-    }); 
+    });
 }
 
 }  // namespace kernels
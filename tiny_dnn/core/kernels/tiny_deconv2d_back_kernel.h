@@ -40,7 +40,7 @@ inline void tiny_deconv2d_back_kernel(const deconv_params& params,
                                       tensor_t&       curr_delta,
                                       tensor_t*       prev_delta) {
     // propagate delta to previous layer
-    for_i(prev_out.size(), [&](int sample) {
+    for_i_slotted(true, prev_out.size(), dW.size(), [&](int slot, int sample) {
         for (serial_size_t inc = 0; inc < params.in.depth_; inc++) {
             for (serial_size_t outc = 0; outc < params.out.depth_; outc++) {
                 if (!params.tbl.is_connected(outc, inc)) continue;
@@ -102,7 +102,7 @@ inline void tiny_deconv2d_back_kernel(const deconv_params& params,
                         }
 
                         idx = params.in.depth_ * outc + inc;
-                        dW[sample][params.weight.get_index(wx, wy, idx)] += dst;
+                        dW[slot][params.weight.get_index(wx, wy, idx)] += dst;
                     }
                 }
             }
@@ -117,7 +117,7 @@ inline void tiny_deconv2d_back_kernel(const deconv_params& params,
                 const float_t * delta = &curr_delta[sample][idx];
                 const float_t * deltaa = delta + params.out.width_ *
                     params.out.height_;
-                db[sample][outc] += std::accumulate(delta, deltaa, float_t(0));
+                db[slot][outc] += std::accumulate(delta, deltaa, float_t(0));
             }
         }
     });
@@ -26,6 +26,9 @@
 */
 #pragma once
 
+#include "tiny_dnn/activations/activation_function.h"
+#include "tiny_dnn/core/params/params.h"
+
 namespace tiny_dnn {
 namespace core {
 namespace kernels {
@@ -159,7 +162,7 @@ inline void requantize_many_in_new_range<int32_t, uint8_t>(
   const int64_t range_scale_fp =
       static_cast<int64_t>(255.0f * (1 << fp_shift) * input_range / output_range);
   const int64_t input_offset_fp =
-      static_cast<int64_t>((min_input * recip_output_range_fp) + (range_scale_fp >> 1));
+      static_cast<int64_t>((static_cast<double>(min_input) * recip_output_range_fp) + (range_scale_fp >> 1));
   const int64_t output_offset_fp = static_cast<int64_t>(round((min_output * 255.0f) / output_range));
   const int64_t rounding_delta = 1 << (fp_shift - 1);
   // Inside this loop we just do minimal adds, multiplies, and shifts, in a way
@@ -237,6 +240,191 @@ void quantize_down_and_shrink_range( std::vector<T1>& input, float_t min_input,
                            *max_new, &(*output)[0]);
 }
 
+/**
+ * uint8 filters and bias of a quantized layer, with the float ranges they
+ * were quantized with. tiny_backend keeps one per layer and only rebuilds
+ * it when layer::weights_version changes.
+ **/
+struct quantized_weights {
+    quantized_weights()
+        : min_W(0), max_W(0), min_bias(0), max_bias(0),
+          version(0), valid(false) {}
+
+    std::vector<uint8_t> W;
+    std::vector<uint8_t> bias;
+    float_t min_W;
+    float_t max_W;
+    float_t min_bias;
+    float_t max_bias;
+
+    size_t version;  // layer::weights_version the data was built from
+    bool valid;
+};
+
+// widen [min, max] so that it contains 0 and is not empty. float zero then
+// maps exactly onto a uint8 code, which the convolution uses for padding.
+inline void quantized_range_with_zero(float_t* min, float_t* max) {
+    *min = std::min(*min, float_t(0));
+    *max = std::max(*max, float_t(0));
+    if (*max - *min < float_t(1e-3)) *max = *min + float_t(1e-3);
+}
+
+/**
+ * an activation as a table over the 256 uint8 codes of [in_min, in_max],
+ * mapping onto codes of [out_min, out_max]. the output range is the fixed
+ * one given, or that of the activated values.
+ **/
+struct quantized_activation_table {
+    quantized_activation_table()
+        : function(nullptr), fixed(false),
+          in_min(0), in_max(0), out_min(0), out_max(0) {}
+
+    bool built_for(const activation::function* f, float_t min, float_t max,
+                   const quantization_ranges& ranges) const {
+        return function == f && in_min == min && in_max == max &&
+               fixed == ranges.valid &&
+               (!fixed || (out_min == ranges.out_min && out_max == ranges.out_max));
+    }
+
+    void build(const activation::function* f, float_t min, float_t max,
+               const quantization_ranges& ranges) {
+        x.resize(256);
+        y.resize(256);
+        for (int c = 0; c < 256; c++) {
+            x[c] = quantized_to_float<uint8_t>(static_cast<uint8_t>(c), min, max);
+        }
+        f->itef(y, x, 256);
+
+        function = f;
+        fixed    = ranges.valid;
+        in_min   = min;
+        in_max   = max;
+        if (fixed) {
+            out_min = ranges.out_min;
+            out_max = ranges.out_max;
+        } else {
+            out_min = *std::min_element(y.begin(), y.end());
+            out_max = *std::max_element(y.begin(), y.end());
+            quantized_range_with_zero(&out_min, &out_max);
+        }
+        for (int c = 0; c < 256; c++) {
+            codes[c] = float_to_quantized<uint8_t>(y[c], out_min, out_max);
+        }
+    }
+
+    const activation::function* function;
+    bool fixed;
+    float_t in_min, in_max;
+    float_t out_min, out_max;
+    uint8_t codes[256];
+    vec_t x, y;  // scratch, kept to rebuild without allocating
+};
+
+/**
+ * elementwise activation fused into the int32 -> uint8 requantization of the
+ * uint8 kernels. relu only narrows the output range to [0, max]; any other
+ * elementwise function is applied through a table over the 256 output codes.
+ *
+ * the table is kept with the epilogue and reused while the ranges stay the
+ * same, so layers hold on to their epilogue between calls.
+ **/
+struct quantized_epilogue {
+    quantized_epilogue() : relu(false), function(nullptr) {}
+
+    bool relu;
+    const activation::function* function;  // nullptr for identity and relu
+    mutable quantized_activation_table table;
+};
+
+/**
+ * describe the activation h as an epilogue.
+ * returns false if h is not elementwise (e.g. softmax).
+ **/
+template <typename Activation>
+bool make_quantized_epilogue(const Activation& h, quantized_epilogue* ep) {
+    if (!h.one_hot()) return false;
+    ep->relu = std::is_same<Activation, activation::relu>::value;
+    ep->function = (ep->relu || std::is_same<Activation, activation::identity>::value)
+        ? nullptr : &h;
+    return true;
+}
+
+// quantize one sample on a fixed range containing 0
+inline void float_vec_to_quantized(const vec_t& in, float_t min_value, float_t max_value,
+                                   quantized_vec* out) {
+    out->data.resize(in.size());
+    float_tensor_to_quantized_in_place<uint8_t>(in, min_value, max_value, &out->data);
+    out->min = min_value;
+    out->max = max_value;
+}
+
+// quantize one sample on its own range
+inline void float_vec_to_quantized(const vec_t& in, quantized_vec* out) {
+    float_t min_value(0), max_value(0);
+    if (!in.empty()) {
+        const auto mm = std::minmax_element(in.begin(), in.end());
+        min_value = *mm.first;
+        max_value = *mm.second;
+    }
+    quantized_range_with_zero(&min_value, &max_value);
+    float_vec_to_quantized(in, min_value, max_value, out);
+}
+
+inline void quantized_vec_to_float(const quantized_vec& in, vec_t* out) {
+    out->resize(in.data.size());
+    quantized_tensor_to_float_in_place<uint8_t>(in.data, in.min, in.max, out);
+}
+
+/**
+ * int32 accumulators -> uint8 activations of the next layer, applying the
+ * epilogue. with static ranges the output goes straight to the calibrated
+ * range; otherwise it is shrunk to the values actually produced, as in
+ * quantize_down_and_shrink_range.
+ **/
+inline void requantize_with_epilogue(std::vector<int32_t>& input,
+                                     float_t min_input, float_t max_input,
+                                     const quantized_epilogue& ep,
+                                     const quantization_ranges& ranges,
+                                     quantized_vec* out) {
+    float_t min_new, max_new;
+    if (ranges.valid) {
+        // the activation table maps the pre-activation range onto the output
+        // range; identity and relu requantize to the output range directly
+        min_new = ep.function ? ranges.a_min : ranges.out_min;
+        max_new = ep.function ? ranges.a_max : ranges.out_max;
+    } else {
+        int32_t actual_min_quantized = highest<int32_t>();
+        int32_t actual_max_quantized = lowest<int32_t>();
+        for (size_t i = 0; i < input.size(); ++i) {
+            actual_min_quantized = std::min(actual_min_quantized, input[i]);
+            actual_max_quantized = std::max(actual_max_quantized, input[i]);
+        }
+        min_new = quantized_to_float(actual_min_quantized, min_input, max_input);
+        max_new = quantized_to_float(actual_max_quantized, min_input, max_input);
+        // relu: everything below zero saturates to code 0
+        if (ep.relu) min_new = 0;
+        quantized_range_with_zero(&min_new, &max_new);
+    }
+
+    out->data.resize(input.size());
+    if (!input.empty()) {
+        requantize_many_in_new_range<int32_t, uint8_t>(&input[0], input.size(),
+            min_input, max_input, min_new, max_new, &out->data[0]);
+    }
+    out->min = min_new;
+    out->max = max_new;
+
+    if (!ep.function) return;
+
+    quantized_activation_table& t = ep.table;
+    if (!t.built_for(ep.function, min_new, max_new, ranges)) {
+        t.build(ep.function, min_new, max_new, ranges);
+    }
+    for (auto& v : out->data) v = t.codes[v];
+    out->min = t.out_min;
+    out->max = t.out_max;
+}
+
 }  // namespace kernels
 }  // namespace core
 }  // namespace tiny_dnn
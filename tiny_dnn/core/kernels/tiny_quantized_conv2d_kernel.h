@@ -33,44 +33,28 @@ namespace tiny_dnn {
 namespace core {
 namespace kernels {
 
-inline void tiny_quantized_conv2d_kernel(const conv_params& params,
-                                         const vec_t&       in,
+// quantize filters and bias of a convolution once, see quantized_weights
+inline void tiny_quantize_conv2d_weights(const conv_params& params,
                                          const vec_t&       W,
                                          const vec_t&       bias,
-                                         vec_t&             a,
-                                         const bool layer_parallelize) {
-    // image quantization
-    float_t min_input(in[0]);
-    float_t max_input(in[0]);
-    for (serial_size_t inc = 0; inc < params.in.depth_; inc++) {
-        for (serial_size_t ins = 0; ins < params.in_padded.height_*params.in_padded.height_; ins++) {
-            serial_size_t idx = params.in_padded.get_index(0, 0, inc);
-            min_input = std::min(min_input, (&in[idx])[ins]);
-            max_input = std::max(max_input, (&in[idx])[ins]);
-        }
-    }
-    std::vector<uint8_t> in_quantized =
-        float_tensor_to_quantized<uint8_t>(in, min_input, max_input);
+                                         quantized_weights* q) {
     // filter quantization
     float_t min_filter(W[0]);
     float_t max_filter(W[0]);
-    for (serial_size_t inc = 0; inc < params.in_padded.depth_; inc++) {
-        for (serial_size_t ins = 0; ins < params.weight.height_*params.weight.height_; ins++) {
-            serial_size_t idx = params.in_padded.get_index(0, 0, inc);
-            min_filter = std::min(min_filter, (&W[idx])[ins]);
-            max_filter = std::max(max_filter, (&W[idx])[ins]);
-        }
+    for (serial_size_t c = 0; c < W.size(); c++) {
+        min_filter = std::min(min_filter, W[c]);
+        max_filter = std::max(max_filter, W[c]);
     }
     if (min_filter == max_filter) {
       max_filter = W[0] + 1e-3f;
       min_filter = W[0] - 1e-3f;
     }
-    std::vector<uint8_t> W_quantized =
-        float_tensor_to_quantized<uint8_t>(W, min_filter, max_filter);
+    q->W = float_tensor_to_quantized<uint8_t>(W, min_filter, max_filter);
+    q->min_W = min_filter;
+    q->max_W = max_filter;
     // bias quantization
     float_t min_bias(0);
     float_t max_bias(0);
-    std::vector<uint8_t> bias_quantized;
     if (params.has_bias) {
         for (serial_size_t inc = 0; inc < params.out.depth_; inc++) {
             min_bias = std::min(min_bias, bias[inc]);
@@ -80,17 +64,36 @@ inline void tiny_quantized_conv2d_kernel(const conv_params& params,
           max_bias = bias[0] + 1e-3f;
           min_bias = bias[0] - 1e-3f;
         }
-        bias_quantized =
-            float_tensor_to_quantized<uint8_t>(bias, min_bias, max_bias);
+        q->bias = float_tensor_to_quantized<uint8_t>(bias, min_bias, max_bias);
+    } else {
+        q->bias.clear();
     }
+    q->min_bias = min_bias;
+    q->max_bias = max_bias;
+}
+
+// int32 accumulation shared by the float and the uint8 kernels.
+// in_quantized is the padded input, quantized on [min_input, max_input]
+inline void tiny_quantized_conv2d_accumulate(const conv_params&       params,
+                                             const uint8_t*           in_quantized,
+                                             float_t                  min_input,
+                                             float_t                  max_input,
+                                             const quantized_weights& q,
+                                             std::vector<int32_t>&    a_quantized,
+                                             float_t*                 min_output_value,
+                                             float_t*                 max_output_value,
+                                             const bool layer_parallelize) {
+    // filters and bias, quantized ahead of time
+    const float_t min_filter = q.min_W;
+    const float_t max_filter = q.max_W;
+    const std::vector<uint8_t>& W_quantized = q.W;
+    const std::vector<uint8_t>& bias_quantized = q.bias;
     // output range
-    float_t min_output_value;
-    float_t max_output_value;
     quantization_range_for_multiplication<uint8_t, uint8_t, int32_t>(
-        min_input, max_input, min_filter, max_filter, &min_output_value,
-        &max_output_value);
+        min_input, max_input, min_filter, max_filter, min_output_value,
+        max_output_value);
 
-    std::vector<int32_t> a_quantized(a.size(), static_cast<int32_t>(0));
+    a_quantized.assign(params.out.size(), static_cast<int32_t>(0));
 
     // calculating offset
     const int32_t offset_input =
@@ -98,7 +101,7 @@ inline void tiny_quantized_conv2d_kernel(const conv_params& params,
     const int32_t offset_filter =
         int64_to_int32(float_to_quantized_unclamped<uint8_t>(0.0f, min_filter, max_filter));
     const int32_t zero_in_total_space =
-        int64_to_int32(float_to_quantized<int32_t>(0.0f, min_output_value, max_output_value));
+        int64_to_int32(float_to_quantized<int32_t>(0.0f, *min_output_value, *max_output_value));
 
     for_i(layer_parallelize, params.out.depth_, [&](int o) {
         for (serial_size_t inc = 0; inc < params.in.depth_; inc++) {
@@ -143,19 +146,107 @@ inline void tiny_quantized_conv2d_kernel(const conv_params& params,
             });
         }
     });
+}
+
+inline void tiny_quantized_conv2d_kernel(const conv_params&       params,
+                                         const vec_t&             in,
+                                         const quantized_weights& q,
+                                         vec_t&                   a,
+                                         const bool layer_parallelize) {
+    const quantization_ranges& ranges = params.q_ranges;
+    // image quantization
+    float_t min_input(in[0]);
+    float_t max_input(in[0]);
+    if (ranges.valid) {
+        min_input = ranges.in_min;
+        max_input = ranges.in_max;
+    } else {
+        for (serial_size_t inc = 0; inc < params.in.depth_; inc++) {
+            for (serial_size_t ins = 0; ins < params.in_padded.height_*params.in_padded.height_; ins++) {
+                serial_size_t idx = params.in_padded.get_index(0, 0, inc);
+                min_input = std::min(min_input, (&in[idx])[ins]);
+                max_input = std::max(max_input, (&in[idx])[ins]);
+            }
+        }
+    }
+    std::vector<uint8_t> in_quantized =
+        float_tensor_to_quantized<uint8_t>(in, min_input, max_input);
+
+    float_t min_output_value;
+    float_t max_output_value;
+    std::vector<int32_t> a_quantized;
+    tiny_quantized_conv2d_accumulate(params, &in_quantized[0], min_input, max_input, q,
+        a_quantized, &min_output_value, &max_output_value, layer_parallelize);
 
     float_t min_output_requantized;
     float_t max_output_requantized;
     std::vector<uint8_t> a_requantized(a_quantized.size(), static_cast<uint8_t>(0));
 
     // Requantize from 32bits to 8 bits for next layer
-    quantize_down_and_shrink_range<int32_t, uint8_t>(a_quantized, min_output_value, max_output_value,
-    &min_output_requantized, &max_output_requantized, &a_requantized);
+    if (ranges.valid) {
+        min_output_requantized = ranges.a_min;
+        max_output_requantized = ranges.a_max;
+        requantize_many_in_new_range<int32_t, uint8_t>(&a_quantized[0], a_quantized.size(),
+            min_output_value, max_output_value, min_output_requantized,
+            max_output_requantized, &a_requantized[0]);
+    } else {
+        quantize_down_and_shrink_range<int32_t, uint8_t>(a_quantized, min_output_value, max_output_value,
+        &min_output_requantized, &max_output_requantized, &a_requantized);
+    }
 
     // dequantize to flaot, this could be removed within concatenated quantized network
     a = quantized_tensor_to_float<uint8_t>(a_requantized, min_output_requantized, max_output_requantized);
 }
 
+/**
+ * uint8 in, uint8 out: the input is the unpadded output of the previous
+ * quantized layer, the activation is applied by the epilogue.
+ **/
+inline void tiny_quantized_conv2d_kernel(const conv_params&        params,
+                                         const quantized_vec&      in,
+                                         const quantized_weights&  q,
+                                         const quantized_epilogue& ep,
+                                         quantized_vec&            out,
+                                         const bool layer_parallelize) {
+    const uint8_t* in_quantized = &in.data[0];
+
+    std::vector<uint8_t> in_padded;
+    if (params.pad_type == padding::same) {
+        // pad with the code of float zero, which contributes nothing to the sums
+        const uint8_t zero = float_to_quantized<uint8_t>(0.0f, in.min, in.max);
+        in_padded.assign(params.in_padded.size(), zero);
+        for (serial_size_t c = 0; c < params.in.depth_; c++) {
+            for (serial_size_t y = 0; y < params.in.height_; y++) {
+                const uint8_t* src = &in.data[params.in.get_index(0, y, c)];
+                uint8_t* dst = &in_padded[params.in_padded.get_index(
+                    params.weight.width_ / 2, params.weight.height_ / 2 + y, c)];
+                std::copy(src, src + params.in.width_, dst);
+            }
+        }
+        in_quantized = &in_padded[0];
+    }
+
+    float_t min_output_value;
+    float_t max_output_value;
+    std::vector<int32_t> a_quantized;
+    tiny_quantized_conv2d_accumulate(params, in_quantized, in.min, in.max, q,
+        a_quantized, &min_output_value, &max_output_value, layer_parallelize);
+
+    requantize_with_epilogue(a_quantized, min_output_value, max_output_value, ep,
+                             params.q_ranges, &out);
+}
+
+inline void tiny_quantized_conv2d_kernel(const conv_params& params,
+                                         const vec_t&       in,
+                                         const vec_t&       W,
+                                         const vec_t&       bias,
+                                         vec_t&             a,
+                                         const bool layer_parallelize) {
+    quantized_weights q;
+    tiny_quantize_conv2d_weights(params, W, bias, &q);
+    tiny_quantized_conv2d_kernel(params, in, q, a, layer_parallelize);
+}
+
 inline void tiny_quantized_conv2d_back_kernel(const conv_params& params,
                                               const vec_t& prev_out,
                                               const vec_t& W,
@@ -33,24 +33,11 @@ namespace tiny_dnn {
 namespace core {
 namespace kernels {
 
-inline void tiny_quantized_deconv2d_kernel(const deconv_params& params,
-                                           const vec_t&         in,
+// quantize filters and bias of a deconvolution once, see quantized_weights
+inline void tiny_quantize_deconv2d_weights(const deconv_params& params,
                                            const vec_t&         W,
                                            const vec_t&         bias,
-                                           vec_t&               a,
-                                           const bool layer_parallelize) {
-    // image quantization
-    float_t min_input(in[0]);
-    float_t max_input(in[0]);
-    for (serial_size_t inc = 0; inc < params.in.depth_; inc++) {
-        for (serial_size_t ins = 0; ins < params.in.height_*params.in.height_; ins++) {
-            serial_size_t idx = params.in.get_index(0, 0, inc);
-            min_input = std::min(min_input, (&in[idx])[ins]);
-            max_input = std::max(max_input, (&in[idx])[ins]);
-        }
-    }
-    std::vector<uint8_t> in_quantized =
-        float_tensor_to_quantized<uint8_t>(in, min_input, max_input);
+                                           quantized_weights*   q) {
     // filter quantization
     float_t min_filter(W[0]);
     float_t max_filter(W[0]);
@@ -65,12 +52,12 @@ inline void tiny_quantized_deconv2d_kernel(const deconv_params& params,
       max_filter = W[0] + 1e-3f;
       min_filter = W[0] - 1e-3f;
     }
-    std::vector<uint8_t> W_quantized =
-        float_tensor_to_quantized<uint8_t>(W, min_filter, max_filter);
+    q->W = float_tensor_to_quantized<uint8_t>(W, min_filter, max_filter);
+    q->min_W = min_filter;
+    q->max_W = max_filter;
     // bias quantization
     float_t min_bias(0);
     float_t max_bias(0);
-    std::vector<uint8_t> bias_quantized;
     if (params.has_bias) {
         for (serial_size_t inc = 0; inc < params.out.depth_; inc++) {
             min_bias = std::min(min_bias, bias[inc]);
@@ -80,9 +67,36 @@ inline void tiny_quantized_deconv2d_kernel(const deconv_params& params,
           max_bias = bias[0] + 1e-3f;
           min_bias = bias[0] - 1e-3f;
         }
-        bias_quantized =
-            float_tensor_to_quantized<uint8_t>(bias, min_bias, max_bias);
+        q->bias = float_tensor_to_quantized<uint8_t>(bias, min_bias, max_bias);
+    } else {
+        q->bias.clear();
     }
+    q->min_bias = min_bias;
+    q->max_bias = max_bias;
+}
+
+inline void tiny_quantized_deconv2d_kernel(const deconv_params&     params,
+                                           const vec_t&             in,
+                                           const quantized_weights& q,
+                                           vec_t&                   a,
+                                           const bool layer_parallelize) {
+    // image quantization
+    float_t min_input(in[0]);
+    float_t max_input(in[0]);
+    for (serial_size_t inc = 0; inc < params.in.depth_; inc++) {
+        for (serial_size_t ins = 0; ins < params.in.height_*params.in.height_; ins++) {
+            serial_size_t idx = params.in.get_index(0, 0, inc);
+            min_input = std::min(min_input, (&in[idx])[ins]);
+            max_input = std::max(max_input, (&in[idx])[ins]);
+        }
+    }
+    std::vector<uint8_t> in_quantized =
+        float_tensor_to_quantized<uint8_t>(in, min_input, max_input);
+    // filters and bias, quantized ahead of time
+    const float_t min_filter = q.min_W;
+    const float_t max_filter = q.max_W;
+    const std::vector<uint8_t>& W_quantized = q.W;
+    const std::vector<uint8_t>& bias_quantized = q.bias;
 
     // output range
     float_t min_output_value;
@@ -154,6 +168,17 @@ inline void tiny_quantized_deconv2d_kernel(const deconv_params& params,
     a = quantized_tensor_to_float<uint8_t>(a_requantized, min_output_requantized, max_output_requantized);
 }
 
+inline void tiny_quantized_deconv2d_kernel(const deconv_params& params,
+                                           const vec_t&         in,
+                                           const vec_t&         W,
+                                           const vec_t&         bias,
+                                           vec_t&               a,
+                                           const bool layer_parallelize) {
+    quantized_weights q;
+    tiny_quantize_deconv2d_weights(params, W, bias, &q);
+    tiny_quantized_deconv2d_kernel(params, in, q, a, layer_parallelize);
+}
+
 inline void tiny_quantized_deconv2d_back_kernel(const deconv_params& params,
                                                 const vec_t& prev_out,
                                                 const vec_t& W,
@@ -34,21 +34,12 @@ namespace tiny_dnn {
 namespace core {
 namespace kernels {
 
-inline void tiny_quantized_fully_connected_kernel(const fully_params& params,
-                                                  const vec_t&        in,
+// quantize weights and bias of a fully-connected layer once,
+// see quantized_weights
+inline void tiny_quantize_fully_connected_weights(const fully_params& params,
                                                   const vec_t&        W,
                                                   const vec_t&        b,
-                                                  vec_t&              a,
-                                                  const bool          layer_parallelize) {
-    // input quantization
-    float_t min_input(in[0]);
-    float_t max_input(in[0]);
-    for (serial_size_t c = 0; c < params.in_size_; c++) {
-        min_input = std::min(min_input, in[c]);
-        max_input = std::max(max_input, in[c]);
-    }
-    std::vector<uint8_t> in_quantized =
-        float_tensor_to_quantized<uint8_t>(in, min_input, max_input);
+                                                  quantized_weights*  q) {
     // filter quantization
     float_t min_filter(W[0]);
     float_t max_filter(W[0]);
@@ -60,18 +51,12 @@ inline void tiny_quantized_fully_connected_kernel(const fully_params& params,
       max_filter = W[0] + 1e-3f;
       min_filter = W[0] - 1e-3f;
     }
-    std::vector<uint8_t> W_quantized =
-        float_tensor_to_quantized<uint8_t>(W, min_filter, max_filter);
-    // output range
-    float_t min_output_value;
-    float_t max_output_value;
-    quantization_range_for_multiplication<uint8_t, uint8_t, int32_t>(
-        min_input, max_input, min_filter, max_filter, &min_output_value,
-        &max_output_value);
+    q->W = float_tensor_to_quantized<uint8_t>(W, min_filter, max_filter);
+    q->min_W = min_filter;
+    q->max_W = max_filter;
     // bias quantization
     float_t min_bias(0);
     float_t max_bias(0);
-    std::vector<uint8_t> bias_quantized;
     if (params.has_bias_) {
         for (serial_size_t inc = 0; inc < b.size(); inc++) {
             min_bias = std::min(min_bias, b[inc]);
@@ -81,13 +66,43 @@ inline void tiny_quantized_fully_connected_kernel(const fully_params& params,
           max_bias = b[0] + 1e-3f;
           min_bias = b[0] - 1e-3f;
         }
-        bias_quantized =
-            float_tensor_to_quantized<uint8_t>(b, min_bias, max_bias);
+        q->bias = float_tensor_to_quantized<uint8_t>(b, min_bias, max_bias);
+    } else {
+        q->bias.clear();
     }
+    q->min_bias = min_bias;
+    q->max_bias = max_bias;
+}
+
+// int32 accumulation shared by the float and the uint8 kernels
+inline void tiny_quantized_fully_connected_accumulate(const fully_params&         params,
+                                                      const std::vector<uint8_t>& in_quantized,
+                                                      float_t                     min_input,
+                                                      float_t                     max_input,
+                                                      const quantized_weights&    q,
+                                                      std::vector<int32_t>&       a_quantized,
+                                                      float_t*                    min_output,
+                                                      float_t*                    max_output,
+                                                      const bool                  layer_parallelize) {
+    // weights and bias, quantized ahead of time
+    const float_t min_filter = q.min_W;
+    const float_t max_filter = q.max_W;
+    const float_t min_bias = q.min_bias;
+    const float_t max_bias = q.max_bias;
+    const std::vector<uint8_t>& W_quantized = q.W;
+    const std::vector<uint8_t>& bias_quantized = q.bias;
+    // output range
+    float_t min_output_value;
+    float_t max_output_value;
+    quantization_range_for_multiplication<uint8_t, uint8_t, int32_t>(
+        min_input, max_input, min_filter, max_filter, &min_output_value,
+        &max_output_value);
     min_output_value += min_bias;
     max_output_value += max_bias;
+    *min_output = min_output_value;
+    *max_output = max_output_value;
 
-    std::vector<int32_t> a_quantized(a.size(), static_cast<int32_t>(0));
+    a_quantized.assign(params.out_size_, static_cast<int32_t>(0));
 
     // calculating offset
     const int32_t offset_input =
@@ -113,11 +128,6 @@ inline void tiny_quantized_fully_connected_kernel(const fully_params& params,
                               offset_output,
                               mult_output,
                               shift_output);
-        if (params.has_bias_) {
-            for_i(layer_parallelize, params.out_size_, [&](int i) {
-            a[i] += b[i];
-        });
-    }
     } else {
         for_i(layer_parallelize, params.out_size_, [&](int i) {
             for (serial_size_t c = 0; c < params.in_size_; c++) {
@@ -129,19 +139,83 @@ inline void tiny_quantized_fully_connected_kernel(const fully_params& params,
             }
         });
     }
+}
+
+inline void tiny_quantized_fully_connected_kernel(const fully_params&      params,
+                                                  const vec_t&             in,
+                                                  const quantized_weights& q,
+                                                  vec_t&                   a,
+                                                  const bool               layer_parallelize) {
+    const quantization_ranges& ranges = params.q_ranges_;
+    // input quantization
+    float_t min_input(in[0]);
+    float_t max_input(in[0]);
+    if (ranges.valid) {
+        min_input = ranges.in_min;
+        max_input = ranges.in_max;
+    } else {
+        for (serial_size_t c = 0; c < params.in_size_; c++) {
+            min_input = std::min(min_input, in[c]);
+            max_input = std::max(max_input, in[c]);
+        }
+    }
+    std::vector<uint8_t> in_quantized =
+        float_tensor_to_quantized<uint8_t>(in, min_input, max_input);
+
+    float_t min_output_value;
+    float_t max_output_value;
+    std::vector<int32_t> a_quantized;
+    tiny_quantized_fully_connected_accumulate(params, in_quantized, min_input, max_input, q,
+        a_quantized, &min_output_value, &max_output_value, layer_parallelize);
 
     float_t min_output_requantized;
     float_t max_output_requantized;
     std::vector<uint8_t> a_requantized(a_quantized.size(), static_cast<uint8_t>(0));
 
     // Requantize from 32bits to 8 bits for next layer
-    quantize_down_and_shrink_range<int32_t, uint8_t>(a_quantized, min_output_value, max_output_value,
-    &min_output_requantized, &max_output_requantized, &a_requantized);
+    if (ranges.valid) {
+        min_output_requantized = ranges.a_min;
+        max_output_requantized = ranges.a_max;
+        requantize_many_in_new_range<int32_t, uint8_t>(&a_quantized[0], a_quantized.size(),
+            min_output_value, max_output_value, min_output_requantized,
+            max_output_requantized, &a_requantized[0]);
+    } else {
+        quantize_down_and_shrink_range<int32_t, uint8_t>(a_quantized, min_output_value, max_output_value,
+        &min_output_requantized, &max_output_requantized, &a_requantized);
+    }
 
     // dequantize to flaot, this could be removed within concatenated quantized network
     a = quantized_tensor_to_float<uint8_t>(a_requantized, min_output_requantized, max_output_requantized);
 }
 
+// uint8 in, uint8 out, the activation is applied by the epilogue
+inline void tiny_quantized_fully_connected_kernel(const fully_params&       params,
+                                                  const quantized_vec&      in,
+                                                  const quantized_weights&  q,
+                                                  const quantized_epilogue& ep,
+                                                  quantized_vec&            out,
+                                                  const bool                layer_parallelize) {
+    float_t min_output_value;
+    float_t max_output_value;
+    std::vector<int32_t> a_quantized;
+    tiny_quantized_fully_connected_accumulate(params, in.data, in.min, in.max, q,
+        a_quantized, &min_output_value, &max_output_value, layer_parallelize);
+
+    requantize_with_epilogue(a_quantized, min_output_value, max_output_value, ep,
+                             params.q_ranges_, &out);
+}
+
+inline void tiny_quantized_fully_connected_kernel(const fully_params& params,
+                                                  const vec_t&        in,
+                                                  const vec_t&        W,
+                                                  const vec_t&        b,
+                                                  vec_t&              a,
+                                                  const bool          layer_parallelize) {
+    quantized_weights q;
+    tiny_quantize_fully_connected_weights(params, W, b, &q);
+    tiny_quantized_fully_connected_kernel(params, in, q, a, layer_parallelize);
+}
+
 inline void tiny_quantized_fully_connected_back_kernel(const fully_params& params,
                                                        const vec_t& prev_out,
                                                        const vec_t& W,
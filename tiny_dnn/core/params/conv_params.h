@@ -100,6 +100,7 @@ class conv_params : public Params {
     padding pad_type;
     serial_size_t w_stride;
     serial_size_t h_stride;
+    quantization_ranges q_ranges;  // quantized layer only
 
     friend std::ostream& operator<<(std::ostream &o,
                                     const core::conv_params& param) {
@@ -114,7 +115,7 @@ class conv_params : public Params {
     }
 };
 
-inline conv_params Params::conv() const {
+inline const conv_params& Params::conv() const {
     return *(static_cast<const conv_params*>(this));
 }
 
@@ -133,15 +134,16 @@ class Conv2dPadding {
             return;
         }
 
-        tensor_t buf(in.size());
+        // the padded buffer is kept between calls. its border is zero-filled
+        // on allocation and never written, so only the inner area is copied.
+        out.resize(in.size());
 
-        for_i(true, buf.size(), [&](int sample) {
-            // alloc temporary buffer.
-            buf[sample].resize(params_.in_padded.size());
+        for_i(true, out.size(), [&](int sample) {
+            out[sample].resize(params_.in_padded.size());
 
             // make padded version in order to avoid corner-case in fprop/bprop
             for (serial_size_t c = 0; c < params_.in.depth_; c++) {
-                float_t* pimg = &buf[sample][params_.in_padded.get_index(
+                float_t* pimg = &out[sample][params_.in_padded.get_index(
                                              params_.weight.width_  / 2,
                                              params_.weight.height_ / 2, c)];
                 const float_t* pin = &in[sample][params_.in.get_index(0, 0, c)];
@@ -153,9 +155,6 @@ class Conv2dPadding {
                 }
             }
         });
-
-        // shrink buffer to output
-        out = buf;
     }
 
     /* Applies unpadding to an input tensor given the convolution parameters
@@ -168,18 +167,17 @@ class Conv2dPadding {
             return;
         }
 
-        tensor_t buf(delta.size());
+        delta_unpadded.resize(delta.size());
 
-        for_i(true, buf.size(), [&](int sample) {
-            // alloc temporary buffer.
-            buf[sample].resize(params_.in.size());
+        for_i(true, delta_unpadded.size(), [&](int sample) {
+            delta_unpadded[sample].resize(params_.in.size());
 
             for (serial_size_t c = 0; c < params_.in.depth_; c++) {
                 const float_t *pin =
                     &delta[sample][params_.in_padded.get_index(
                                    params_.weight.width_  / 2,
                                    params_.weight.height_ / 2, c)];
-                float_t *pdst = &buf[sample][params_.in.get_index(0, 0, c)];
+                float_t *pdst = &delta_unpadded[sample][params_.in.get_index(0, 0, c)];
 
                 for (serial_size_t y = 0; y < params_.in.height_; y++) {
                     std::copy(pin, pin + params_.in.width_, pdst);
@@ -188,9 +186,6 @@ class Conv2dPadding {
                 }
             }
         });
-
-        // shrink buffer to output
-        delta_unpadded = buf;
     }
 
  private:
@@ -36,10 +36,11 @@ class fully_params : public Params {
     serial_size_t in_size_;
     serial_size_t out_size_;
     bool has_bias_;
+    quantization_ranges q_ranges_;  // quantized layer only
 };
 
 // TODO(nyanp): can we do better here?
-inline fully_params Params::fully() const {
+inline const fully_params& Params::fully() const {
     return *(static_cast<const fully_params*>(this));
 }
 
@@ -39,13 +39,9 @@ class maxpool_params : public Params {
     serial_size_t          stride_x;
     serial_size_t          stride_y;
     padding             pad_type;
-    
-    /* mapping out => max_index(in) (1:1) */
+
+    /* mapping out => max_index(in) (1:1), per sample */
     std::vector<std::vector<serial_size_t>> out2inmax;
-    /* mapping out => in (1:N) */
-    std::vector<std::vector<serial_size_t> > out2in;
-    /* mapping in => out (N:1) */
-    std::vector<serial_size_t> in2out;
 };
 
 struct max_pooling_layer_worker_specific_storage {
@@ -33,13 +33,33 @@ class    conv_params;
 class   fully_params;
 class maxpool_params;
 
+/**
+ * fixed activation ranges of a quantized layer, recorded on calibration
+ * data (see quantization_calibrator). when valid, the quantized kernels use
+ * them instead of scanning every input and accumulator for its range.
+ * all ranges contain 0.
+ **/
+struct quantization_ranges {
+    quantization_ranges()
+        : valid(false), in_min(0), in_max(0), a_min(0), a_max(0),
+          out_min(0), out_max(0) {}
+
+    bool valid;
+    float_t in_min;   // layer input
+    float_t in_max;
+    float_t a_min;    // before the activation
+    float_t a_max;
+    float_t out_min;  // after the activation
+    float_t out_max;
+};
+
 /* Base class to model operation parameters */
 class Params {
  public:
     Params() {}
 
-    conv_params        conv() const;
-    fully_params      fully() const;
+    const conv_params&  conv() const;
+    const fully_params& fully() const;
     maxpool_params& maxpool();
 };
 
@@ -26,6 +26,7 @@
 */
 #pragma once
 #include "tiny_dnn/util/util.h"
+#include "tiny_dnn/io/mapped_dataset.h"
 #include <fstream>
 #include <cstdint>
 #include <algorithm>
@@ -39,6 +40,28 @@
 
 namespace tiny_dnn {
 
+/**
+ * CIFAR-10 images and labels of one batch file (binary version),
+ * memory-mapped with random access.
+ * see mapped_image_dataset and parse_cifar10 for the parameters
+ **/
+class cifar10_dataset : public mapped_image_dataset {
+ public:
+    explicit cifar10_dataset(const std::string& filename,
+                             float_t scale_min = float_t(-1),
+                             float_t scale_max = float_t(1),
+                             int x_padding = 0,
+                             int y_padding = 0)
+        : mapped_image_dataset(scale_min, scale_max, x_padding, y_padding) {
+        // records of one label byte followed by the planar RGB image
+        const size_t record = 1 + CIFAR10_IMAGE_SIZE;
+        auto file = std::make_shared<mapped_file>(filename);
+        set_images(file, 1, record, file->size() / record,
+                   CIFAR10_IMAGE_WIDTH, CIFAR10_IMAGE_HEIGHT, CIFAR10_IMAGE_DEPTH);
+        set_labels(file, 0, record);
+    }
+};
+
 /**
  * parse CIFAR-10 database format images
  *
@@ -58,47 +81,15 @@ inline void parse_cifar10(const std::string& filename,
                           int x_padding,
                           int y_padding)
 {
-    if (x_padding < 0 || y_padding < 0)
-        throw nn_error("padding size must not be negative");
-    if (scale_min >= scale_max)
-        throw nn_error("scale_max must be greater than scale_min");
-
-    std::ifstream ifs(filename.c_str(), std::ios::in | std::ios::binary);
-    if (ifs.fail() || ifs.bad())
-        throw nn_error("failed to open file:" + filename);
-
-    uint8_t label;
-    std::vector<unsigned char> buf(CIFAR10_IMAGE_SIZE);
-
-    while (ifs.read((char*) &label, 1)) {
-        vec_t img;
-
-        if (!ifs.read((char*) &buf[0], CIFAR10_IMAGE_SIZE)) break;
-
-        if (x_padding || y_padding)
-        {
-            int w = CIFAR10_IMAGE_WIDTH + 2 * x_padding;
-            int h = CIFAR10_IMAGE_HEIGHT + 2 * y_padding;
-
-            img.resize(w * h * CIFAR10_IMAGE_DEPTH, scale_min);
-
-            for (int c = 0; c < CIFAR10_IMAGE_DEPTH; c++) {
-                for (int y = 0; y < CIFAR10_IMAGE_HEIGHT; y++) {
-                    for (int x = 0; x < CIFAR10_IMAGE_WIDTH; x++) {
-                        img[c * w * h + (y + y_padding) * w + x + x_padding]
-                            = scale_min + (scale_max - scale_min) * buf[c * CIFAR10_IMAGE_AREA + y * CIFAR10_IMAGE_WIDTH + x] / 255;
-                    }
-                }
-            }
-        }
-        else
-        {
-            std::transform(buf.begin(), buf.end(), std::back_inserter(img),
-                [=](unsigned char c) { return scale_min + (scale_max - scale_min) * c / 255; });
-        }
+    cifar10_dataset data(filename, scale_min, scale_max, x_padding, y_padding);
 
-        train_images->push_back(img);
-        train_labels->push_back(label);
+    const size_t first = train_images->size();
+    train_images->resize(first + data.size());
+    for_i(data.size(), [&](int i) {
+        data.image(i, &(*train_images)[first + i]);
+    });
+    for (size_t i = 0; i < data.size(); i++) {
+        train_labels->push_back(data.label(i));
     }
 }
 
@@ -0,0 +1,262 @@
+/*
+    Copyright (c) 2016, Taiga Nomi
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+#if defined(CNN_USE_AVX)
+#include <immintrin.h>
+#endif
+
+#include "tiny_dnn/util/util.h"
+#include "tiny_dnn/util/mapped_file.h"
+#include "tiny_dnn/util/batch_pipeline.h"
+
+namespace tiny_dnn {
+namespace detail {
+
+// dst[i] = src[i] * scale + offset
+template <typename T>
+inline void u8_to_float(const uint8_t* src, size_t n, T scale, T offset, T* dst) {
+    for (size_t i = 0; i < n; i++) dst[i] = src[i] * scale + offset;
+}
+
+#ifdef CNN_USE_AVX
+inline void u8_to_float(const uint8_t* src, size_t n, float scale, float offset, float* dst) {
+    const __m256 vscale = _mm256_set1_ps(scale);
+    const __m256 voffset = _mm256_set1_ps(offset);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m128i b = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i));
+        const __m128i lo = _mm_cvtepu8_epi32(b);
+        const __m128i hi = _mm_cvtepu8_epi32(_mm_srli_si128(b, 4));
+        const __m256 f = _mm256_cvtepi32_ps(
+            _mm256_insertf128_si256(_mm256_castsi128_si256(lo), hi, 1));
+        _mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_mul_ps(f, vscale), voffset));
+    }
+    for (; i < n; i++) dst[i] = src[i] * scale + offset;
+}
+#endif
+
+}  // namespace detail
+
+/**
+ * random access to a dataset of uint8 images (and labels) stored in
+ * memory-mapped files.
+ *
+ * nothing is read up front: image(i) converts the i-th image straight from
+ * the mapped pages into the caller's buffer, rescaled to
+ * [scale_min, scale_max] and surrounded by x_padding/y_padding pixels of
+ * scale_min. the dataset is read-only and can be used from several
+ * threads at once.
+ *
+ * see mnist_dataset and cifar10_dataset for the supported file formats.
+ **/
+class mapped_image_dataset {
+ public:
+    virtual ~mapped_image_dataset() {}
+
+    size_t size() const { return count_; }
+
+    /**
+     * shape of an image after padding
+     **/
+    shape3d shape() const {
+        return shape3d(static_cast<serial_size_t>(width_ + 2 * x_padding_),
+                       static_cast<serial_size_t>(height_ + 2 * y_padding_),
+                       static_cast<serial_size_t>(depth_));
+    }
+
+    size_t sample_size() const { return shape().size(); }
+
+    bool has_labels() const { return labels_ != nullptr; }
+
+    label_t label(size_t index) const {
+        if (!labels_) throw nn_error("dataset has no labels");
+        return static_cast<label_t>(static_cast<uint8_t>(
+            labels_->data()[label_offset_ + index * label_stride_]));
+    }
+
+    /**
+     * convert the index-th image into dst[0, sample_size())
+     **/
+    void image(size_t index, float_t* dst) const {
+        const uint8_t* src = reinterpret_cast<const uint8_t*>(
+            images_->data() + image_offset_ + index * image_stride_);
+        const size_t w = width_ + 2 * x_padding_;
+        const size_t h = height_ + 2 * y_padding_;
+
+        for (size_t c = 0; c < depth_; c++) {
+            float_t* plane = dst + c * w * h;
+            std::fill(plane, plane + y_padding_ * w, scale_min_);
+            for (size_t y = 0; y < height_; y++) {
+                float_t* row = plane + (y + y_padding_) * w;
+                std::fill(row, row + x_padding_, scale_min_);
+                detail::u8_to_float(src + (c * height_ + y) * width_, width_,
+                                    scale_, scale_min_, row + x_padding_);
+                std::fill(row + x_padding_ + width_, row + w, scale_min_);
+            }
+            std::fill(plane + (height_ + y_padding_) * w, plane + w * h, scale_min_);
+        }
+    }
+
+    void image(size_t index, vec_t* dst) const {
+        dst->resize(sample_size());
+        image(index, dst->data());
+    }
+
+ protected:
+    mapped_image_dataset(float_t scale_min, float_t scale_max,
+                         int x_padding, int y_padding)
+        : count_(0), width_(0), height_(0), depth_(0),
+          image_offset_(0), image_stride_(0),
+          label_offset_(0), label_stride_(0),
+          scale_min_(scale_min), scale_((scale_max - scale_min) / float_t(255)),
+          x_padding_(static_cast<size_t>(std::max(x_padding, 0))),
+          y_padding_(static_cast<size_t>(std::max(y_padding, 0))) {
+        if (x_padding < 0 || y_padding < 0)
+            throw nn_error("padding size must not be negative");
+        if (scale_min >= scale_max)
+            throw nn_error("scale_max must be greater than scale_min");
+    }
+
+    /**
+     * count images of width x height x depth bytes (planar), the first at
+     * offset, each stride bytes apart
+     **/
+    void set_images(std::shared_ptr<mapped_file> file, size_t offset, size_t stride,
+                    size_t count, size_t width, size_t height, size_t depth) {
+        if (count > 0 && file->size() < offset + (count - 1) * stride + width * height * depth)
+            throw nn_error("dataset file is truncated");
+        images_ = file;
+        image_offset_ = offset;
+        image_stride_ = stride;
+        count_ = count;
+        width_ = width;
+        height_ = height;
+        depth_ = depth;
+    }
+
+    void set_labels(std::shared_ptr<mapped_file> file, size_t offset, size_t stride) {
+        if (count_ > 0 && file->size() < offset + (count_ - 1) * stride + 1)
+            throw nn_error("dataset file is truncated");
+        labels_ = file;
+        label_offset_ = offset;
+        label_stride_ = stride;
+    }
+
+ private:
+    std::shared_ptr<mapped_file> images_;
+    std::shared_ptr<mapped_file> labels_;
+    size_t count_;
+    size_t width_, height_, depth_;
+    size_t image_offset_, image_stride_;
+    size_t label_offset_, label_stride_;
+    float_t scale_min_;
+    float_t scale_;
+    size_t x_padding_, y_padding_;
+};
+
+/**
+ * batch_source streaming minibatches out of a mapped_image_dataset, with
+ * targets encoded one-hot (target_min everywhere, target_max at the label).
+ * images are converted into the batch buffers when a batch is assembled,
+ * so training starts without a float copy of the dataset in memory.
+ *
+ * @code
+ * mnist_dataset train("train-images.idx3-ubyte", "train-labels.idx1-ubyte");
+ * image_batch_source src(train, 32, 10, -1.0, 1.0, true);
+ * net.fit<mse>(opt, src, 10, on_batch, on_epoch);
+ * @endcode
+ **/
+class image_batch_source : public batch_source {
+ public:
+    image_batch_source(const mapped_image_dataset& data,
+                       size_t batch_size,
+                       size_t num_classes,
+                       float_t target_min,
+                       float_t target_max,
+                       bool shuffle = false,
+                       unsigned int seed = 0)
+        : data_(data), batch_size_(batch_size), num_classes_(num_classes),
+          target_min_(target_min), target_max_(target_max),
+          shuffle_(shuffle), seed_(seed), order_(data.size()) {
+        if (!data.has_labels() || data.size() == 0 || batch_size == 0) {
+            throw nn_error("dataset must be labeled and non-empty, batch size non-zero");
+        }
+        std::iota(order_.begin(), order_.end(), size_t(0));
+    }
+
+    size_t batch_count() const override {
+        return (data_.size() + batch_size_ - 1) / batch_size_;
+    }
+
+    void begin_epoch(int epoch) override {
+        if (!shuffle_) return;
+        std::iota(order_.begin(), order_.end(), size_t(0));
+        std::mt19937 gen(seed_ + static_cast<unsigned int>(epoch));
+        std::shuffle(order_.begin(), order_.end(), gen);
+    }
+
+    void make_batch(size_t index, minibatch* batch) override {
+        const size_t begin = index * batch_size_;
+        const size_t n = std::min(begin + batch_size_, data_.size()) - begin;
+
+        batch->in.resize(n);
+        batch->target.resize(n);
+        batch->t_cost.clear();
+
+        for (size_t i = 0; i < n; i++) {
+            const size_t sample = order_[begin + i];
+            batch->in[i].resize(1);
+            data_.image(sample, &batch->in[i][0]);
+
+            const label_t label = data_.label(sample);
+            if (label >= num_classes_) throw nn_error("label out of range");
+            batch->target[i].resize(1);
+            batch->target[i][0].assign(num_classes_, target_min_);
+            batch->target[i][0][label] = target_max_;
+        }
+    }
+
+ private:
+    const mapped_image_dataset& data_;
+    size_t batch_size_;
+    size_t num_classes_;
+    float_t target_min_;
+    float_t target_max_;
+    bool shuffle_;
+    unsigned int seed_;
+    std::vector<size_t> order_;
+};
+
+} // namespace tiny_dnn
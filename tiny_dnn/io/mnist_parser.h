@@ -26,8 +26,10 @@
 */
 #pragma once
 #include "tiny_dnn/util/util.h"
+#include "tiny_dnn/io/mapped_dataset.h"
 #include <fstream>
 #include <cstdint>
+#include <cstring>
 
 namespace tiny_dnn {
 namespace detail {
@@ -39,49 +41,63 @@ struct mnist_header {
     uint32_t num_cols;
 };
 
-inline void parse_mnist_header(std::ifstream& ifs, mnist_header& header) {
-    ifs.read((char*) &header.magic_number, 4);
-    ifs.read((char*) &header.num_items, 4);
-    ifs.read((char*) &header.num_rows, 4);
-    ifs.read((char*) &header.num_cols, 4);
-
-    if (is_little_endian()) {
-        reverse_endian(&header.magic_number);
-        reverse_endian(&header.num_items);
-        reverse_endian(&header.num_rows);
-        reverse_endian(&header.num_cols);
-    }
-
-    if (header.magic_number != 0x00000803 || header.num_items <= 0)
-        throw nn_error("MNIST label-file format error");
-    if (ifs.fail() || ifs.bad())
-        throw nn_error("file error");
+// read a big-endian uint32 of a mapped idx file
+inline uint32_t mnist_read_u32(const mapped_file& file, size_t offset) {
+    if (file.size() < offset + 4)
+        throw nn_error("MNIST file format error");
+    uint32_t v;
+    std::memcpy(&v, file.data() + offset, 4);
+    if (is_little_endian()) reverse_endian(&v);
+    return v;
 }
 
-inline void parse_mnist_image(std::ifstream& ifs,
-    const mnist_header& header,
-    float_t scale_min,
-    float_t scale_max,
-    int x_padding,
-    int y_padding,
-    vec_t& dst) {
-    const int width = header.num_cols + 2 * x_padding;
-    const int height = header.num_rows + 2 * y_padding;
-
-    std::vector<uint8_t> image_vec(header.num_rows * header.num_cols);
-
-    ifs.read((char*) &image_vec[0], header.num_rows * header.num_cols);
+inline mnist_header parse_mnist_header(const mapped_file& file) {
+    mnist_header header;
+    header.magic_number = mnist_read_u32(file, 0);
+    header.num_items    = mnist_read_u32(file, 4);
+    header.num_rows     = mnist_read_u32(file, 8);
+    header.num_cols     = mnist_read_u32(file, 12);
 
-    dst.resize(width * height, scale_min);
-
-    for (uint32_t y = 0; y < header.num_rows; y++)
-        for (uint32_t x = 0; x < header.num_cols; x++)
-            dst[width * (y + y_padding) + x + x_padding]
-            = (image_vec[y * header.num_cols + x] / float_t(255)) * (scale_max - scale_min) + scale_min;
+    if (header.magic_number != 0x00000803 || header.num_items <= 0)
+        throw nn_error("MNIST image-file format error");
+    return header;
 }
 
 } // namespace detail
 
+/**
+ * MNIST images and labels, memory-mapped with random access
+ * http://yann.lecun.com/exdb/mnist/
+ *
+ * @param image_file [in] filename of images (i.e.train-images-idx3-ubyte)
+ * @param label_file [in] filename of labels (i.e.train-labels-idx1-ubyte),
+ *                        empty for an unlabeled dataset
+ * see mapped_image_dataset and parse_mnist_images for the other parameters
+ **/
+class mnist_dataset : public mapped_image_dataset {
+ public:
+    mnist_dataset(const std::string& image_file,
+                  const std::string& label_file,
+                  float_t scale_min = float_t(-1),
+                  float_t scale_max = float_t(1),
+                  int x_padding = 0,
+                  int y_padding = 0)
+        : mapped_image_dataset(scale_min, scale_max, x_padding, y_padding) {
+        auto images = std::make_shared<mapped_file>(image_file);
+        const detail::mnist_header header = detail::parse_mnist_header(*images);
+        set_images(images, 16, header.num_rows * header.num_cols,
+                   header.num_items, header.num_cols, header.num_rows, 1);
+
+        if (!label_file.empty()) {
+            auto labels = std::make_shared<mapped_file>(label_file);
+            if (detail::mnist_read_u32(*labels, 0) != 0x00000801 ||
+                detail::mnist_read_u32(*labels, 4) != header.num_items)
+                throw nn_error("MNIST label-file format error");
+            set_labels(labels, 8, 1);
+        }
+    }
+};
+
 /**
  * parse MNIST database format labels with rescaling/resizing
  * http://yann.lecun.com/exdb/mnist/
@@ -90,29 +106,16 @@ inline void parse_mnist_image(std::ifstream& ifs,
  * @param labels     [out] parsed label data
  **/
 inline void parse_mnist_labels(const std::string& label_file, std::vector<label_t> *labels) {
-    std::ifstream ifs(label_file.c_str(), std::ios::in | std::ios::binary);
-
-    if (ifs.bad() || ifs.fail())
-        throw nn_error("failed to open file:" + label_file);
-
-    uint32_t magic_number, num_items;
-
-    ifs.read((char*) &magic_number, 4);
-    ifs.read((char*) &num_items, 4);
+    mapped_file file(label_file);
 
-    if (is_little_endian()) { // MNIST data is big-endian format
-        reverse_endian(&magic_number);
-        reverse_endian(&num_items);
-    }
+    const uint32_t magic_number = detail::mnist_read_u32(file, 0);
+    const uint32_t num_items = detail::mnist_read_u32(file, 4);
 
-    if (magic_number != 0x00000801 || num_items <= 0)
+    if (magic_number != 0x00000801 || num_items <= 0 || file.size() < 8 + size_t(num_items))
         throw nn_error("MNIST label-file format error");
 
-    for (uint32_t i = 0; i < num_items; i++) {
-        uint8_t label;
-        ifs.read((char*) &label, 1);
-        labels->push_back((label_t) label);
-    }
+    const uint8_t* src = reinterpret_cast<const uint8_t*>(file.data() + 8);
+    labels->insert(labels->end(), src, src + num_items);
 }
 
 /**
@@ -144,25 +147,14 @@ inline void parse_mnist_images(const std::string& image_file,
     int x_padding,
     int y_padding) {
 
-    if (x_padding < 0 || y_padding < 0)
-        throw nn_error("padding size must not be negative");
-    if (scale_min >= scale_max)
-        throw nn_error("scale_max must be greater than scale_min");
-
-    std::ifstream ifs(image_file.c_str(), std::ios::in | std::ios::binary);
-
-    if (ifs.bad() || ifs.fail())
-        throw nn_error("failed to open file:" + image_file);
+    mnist_dataset data(image_file, std::string(), scale_min, scale_max,
+                       x_padding, y_padding);
 
-    detail::mnist_header header;
-
-    detail::parse_mnist_header(ifs, header);
-
-    for (uint32_t i = 0; i < header.num_items; i++) {
-        vec_t image;
-        detail::parse_mnist_image(ifs, header, scale_min, scale_max, x_padding, y_padding, image);
-        images->push_back(image);
-    }
+    const size_t first = images->size();
+    images->resize(first + data.size());
+    for_i(data.size(), [&](int i) {
+        data.image(i, &(*images)[first + i]);
+    });
 }
 
 } // namespace tiny_dnn
@@ -0,0 +1,157 @@
+/*
+    Copyright (c) 2016, Taiga Nomi
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tiny_dnn/util/util.h"
+#include "tiny_dnn/util/mapped_file.h"
+#include "tiny_dnn/util/parameter_arena.h"
+
+namespace tiny_dnn {
+namespace detail {
+
+/**
+ * header of a mappable weight file.
+ *
+ * the header is followed by a table of param_count uint64 vector sizes and,
+ * at data_offset (a multiple of 64), by the weights themselves, laid out
+ * as parameter_arena does: one vector after another, each padded to 64
+ * bytes, and a vector listed more than once stored only at its first
+ * position. the data can therefore be used in place once the file is mapped.
+ **/
+struct weight_file_header {
+    char     magic[8];       // "TDNNWGT\0"
+    uint32_t version;
+    uint32_t scalar_size;    // sizeof(float_t) of the writer
+    uint32_t byte_order;     // weight_file_byte_order as written by the writer
+    uint32_t reserved;
+    uint64_t param_count;
+    uint64_t data_offset;    // in bytes, from the start of the file
+    uint64_t data_size;      // in elements, padding included
+};
+
+static const char     weight_file_magic[8]       = { 'T', 'D', 'N', 'N', 'W', 'G', 'T', '\0' };
+static const uint32_t weight_file_version        = 1;
+static const uint32_t weight_file_byte_order     = 0x01020304;
+
+inline uint64_t weight_file_data_offset(uint64_t param_count) {
+    const uint64_t table_end = sizeof(weight_file_header) + param_count * sizeof(uint64_t);
+    return (table_end + 63) / 64 * 64;
+}
+
+}  // namespace detail
+
+/**
+ * write params to a mappable weight file (see map_weight_file)
+ **/
+inline void save_weight_file(const std::string& path,
+                             const std::vector<const vec_t*>& params) {
+    std::ofstream ofs(path.c_str(), std::ios::binary | std::ios::out);
+    if (ofs.fail() || ofs.bad())
+        throw nn_error("failed to open:" + path);
+
+    detail::weight_file_header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, detail::weight_file_magic, sizeof(header.magic));
+    header.version     = detail::weight_file_version;
+    header.scalar_size = sizeof(float_t);
+    header.byte_order  = detail::weight_file_byte_order;
+    header.param_count = params.size();
+    header.data_offset = detail::weight_file_data_offset(params.size());
+    header.data_size   = parameter_arena::required_size(params);
+
+    ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (auto p : params) {
+        const uint64_t size = p->size();
+        ofs.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    }
+
+    const std::vector<char> zeros(64, 0);
+    const uint64_t table_end = sizeof(header) + params.size() * sizeof(uint64_t);
+    ofs.write(&zeros[0], static_cast<std::streamsize>(header.data_offset - table_end));
+    for (size_t i = 0; i < params.size(); i++) {
+        const vec_t* p = params[i];
+        // shared vectors are stored once, as parameter_arena lays them out
+        if (std::find(params.begin(), params.begin() + i, p) != params.begin() + i) continue;
+        const size_t bytes = p->size() * sizeof(float_t);
+        ofs.write(reinterpret_cast<const char*>(p->data()), static_cast<std::streamsize>(bytes));
+        ofs.write(&zeros[0], static_cast<std::streamsize>(
+            parameter_arena::padded(p->size()) * sizeof(float_t) - bytes));
+    }
+    if (ofs.fail() || ofs.bad())
+        throw nn_error("failed to write:" + path);
+}
+
+/**
+ * map a weight file written by save_weight_file and let params view the
+ * mapped weights through arena, without reading or copying them.
+ *
+ * the pages are copy-on-write: processes mapping the same file share one
+ * physical copy of the weights as long as they do not modify them.
+ **/
+inline void map_weight_file(const std::string& path,
+                            const std::vector<vec_t*>& params,
+                            parameter_arena* arena) {
+    auto file = std::make_shared<mapped_file>(path);
+
+    detail::weight_file_header header;
+    if (file->size() < sizeof(header))
+        throw nn_error("weight file is truncated:" + path);
+    std::memcpy(&header, file->data(), sizeof(header));
+
+    if (std::memcmp(header.magic, detail::weight_file_magic, sizeof(header.magic)) != 0)
+        throw nn_error("not a weight file:" + path);
+    if (header.version != detail::weight_file_version)
+        throw nn_error("unsupported weight file version:" + path);
+    if (header.scalar_size != sizeof(float_t))
+        throw nn_error("weight file was written with a different float_t:" + path);
+    if (header.byte_order != detail::weight_file_byte_order)
+        throw nn_error("weight file was written with a different byte order:" + path);
+    if (header.param_count != params.size())
+        throw nn_error("weight file does not match the network:" + path);
+    if (header.data_offset != detail::weight_file_data_offset(header.param_count) ||
+        file->size() < header.data_offset + header.data_size * sizeof(float_t))
+        throw nn_error("weight file is truncated:" + path);
+
+    for (size_t i = 0; i < params.size(); i++) {
+        uint64_t size;
+        std::memcpy(&size, file->data() + sizeof(header) + i * sizeof(size), sizeof(size));
+        if (size != params[i]->size())
+            throw nn_error("weight file does not match the network:" + path);
+    }
+
+    float_t* data = reinterpret_cast<float_t*>(file->data() + header.data_offset);
+    arena->adopt(params, data, static_cast<size_t>(header.data_size), file);
+}
+
+} // namespace tiny_dnn
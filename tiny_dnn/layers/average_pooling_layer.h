@@ -32,98 +32,164 @@
 
 #include "tiny_dnn/util/util.h"
 #include "tiny_dnn/util/image.h"
-#include "tiny_dnn/layers/partial_connected_layer.h"
+#include "tiny_dnn/layers/feedforward_layer.h"
 #include "tiny_dnn/activations/activation_function.h"
 
 namespace tiny_dnn {
 
+/**
+ * geometry of the average pooling windows. window (x, y) of each channel
+ * starts at (x * stride_x, y * stride_y); outputs whose window does not fit
+ * into the input are not connected to any input and only carry the bias.
+ **/
+struct average_pooling_geometry {
+    shape3d in;
+    shape3d out;
+    serial_size_t pool_size_x;
+    serial_size_t pool_size_y;
+    serial_size_t stride_x;
+    serial_size_t stride_y;
+
+    // number of connected windows along one axis
+    static serial_size_t windows(serial_size_t in_size, serial_size_t out_size,
+                                 serial_size_t pool_size, serial_size_t stride) {
+        if (in_size < pool_size) return 0;
+        return std::min(out_size, (in_size - pool_size) / stride + 1);
+    }
+
+    serial_size_t windows_x() const {
+        return windows(in.width_, out.width_, pool_size_x, stride_x);
+    }
+
+    serial_size_t windows_y() const {
+        return windows(in.height_, out.height_, pool_size_y, stride_y);
+    }
+};
+
+// column sums of the pool_size_y rows of the window row oy of channel c
+inline void average_pooling_column_sums(const average_pooling_geometry& g,
+                                        const float_t* src,
+                                        serial_size_t c,
+                                        serial_size_t oy,
+                                        vec_t& col_sum) {
+    const serial_size_t width = g.in.width_;
+    const float_t* rows = src + g.in.get_index(0, oy * g.stride_y, c);
+
+    col_sum.assign(rows, rows + width);
+    for (serial_size_t dy = 1; dy < g.pool_size_y; dy++) {
+        vectorize::reduce<float_t>(rows + dy * width, width, &col_sum[0]);
+    }
+}
+
+inline vec_t& average_pooling_row_buffer() {
+    static thread_local vec_t buf;
+    return buf;
+}
+
 // forward_propagation
 template <typename Activation>
 void tiny_average_pooling_kernel(bool parallelize,
                                  const std::vector<tensor_t*>& in_data,
                                  std::vector<tensor_t*>&       out_data,
-                                 const shape3d&                out_dim,
+                                 const average_pooling_geometry& g,
                                  float_t                       scale_factor,
-                                 std::vector<typename partial_connected_layer<Activation>::wi_connections>& out2wi,
                                  Activation&                   h) {
- 
-    for_i(in_data[0]->size(), [&](size_t sample) {
+    const serial_size_t wx = g.windows_x();
+    const serial_size_t wy = g.windows_y();
+
+    for_i(parallelize, in_data[0]->size(), [&](size_t sample) {
         const vec_t& in = (*in_data[0])[sample];
         const vec_t& W = (*in_data[1])[0];
         const vec_t& b = (*in_data[2])[0];
         vec_t&       out = (*out_data[0])[sample];
         vec_t&       a = (*out_data[1])[sample];
+        vec_t&       col_sum = average_pooling_row_buffer();
 
-        auto oarea = out_dim.area();
         size_t idx = 0;
-        for (serial_size_t d = 0; d < out_dim.depth_; ++d) {
-            float_t weight = W[d] * scale_factor;
-            float_t bias = b[d];
-            for (serial_size_t i = 0; i < oarea; ++i, ++idx) {
-                const auto& connections = out2wi[idx];
-                float_t value = float_t(0);
-                for (auto connection : connections)// 13.1%
-                    value += in[connection.second]; // 3.2%
-                value *= weight;
-                value += bias;
-                a[idx] = value;
+        for (serial_size_t c = 0; c < g.out.depth_; ++c) {
+            float_t weight = W[c] * scale_factor;
+            float_t bias = b[c];
+            for (serial_size_t oy = 0; oy < g.out.height_; ++oy) {
+                if (oy < wy) average_pooling_column_sums(g, &in[0], c, oy, col_sum);
+
+                for (serial_size_t ox = 0; ox < g.out.width_; ++ox, ++idx) {
+                    float_t value = float_t(0);
+                    if (oy < wy && ox < wx) {
+                        const float_t* p = &col_sum[ox * g.stride_x];
+                        for (serial_size_t dx = 0; dx < g.pool_size_x; ++dx)
+                            value += p[dx];
+                    }
+                    a[idx] = value * weight + bias;
+                }
             }
         }
 
-        assert(out.size() == out2wi.size());
-        for (serial_size_t i = 0; i < static_cast<serial_size_t>(out2wi.size()); i++) {
-            out[i] = h.f(a, i);
-        }
+        h.itef(out, a, out.size());
     });
 }
 
 // back_propagation
-template<typename Activation>
-void tiny_average_pooling_back_kernel(const std::vector<tensor_t*>&   in_data,
-                                      const std::vector<tensor_t*>&   out_data,
-                                      std::vector<tensor_t*>&         out_grad,
-                                      std::vector<tensor_t*>&         in_grad,
-                                      const shape3d&                  in_dim,
-                                      float_t                         scale_factor,
-                                      std::vector<typename partial_connected_layer<Activation>::io_connections>& weight2io,
-                                      std::vector<typename partial_connected_layer<Activation>::wo_connections>& in2wo,
-                                      std::vector<std::vector<serial_size_t>>& bias2out) {
-
-    for_i(in_data[0]->size(), [&](size_t sample) {
+inline void tiny_average_pooling_back_kernel(const std::vector<tensor_t*>&   in_data,
+                                             std::vector<tensor_t*>&         out_grad,
+                                             std::vector<tensor_t*>&         in_grad,
+                                             const average_pooling_geometry& g,
+                                             float_t                         scale_factor) {
+    const serial_size_t wx = g.windows_x();
+    const serial_size_t wy = g.windows_y();
+    const serial_size_t width = g.in.width_;
+
+    for_i_slotted(true, in_data[0]->size(), in_grad[1]->size(), [&](int slot, int sample) {
         const vec_t& prev_out   = (*in_data[0])[sample];
         const vec_t& W          = (*in_data[1])[0];
-        vec_t&       dW         = (*in_grad[1])[sample];
-        vec_t&       db         = (*in_grad[2])[sample];
+        vec_t&       dW         = (*in_grad[1])[slot];
+        vec_t&       db         = (*in_grad[2])[slot];
         vec_t&       prev_delta = (*in_grad[0])[sample];
         vec_t&       curr_delta = (*out_grad[0])[sample];
+        vec_t&       col_sum    = average_pooling_row_buffer();
 
-        auto inarea = in_dim.area();
-        size_t idx = 0;
-        for (size_t i = 0; i < in_dim.depth_; ++i) {
-            float_t weight = W[i] * scale_factor;
-            for (size_t j = 0; j < inarea; ++j, ++idx) {
-                prev_delta[idx] = weight * curr_delta[in2wo[idx][0].second];
-            }
-        }
-
-        for (size_t i = 0; i < weight2io.size(); ++i) {
-            const auto& connections = weight2io[i];
-            float_t diff = float_t(0);
-
-            for (auto connection : connections)
-                diff += prev_out[connection.first] * curr_delta[connection.second];
-
-            dW[i] += diff * scale_factor;
-        }
+        std::fill(prev_delta.begin(), prev_delta.end(), float_t(0));
 
-        for (size_t i = 0; i < bias2out.size(); i++) {
-            const std::vector<serial_size_t>& outs = bias2out[i];
+        size_t idx = 0;
+        for (serial_size_t c = 0; c < g.out.depth_; ++c) {
+            float_t weight = W[c] * scale_factor;
             float_t diff = float_t(0);
+            float_t bias_diff = float_t(0);
+
+            for (serial_size_t oy = 0; oy < g.out.height_; ++oy) {
+                const float_t* delta = &curr_delta[idx];
+                for (serial_size_t ox = 0; ox < g.out.width_; ++ox)
+                    bias_diff += delta[ox];
+
+                if (oy < wy) {
+                    // dW: window sums of the input times the output delta
+                    average_pooling_column_sums(g, &prev_out[0], c, oy, col_sum);
+                    for (serial_size_t ox = 0; ox < wx; ++ox) {
+                        const float_t* p = &col_sum[ox * g.stride_x];
+                        float_t sum = float_t(0);
+                        for (serial_size_t dx = 0; dx < g.pool_size_x; ++dx)
+                            sum += p[dx];
+                        diff += sum * delta[ox];
+                    }
+
+                    // prev_delta: spread the deltas over the window columns,
+                    // then add that row to each of the window rows
+                    std::fill(col_sum.begin(), col_sum.end(), float_t(0));
+                    for (serial_size_t ox = 0; ox < wx; ++ox) {
+                        float_t* p = &col_sum[ox * g.stride_x];
+                        const float_t d = weight * delta[ox];
+                        for (serial_size_t dx = 0; dx < g.pool_size_x; ++dx)
+                            p[dx] += d;
+                    }
+                    float_t* rows = &prev_delta[g.in.get_index(0, oy * g.stride_y, c)];
+                    for (serial_size_t dy = 0; dy < g.pool_size_y; ++dy) {
+                        vectorize::reduce<float_t>(&col_sum[0], width, rows + dy * width);
+                    }
+                }
+                idx += g.out.width_;
+            }
 
-            for (auto o : outs)
-                diff += curr_delta[o];
-
-            db[i] += diff;
+            dW[c] += diff * scale_factor;
+            db[c] += bias_diff;
         }
     });
 }
@@ -133,9 +199,9 @@ void tiny_average_pooling_back_kernel(const std::vector<tensor_t*>&   in_data,
  * average pooling with trainable weights
  **/
 template<typename Activation = activation::identity>
-class average_pooling_layer : public partial_connected_layer<Activation> {
+class average_pooling_layer : public feedforward_layer<Activation> {
  public:
-    typedef partial_connected_layer<Activation> Base;
+    typedef feedforward_layer<Activation> Base;
     CNN_USE_LAYER_MEMBERS;
 
     /**
@@ -190,10 +256,8 @@ class average_pooling_layer : public partial_connected_layer<Activation> {
                           serial_size_t     stride_x,
                           serial_size_t     stride_y,
                           padding        pad_type = padding::valid)
-        : Base(in_width * in_height * in_channels,
-            conv_out_length(in_width, pool_size_x, stride_x, pad_type) *
-            conv_out_length(in_height, pool_size_y, stride_y, pad_type) * in_channels,
-            in_channels, in_channels, float_t(1) / (pool_size_x * pool_size_y)),
+        : Base(std_input_order(true)),
+        scale_factor_(float_t(1) / (pool_size_x * pool_size_y)),
         stride_x_(stride_x),
         stride_y_(stride_y),
         pool_size_x_(pool_size_x),
@@ -206,8 +270,17 @@ class average_pooling_layer : public partial_connected_layer<Activation> {
         if ((in_width % pool_size_x) || (in_height % pool_size_y)) {
             pooling_size_mismatch(in_width, in_height, pool_size_x, pool_size_y);
         }
+    }
+
+    serial_size_t fan_in_size() const override {
+        const auto g = geometry();
+        return (g.windows_x() && g.windows_y()) ? pool_size_x_ * pool_size_y_ : 0;
+    }
 
-        init_connection(pool_size_x, pool_size_y);
+    serial_size_t fan_out_size() const override {
+        const auto g = geometry();
+        return max_overlap(in_.width_, g.windows_x(), pool_size_x_, stride_x_) *
+               max_overlap(in_.height_, g.windows_y(), pool_size_y_, stride_y_);
     }
     std::vector<index3d<serial_size_t>> in_shape() const override {
         return { in_, w_, index3d<serial_size_t>(1, 1, out_.depth_) };
@@ -226,11 +299,9 @@ class average_pooling_layer : public partial_connected_layer<Activation> {
             parallelize_,
             in_data,
             out_data,
-            out_,
-            Base::scale_factor_,
-            Base::out2wi_,
+            geometry(),
+            scale_factor_,
             Base::h_);
-        
     }
 
     void back_propagation(const std::vector<tensor_t*>& in_data,
@@ -241,16 +312,12 @@ class average_pooling_layer : public partial_connected_layer<Activation> {
         tensor_t& curr_delta = *out_grad[0];
         this->backward_activation(*out_grad[0], *out_data[0], curr_delta);
 
-        tiny_average_pooling_back_kernel<Activation>(
+        tiny_average_pooling_back_kernel(
             in_data,
-            out_data,
             out_grad,
             in_grad,
-            in_,
-            Base::scale_factor_,
-            Base::weight2io_,
-            Base::in2wo_,
-            Base::bias2out_);
+            geometry(),
+            scale_factor_);
     }
 
     template <class Archive>
@@ -284,6 +351,7 @@ class average_pooling_layer : public partial_connected_layer<Activation> {
     std::pair<serial_size_t, serial_size_t> pool_size() const { return std::make_pair(pool_size_x_, pool_size_y_); }
 
  private:
+    float_t scale_factor_;
     serial_size_t stride_x_;
     serial_size_t stride_y_;
     serial_size_t pool_size_x_;
@@ -293,49 +361,31 @@ class average_pooling_layer : public partial_connected_layer<Activation> {
     shape3d out_;
     shape3d w_;
 
-    static serial_size_t pool_out_dim(serial_size_t in_size,
-                                   serial_size_t pooling_size,
-                                   serial_size_t stride) {
-        return static_cast<int>(std::ceil((
-            static_cast<float_t>(in_size) - pooling_size) / stride) + 1);
-    }
-
-    void init_connection(serial_size_t pooling_size_x, serial_size_t pooling_size_y) {
-        for (serial_size_t c = 0; c < in_.depth_; ++c) {
-            for (serial_size_t y = 0; y < in_.height_ - pooling_size_y + 1; y += stride_y_) {
-                for (serial_size_t x = 0; x < in_.width_ - pooling_size_x + 1; x += stride_x_) {
-                    connect_kernel(pooling_size_x, pooling_size_y, x, y, c);
-                }
-            }
-        }
-
-        for (serial_size_t c = 0; c < in_.depth_; ++c) {
-            for (serial_size_t y = 0; y < out_.height_; ++y) {
-                for (serial_size_t x = 0; x < out_.width_; ++x) {
-                    this->connect_bias(c, out_.get_index(x, y, c));
-                }
-            }
-        }
+    average_pooling_geometry geometry() const {
+        average_pooling_geometry g;
+        g.in          = in_;
+        g.out         = out_;
+        g.pool_size_x = pool_size_x_;
+        g.pool_size_y = pool_size_y_;
+        g.stride_x    = stride_x_;
+        g.stride_y    = stride_y_;
+        return g;
     }
 
-    void connect_kernel(serial_size_t pooling_size_x,
-                        serial_size_t pooling_size_y,
-                        serial_size_t x,
-                        serial_size_t y,
-                        serial_size_t inc) {
-        serial_size_t dymax = std::min(pooling_size_y, in_.height_ - y);
-        serial_size_t dxmax = std::min(pooling_size_x, in_.width_ - x);
-        serial_size_t dstx = x / stride_x_;
-        serial_size_t dsty = y / stride_y_;
-        serial_size_t outidx = out_.get_index(dstx, dsty, inc);
-        for (serial_size_t dy = 0; dy < dymax; ++dy) {
-            for (serial_size_t dx = 0; dx < dxmax; ++dx) {
-                this->connect_weight(
-                    in_.get_index(x + dx, y + dy, inc),
-                    outidx,
-                    inc);
+    // largest number of windows covering one input position along an axis
+    static serial_size_t max_overlap(serial_size_t in_size,
+                                     serial_size_t windows,
+                                     serial_size_t pool_size,
+                                     serial_size_t stride) {
+        serial_size_t overlap = 0;
+        for (serial_size_t x = 0; x < in_size; x++) {
+            serial_size_t n = 0;
+            for (serial_size_t w = 0; w < windows && w * stride <= x; w++) {
+                if (x < w * stride + pool_size) n++;
             }
+            overlap = std::max(overlap, n);
         }
+        return overlap;
     }
 };
 
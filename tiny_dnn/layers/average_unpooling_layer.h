@@ -88,11 +88,11 @@ void tiny_average_unpooling_back_kernel(const std::vector<tensor_t*>&   in_data,
                                         std::vector<typename partial_connected_layer<Activation>::wo_connections>& in2wo,
                                         std::vector<std::vector<serial_size_t>>& bias2out) {
 
-    for (size_t sample = 0; sample < in_data[0]->size(); sample++) {
+    for_i_slotted(false, in_data[0]->size(), in_grad[1]->size(), [&](int slot, int sample) {
         const vec_t& prev_out   = (*in_data[0])[sample];
         const vec_t& W          = (*in_data[1])[0];
-        vec_t&       dW         = (*in_grad[1])[sample];
-        vec_t&       db         = (*in_grad[2])[sample];
+        vec_t&       dW         = (*in_grad[1])[slot];
+        vec_t&       db         = (*in_grad[2])[slot];
         vec_t&       prev_delta = (*in_grad[0])[sample];
         vec_t&       curr_delta = (*out_grad[0])[sample];
 
@@ -124,7 +124,7 @@ void tiny_average_unpooling_back_kernel(const std::vector<tensor_t*>&   in_data,
 
             db[i] += diff;
         }
-    }
+    });
 }
 
 /**
@@ -224,24 +224,29 @@ class convolutional_layer : public feedforward_layer<Activation> {
         // apply padding to the input tensor
         padding_op_.copy_and_pad_input(*in_data[0], cws_.prev_out_padded_);
 
-        std::vector<tensor_t*> in_data_(in_data.size());
-        in_data_[0] = in_data_padded(in_data);
-
-        for (serial_size_t i = 1; i < in_data.size(); ++i) {
-            in_data_[i] = in_data[i];
-        }
+        cws_.in_data_.assign(in_data.begin(), in_data.end());
+        cws_.in_data_[0] = in_data_padded(in_data);
 
         // forward convolutional op context
-        auto ctx = OpKernelContext(in_data_, out_data);
+        OpKernelContext& ctx = fwd_ctx_;
+             ctx.bind(cws_.in_data_, out_data);
              ctx.setParallelize(layer::parallelize());
              ctx.setEngine(layer::engine());
+             ctx.setLayer(this);
+
+        // the kernel applies the activation to each sample it computes
+        // when it supports it
+        const bool fused = kernel_fwd_->fusesEpilogue();
+        ctx.setEpilogue(fused ? activation::epilogue(&this->h_, out_data[0])
+                              : activation::epilogue());
 
         // launch convolutional kernel
         kernel_fwd_->compute(ctx);
 
         // activations
-        // TODO(edgar/nyanp): refactor and move activations outside
-        this->forward_activation(*out_data[0], *out_data[1]);
+        if (!fused) {
+            this->forward_activation(*out_data[0], *out_data[1]);
+        }
     }
 
     /**
@@ -259,23 +264,16 @@ class convolutional_layer : public feedforward_layer<Activation> {
         // TODO(edgar/nyanp): refactor and move activations outside
         this->backward_activation(*out_grad[0], *out_data[0], *out_grad[1]);
 
-        std::vector<tensor_t*> in_data_;
-        in_data_.push_back(in_data_padded(in_data));
-
-        for (serial_size_t i = 1; i < in_data.size(); ++i) {
-            in_data_.push_back(in_data[i]);
-        }
-
-        std::vector<tensor_t*> in_grad_;
-        for (serial_size_t i = 0; i < in_grad.size(); ++i) {
-            in_grad_.push_back(in_grad[i]);
-        }
+        cws_.in_data_.assign(in_data.begin(), in_data.end());
+        cws_.in_data_[0] = in_data_padded(in_data);
 
+        cws_.in_grad_.assign(in_grad.begin(), in_grad.end());
         if (params_.pad_type == padding::same) {
-            in_grad_[0] = &cws_.prev_delta_padded_;
+            cws_.in_grad_[0] = &cws_.prev_delta_padded_;
         }
 
-        auto ctx = OpKernelContext(in_data_, out_data, out_grad, in_grad_);
+        OpKernelContext& ctx = bwd_ctx_;
+             ctx.bind(cws_.in_data_, out_data, out_grad, cws_.in_grad_);
              ctx.setParams(&params_);
              ctx.setParallelize(layer::parallelize());
              ctx.setEngine(layer::engine());
@@ -289,9 +287,12 @@ class convolutional_layer : public feedforward_layer<Activation> {
 
     void set_sample_count(serial_size_t sample_count) override {
         Base::set_sample_count(sample_count);
-        cws_.prev_delta_padded_.resize(
-            sample_count,
-            vec_t(params_.in_padded.size(), float_t(0)));
+        if (!this->inference_only() &&
+            cws_.prev_delta_padded_.size() != sample_count) {
+            cws_.prev_delta_padded_.resize(
+                sample_count,
+                vec_t(params_.in_padded.size(), float_t(0)));
+        }
     }
 
     std::vector<index3d<serial_size_t>> in_shape() const override {
@@ -311,6 +312,8 @@ class convolutional_layer : public feedforward_layer<Activation> {
         return std::string("conv");
     }
 
+    const core::conv_params& params() const { return params_; }
+
     //TODO(edgar): check this
     std::string kernel_file() const override {
         return std::string("../tiny_cnn/core/kernels/cl_kernels/conv_layer_spatial.cl");
@@ -412,6 +415,16 @@ class convolutional_layer : public feedforward_layer<Activation> {
             );
     }
 
+protected:
+    size_t release_gradients() override {
+        size_t bytes = Base::release_gradients();
+        for (const auto& v : cws_.prev_delta_padded_) {
+            bytes += v.capacity() * sizeof(float_t);
+        }
+        tensor_t().swap(cws_.prev_delta_padded_);
+        return bytes;
+    }
+
 private:
     tensor_t* in_data_padded(const std::vector<tensor_t*>& in) {
         return (params_.pad_type == padding::valid) ?
@@ -486,7 +499,8 @@ private:
 
         if (backend_type == backend_t::internal ||
             backend_type == backend_t::nnpack   ||
-            backend_type == backend_t::avx) {
+            backend_type == backend_t::avx      ||
+            backend_type == backend_t::gemm) {
             
             kernel_fwd_.reset(new Conv2dOp(ctx));
             kernel_back_.reset(new Conv2dGradOp(ctx));
@@ -521,10 +535,17 @@ private:
     std::shared_ptr<core::OpKernel> kernel_fwd_;
     std::shared_ptr<core::OpKernel> kernel_back_;
 
+    /* Contexts reused by every forward/backward call */
+    OpKernelContext fwd_ctx_;
+    OpKernelContext bwd_ctx_;
+
     /* Buffer to store padded data */
     struct conv_layer_worker_specific_storage {
         tensor_t prev_out_padded_;
         tensor_t prev_delta_padded_;
+        // in_data/in_grad with the padded tensors in place of the originals
+        std::vector<tensor_t*> in_data_;
+        std::vector<tensor_t*> in_grad_;
     } cws_;
 };
 
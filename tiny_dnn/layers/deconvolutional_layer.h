@@ -303,8 +303,13 @@ private:
     void init_backend(const backend_t backend_type) {
         std::shared_ptr<core::backend> backend = nullptr;
 
-        // allocate new backend
-        if (backend_type == backend_t::internal) {
+        // allocate new backend. without CNN_USE_AVX the avx engine runs the
+        // internal kernels, as avx_backend does for deconvolution anyway
+        if (backend_type == backend_t::internal
+#ifndef CNN_USE_AVX
+            || backend_type == backend_t::avx
+#endif
+            ) {
             backend = std::make_shared<core::tiny_backend>(&params_,
                     [this](const tensor_t& in) {
                         return copy_and_unpad_output(in);
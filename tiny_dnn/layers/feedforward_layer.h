@@ -43,7 +43,9 @@ public:
 
 public:
     void forward_activation(tensor_t& a_tensor, tensor_t& out_tensor) {
-        serial_size_t out_dim = out_shape()[0].size();
+        // ask the output edge when connected: out_shape() builds a vector
+        const serial_size_t out_dim = next()[0] ?
+            next()[0]->shape().size() : out_shape()[0].size();
 
         for_i(a_tensor.size(), [&](int sample) {
             vec_t& out = a_tensor[sample];
@@ -58,23 +60,9 @@ public:
 
         // @todo consider parallelism
         for_i(this_out.size(), [&](serial_size_t sample) {
-            const vec_t& out_vec = this_out[sample];
             const vec_t& prev_delta_vec = prev_delta[sample];
-            vec_t& curr_delta_vec = curr_delta[sample];
-
-            const serial_size_t len = static_cast<serial_size_t>(prev_delta_vec.size());
-            
-            if (h_.one_hot()) {
-                for (serial_size_t c = 0; c < len; c++) {
-                    curr_delta_vec[c] = prev_delta_vec[c] * h_.df(out_vec[c]);
-                }
-            }
-            else {
-                for (serial_size_t c = 0; c < len; c++) {
-                    vec_t df = h_.df(out_vec, c);
-                    curr_delta_vec[c] = vectorize::dot(&prev_delta_vec[0], &df[0], len);
-                }
-            }
+            h_.itedf(curr_delta[sample], prev_delta_vec, this_out[sample],
+                     prev_delta_vec.size());
         });
     }
 
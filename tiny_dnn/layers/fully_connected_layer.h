@@ -94,15 +94,24 @@ public:
     void forward_propagation(const std::vector<tensor_t*>& in_data,
                              std::vector<tensor_t*>&       out_data) override {
         // forward convolutional op context
-        auto ctx = OpKernelContext(in_data, out_data);
+        OpKernelContext& ctx = fwd_ctx_;
+             ctx.bind(in_data, out_data);
              ctx.setParallelize(layer::parallelize());
              ctx.setEngine(layer::engine());
 
+        // the kernel applies the activation to each sample it computes
+        // when it supports it
+        const bool fused = kernel_fwd_->fusesEpilogue();
+        ctx.setEpilogue(fused ? activation::epilogue(&this->h_, out_data[0])
+                              : activation::epilogue());
+
         // launch convolutional kernel
         kernel_fwd_->compute(ctx);
 
         // activations
-        this->forward_activation(*out_data[0], *out_data[1]);
+        if (!fused) {
+            this->forward_activation(*out_data[0], *out_data[1]);
+        }
     }
 
     void back_propagation(const std::vector<tensor_t*>& in_data,
@@ -114,7 +123,8 @@ public:
         this->backward_activation(*out_grad[0], *out_data[0], *out_grad[1]);
 
         // backward convolutional op context
-        auto ctx = OpKernelContext(in_data, out_data, out_grad, in_grad);
+        OpKernelContext& ctx = bwd_ctx_;
+             ctx.bind(in_data, out_data, out_grad, in_grad);
              ctx.setParallelize(layer::parallelize());
              ctx.setEngine(layer::engine());
 
@@ -124,6 +134,8 @@ public:
 
     std::string layer_type() const override { return "fully-connected"; }
 
+    const core::fully_params& params() const { return params_; }
+
     template <class Archive>
     static void load_and_construct(Archive & ar, cereal::construct<fully_connected_layer> & construct) {
         serial_size_t in_dim, out_dim;
@@ -159,7 +171,8 @@ protected:
 
         if (backend_type == backend_t::internal ||
             backend_type == backend_t::avx ||
-            backend_type == backend_t::nnpack) {
+            backend_type == backend_t::nnpack ||
+            backend_type == backend_t::gemm) {
 
             kernel_fwd_.reset(new FullyConnectedOp(ctx));
             kernel_back_.reset(new FullyConnectedGradOp(ctx));
@@ -177,6 +190,10 @@ protected:
     /* Forward and backward ops */
     std::shared_ptr<core::OpKernel> kernel_fwd_;
     std::shared_ptr<core::OpKernel> kernel_back_;
+
+    /* Contexts reused by every forward/backward call */
+    OpKernelContext fwd_ctx_;
+    OpKernelContext bwd_ctx_;
 };
 
 } // namespace tiny_dnn
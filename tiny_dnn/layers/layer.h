@@ -78,6 +78,8 @@ class layer : public node {
             : node(static_cast<serial_size_t>(in_type.size()), static_cast<serial_size_t>(out_type.size())),
               initialized_(false),
               parallelize_(true),
+              inference_only_(false),
+              weights_version_(0),
               in_channels_(static_cast<serial_size_t>(in_type.size())),
               out_channels_(static_cast<serial_size_t>(out_type.size())),
               in_type_(in_type),
@@ -99,6 +101,17 @@ class layer : public node {
         parallelize_ = parallelize;
     }
 
+    /**
+     * in inference-only mode the layer never allocates, resizes or clears
+     * gradient buffers. enabling it releases the buffers already allocated.
+     *
+     * @return number of bytes released
+     **/
+    size_t set_inference_only(bool inference_only) {
+        inference_only_ = inference_only;
+        return inference_only ? release_gradients() : 0;
+    }
+
     void set_backend(std::shared_ptr<core::backend> backend) {
         backend_ = backend;
     }
@@ -112,6 +125,22 @@ class layer : public node {
 
     bool parallelize() const { return parallelize_; }
 
+    bool inference_only() const { return inference_only_; }
+
+    /**
+     * counter which changes whenever mutable access to the weights is
+     * handed out (weights(), update_weight, init_weight, load...).
+     * layers caching data derived from their weights compare it to decide
+     * whether the cache is still valid.
+     **/
+    size_t weights_version() const { return weights_version_; }
+
+    /**
+     * tell the layer its weights were changed behind its back, e.g. through
+     * a parameter_arena, so caches keyed on weights_version are rebuilt
+     **/
+    void weights_modified() { weights_version_++; }
+
     // TODO(edgar): Deprecated: use the below method 
     core::backend_t backend_type() const {
         return backend_->type();
@@ -182,6 +211,18 @@ class layer : public node {
         return out_data_size();
     }
 
+    /**
+     * true if w is one of the layer's own weight vectors, i.e. its contents
+     * are covered by weights_version
+     **/
+    bool owns_weight(const vec_t& w) const {
+        for (serial_size_t i = 0; i < in_channels_; i++) {
+            if (is_trainable_weight(in_type_[i]) &&
+                get_weight_data(i) == &w) return true;
+        }
+        return false;
+    }
+
     std::vector<const vec_t*> weights() const {
         std::vector<const vec_t*> v;
         for (serial_size_t i = 0; i < in_channels_; i++) {
@@ -242,7 +283,7 @@ class layer : public node {
         for (serial_size_t i = 0; i < out_channels_; i++) {
             if (out_type_[i] != vector_type::data) continue;
             assert(j < grad.size());
-            *ith_out_node(i)->get_gradient() = grad[j++];
+            *ith_out_node(i)->overwrite_gradient() = grad[j++];
         }
     }
 
@@ -353,6 +394,13 @@ class layer : public node {
         initialized_ = true;
     }
 
+    /**
+     * mark the weights as loaded by the caller, so setup() keeps them
+     **/
+    void set_weights_loaded() {
+        initialized_ = true;
+    }
+
     virtual void save(std::ostream& os) const { // NOLINT
         /*if (is_exploded()) {
             throw nn_error("failed to save weights because of infinite weight");
@@ -418,6 +466,36 @@ class layer : public node {
      **/
     //virtual void back_propagation_2nd(const std::vector<vec_t>& delta_in) = 0;
 
+    /**
+     * true if this layer can run on uint8 activations, see forward_quantized
+     **/
+    virtual bool can_forward_quantized() const { return false; }
+
+    /**
+     * fixed range the float input of this layer is quantized with when
+     * entering quantized execution. returns false if the range is taken
+     * from each input sample.
+     **/
+    virtual bool quantized_input_range(float_t* min, float_t* max) const {
+        CNN_UNREFERENCED_PARAMETER(min);
+        CNN_UNREFERENCED_PARAMETER(max);
+        return false;
+    }
+
+    /**
+     * forward one batch of uint8 activations, used by the quantized execution
+     * mode of sequential networks. the first data input is read from in and
+     * the first data output is written to out, activation included; the
+     * edges of the layer are left untouched.
+     *
+     * only called if can_forward_quantized() returns true.
+     **/
+    virtual void forward_quantized(const quantized_tensor& in, quantized_tensor& out) {
+        CNN_UNREFERENCED_PARAMETER(in);
+        CNN_UNREFERENCED_PARAMETER(out);
+        throw nn_not_implemented_error("quantized forward is not supported by " + layer_type());
+    }
+
     // called afrer updating weight
     virtual void post_update() {}
 
@@ -484,51 +562,93 @@ class layer : public node {
      *
      */
     void forward() {
-        // the computational graph
-        std::vector<tensor_t*> in_data, out_data;
-
         // Organize input/output vectors from storage (computational graph).
         // Internally ith_in_node() will create a connection/edge in the
         // computational graph and will allocate memory in case that it's not
-        // done yet.
+        // done yet. The vectors are members, so after the first call
+        // refilling them does not allocate.
+        in_data_.clear();
         for (serial_size_t i = 0; i < in_channels_; i++) {
-            in_data.push_back(ith_in_node(i)->get_data());
+            in_data_.push_back(ith_in_node(i)->get_data());
         }
 
         // resize outs and stuff to have room for every input sample in
         // the batch
-        set_sample_count(static_cast<serial_size_t>(in_data[0]->size()));
+        set_sample_count(static_cast<serial_size_t>(in_data_[0]->size()));
 
         // Internally ith_out_node() will create a connection/edge to the
         // computational graph and will allocate memory in case that it's not
         // done yet. In addition, gradient vector are initialized to default
         // values.
+        out_data_.clear();
         for (serial_size_t i = 0; i < out_channels_; i++) {
-            out_data.push_back(ith_out_node(i)->get_data());
-            ith_out_node(i)->clear_grads();
+            out_data_.push_back(ith_out_node(i)->get_data());
+            if (!inference_only_) ith_out_node(i)->clear_grads();
         }
 
         // call the forward computation kernel/routine
-        forward_propagation(in_data, out_data);
+        forward_propagation(in_data_, out_data_);
     }
 
     void backward() {
-        std::vector<tensor_t*> in_data, out_data, in_grad, out_grad;
-
         // organize input/output vectors from storage
+        in_data_.clear();
+        in_grad_.clear();
         for (serial_size_t i = 0; i < in_channels_; i++) {
-            in_data.push_back(ith_in_node(i)->get_data());
+            in_data_.push_back(ith_in_node(i)->get_data());
+            in_grad_.push_back(ith_in_node(i)->get_gradient());
         }
+        out_data_.clear();
+        out_grad_.clear();
         for (serial_size_t i = 0; i < out_channels_; i++) {
-            out_data.push_back(ith_out_node(i)->get_data());
+            out_data_.push_back(ith_out_node(i)->get_data());
+            out_grad_.push_back(ith_out_node(i)->get_gradient());
         }
+        back_propagation(in_data_, out_data_, out_grad_, in_grad_);
+    }
+
+    /**
+     * prepare forward_compiled/backward_compiled for batches of sample_count
+     * samples: resolve the edges once and size all buffers. called by
+     * nodes::compile, must be repeated when the batch size or the
+     * connections change.
+     **/
+    void compile(serial_size_t sample_count) {
+        in_data_.clear();
+        in_grad_.clear();
         for (serial_size_t i = 0; i < in_channels_; i++) {
-            in_grad.push_back(ith_in_node(i)->get_gradient());
+            in_data_.push_back(ith_in_node(i)->get_data());
+            in_grad_.push_back(ith_in_node(i)->get_gradient());
         }
+        out_data_.clear();
+        out_grad_.clear();
         for (serial_size_t i = 0; i < out_channels_; i++) {
-            out_grad.push_back(ith_out_node(i)->get_gradient());
+            out_data_.push_back(ith_out_node(i)->get_data());
+            out_grad_.push_back(ith_out_node(i)->get_gradient());
+        }
+        set_sample_count(sample_count);
+    }
+
+    /**
+     * forward() of a compiled layer, without edge lookup or resizing
+     **/
+    void forward_compiled() {
+        if (!inference_only_) {
+            for (serial_size_t i = 0; i < out_channels_; i++) {
+                next_[i]->clear_grads();
+            }
         }
-        back_propagation(in_data, out_data, out_grad, in_grad);
+        forward_propagation(in_data_, out_data_);
+    }
+
+    /**
+     * backward() of a compiled layer, without edge lookup
+     **/
+    void backward_compiled() {
+        // gradients reset by clear_grads are zero-filled on first access
+        for (serial_size_t i = 0; i < in_channels_; i++) prev_[i]->get_gradient();
+        for (serial_size_t i = 0; i < out_channels_; i++) next_[i]->get_gradient();
+        back_propagation(in_data_, out_data_, out_grad_, in_grad_);
     }
 
     /* @brief Allocates data in the computational graph and reset weights if
@@ -620,26 +740,35 @@ class layer : public node {
         }
     }
 
-    void update_weight(optimizer *o, serial_size_t batch_size) {
-        float_t rcp_batch_size = float_t(1) / float_t(batch_size);
-        vec_t diff;
+    /**
+     * append the trainable weights of this layer and their gradients
+     * to params, for optimizer::update_parameters
+     **/
+    void trainable_parameters(std::vector<trainable_parameter>* params) {
+        if (!trainable()) return;
         for (serial_size_t i = 0; i < static_cast<serial_size_t>(in_type_.size()); i++) {
-            if (trainable() && is_trainable_weight(in_type_[i])) {
-                vec_t& target = *get_weight_data(i);
-                ith_in_node(i)->merge_grads(&diff);
-                std::transform(diff.begin(), diff.end(),
-                               diff.begin(), [&](float_t x) { // NOLINT
-                                  return x * rcp_batch_size; });
-                // parallelize only when target size is big enough to mitigate
-                // thread spawning overhead.
-                bool parallelize = (target.size() >= 512);
-                o->update(diff, target, parallelize);
+            if (is_trainable_weight(in_type_[i])) {
+                params->emplace_back(get_weight_data(i),
+                                     ith_in_node(i)->get_gradient());
             }
         }
+    }
+
+    /**
+     * called after the weights have been updated by the optimizer
+     **/
+    void finish_update() {
         clear_grads();
         post_update();
     }
 
+    void update_weight(optimizer *o, serial_size_t batch_size) {
+        std::vector<trainable_parameter> params;
+        trainable_parameters(&params);
+        o->update_parameters(params, float_t(1) / float_t(batch_size), parallelize_);
+        finish_update();
+    }
+
     bool has_same_weights(const layer& rhs, float_t eps) const {
         auto w1 = weights();
         auto w2 = rhs.weights();
@@ -655,25 +784,32 @@ class layer : public node {
         return true;
     }
 
+    /**
+     * resize data/gradient buffers for sample_count samples.
+     *
+     * gradients of trainable weights are not kept per sample: each worker
+     * thread accumulates into its own slot (see for_i_slotted), so their
+     * memory is O(threads x params) instead of O(batch x params).
+     **/
     virtual void set_sample_count(serial_size_t sample_count) {
-
-        // increase the size if necessary - but do not decrease
-        auto resize = [sample_count](tensor_t* tensor) {
-            tensor->resize(sample_count, (*tensor)[0]);
-        };
+        const serial_size_t grad_slots = parallelize_ ?
+            std::max(serial_size_t(1), std::min(sample_count,
+                static_cast<serial_size_t>(num_threads()))) : 1;
 
         for (serial_size_t i = 0; i < in_channels_; i++) {
-            if (!is_trainable_weight(in_type_[i])) {
-                resize(ith_in_node(i)->get_data());
+            if (is_trainable_weight(in_type_[i])) {
+                ith_in_node(i)->set_sample_count(grad_slots, false,
+                                                 !inference_only_);
+            } else {
+                ith_in_node(i)->set_sample_count(sample_count, true,
+                                                 !inference_only_);
             }
-            resize(ith_in_node(i)->get_gradient());
         }
 
         for (serial_size_t i = 0; i < out_channels_; i++) {
-            if (!is_trainable_weight(out_type_[i])) {
-                resize(ith_out_node(i)->get_data());
-            }
-            resize(ith_out_node(i)->get_gradient());
+            ith_out_node(i)->set_sample_count(sample_count,
+                                              !is_trainable_weight(out_type_[i]),
+                                              !inference_only_);
         }
     }
 
@@ -690,10 +826,31 @@ class layer : public node {
     void serialize_prolog(Archive & ar);
 
  protected:
+    /**
+     * release gradient storage of the edges connected to this layer.
+     * layers keeping additional per-sample gradient buffers extend this.
+     *
+     * @return number of bytes released
+     **/
+    virtual size_t release_gradients() {
+        size_t bytes = 0;
+        for (auto& e : prev_) {
+            if (e) bytes += e->release_gradients();
+        }
+        for (auto& e : next_) {
+            if (e) bytes += e->release_gradients();
+        }
+        return bytes;
+    }
+
     /** Flag indication whether the layer/node is initialized */
     bool initialized_;
     /** Flag indicating whether the layer/node operations ara paralellized */
     bool parallelize_;
+    /** Flag indicating whether gradient buffers are left unallocated */
+    bool inference_only_;
+    /** Incremented on every mutable access to the weights */
+    size_t weights_version_;
     /** The number of input vectors/edges */
     serial_size_t in_channels_;
     /** The number of output vectors/edges */
@@ -708,6 +865,8 @@ class layer : public node {
     std::shared_ptr<core::backend> backend_;
     /** Pointer to the device on which the layer/node will run */
     Device* device_ptr_ = nullptr;
+    /** Edge tensors passed to forward/back_propagation, refilled per call */
+    std::vector<tensor_t*> in_data_, out_data_, in_grad_, out_grad_;
 
  private:
     /** Flag indicating whether the layer/node parameters are trainable */
@@ -787,6 +946,7 @@ class layer : public node {
      */
     vec_t* get_weight_data(serial_size_t i) {
         assert(is_trainable_weight(in_type_[i]));
+        weights_version_++;
         return &(*(ith_in_node(i)->get_data()))[0];
     }
 
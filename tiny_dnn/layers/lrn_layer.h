@@ -124,9 +124,7 @@ public:
                 forward_within(in, a);
             }
 
-            for_i(parallelize_, out.size(), [&](int i) {
-                out[i] = h_.f(a, i);
-            });
+            h_.itef(out, a, out.size());
         }
     }
 
@@ -110,7 +110,6 @@ class max_pooling_layer : public feedforward_layer<Activation> {
                     in_channels),
             pooling_size_x, pooling_size_y, stride_x, stride_y, pad_type);
 
-        init_connection();
         init_backend(backend_type);
         Base::set_backend_type(backend_type);
     }
@@ -119,12 +118,12 @@ class max_pooling_layer : public feedforward_layer<Activation> {
     max_pooling_layer(max_pooling_layer&& other)  // NOLINT
             : Base(std::move(other))
             , params_(std::move(other.params_)) {
-        init_connection();
         init_backend(std::move(Base::engine()));
     }
 
     serial_size_t fan_in_size() const override {
-        return static_cast<serial_size_t>(params_.out2in[0].size());
+        return std::min(params_.pool_size_x, params_.in.width_) *
+               std::min(params_.pool_size_y, params_.in.height_);
     }
 
     serial_size_t fan_out_size() const override {
@@ -134,7 +133,8 @@ class max_pooling_layer : public feedforward_layer<Activation> {
     void forward_propagation(const std::vector<tensor_t*>& in_data,
                              std::vector<tensor_t*>&       out_data) override {
 	// forward convolutional op context
-        auto ctx = OpKernelContext(in_data, out_data);
+        OpKernelContext& ctx = fwd_ctx_;
+             ctx.bind(in_data, out_data);
              ctx.setParallelize(layer::parallelize());
              ctx.setEngine(layer::engine());
 
@@ -154,7 +154,8 @@ class max_pooling_layer : public feedforward_layer<Activation> {
         this->backward_activation(*out_grad[0], *out_data[0], *out_grad[1]);
 
         // backward convolutional op context
-        auto ctx = OpKernelContext(in_data, out_data, out_grad, in_grad);
+        OpKernelContext& ctx = bwd_ctx_;
+             ctx.bind(in_data, out_data, out_grad, in_grad);
              ctx.setParallelize(layer::parallelize());
              ctx.setEngine(layer::engine());
 
@@ -182,8 +183,10 @@ class max_pooling_layer : public feedforward_layer<Activation> {
 
     void set_sample_count(serial_size_t sample_count) override {
         Base::set_sample_count(sample_count);
-        params_.out2inmax.resize(
-	     sample_count, std::vector<serial_size_t>(params_.out.size()));
+        if (params_.out2inmax.size() != sample_count) {
+            params_.out2inmax.resize(
+                sample_count, std::vector<serial_size_t>(params_.out.size()));
+        }
     }
 
 
@@ -224,52 +227,9 @@ private:
     std::shared_ptr<core::OpKernel> kernel_fwd_;
     std::shared_ptr<core::OpKernel> kernel_back_;
 
-    void connect_kernel(serial_size_t pooling_size_x,
-                        serial_size_t pooling_size_y,
-                        serial_size_t outx,
-                        serial_size_t outy,
-                        serial_size_t c) {
-        serial_size_t dxmax = static_cast<serial_size_t>(
-            std::min(static_cast<serial_size_t>(pooling_size_x),
-                     params_.in.width_ - outx * params_.stride_x));
-
-        serial_size_t dymax = static_cast<serial_size_t>(
-            std::min(static_cast<serial_size_t>(pooling_size_y),
-                     params_.in.height_ - outy * params_.stride_y));
-
-        for (serial_size_t dy = 0; dy < dymax; dy++) {
-            for (serial_size_t dx = 0; dx < dxmax; dx++) {
-                serial_size_t in_index = params_.in.get_index(
-                    static_cast<serial_size_t>(outx * params_.stride_x + dx),
-                    static_cast<serial_size_t>(outy * params_.stride_y + dy), c);
-                serial_size_t out_index = params_.out.get_index(outx, outy, c);
-
-                if (in_index >= params_.in2out.size()) {
-                    throw nn_error("index overflow");
-                }
-                if (out_index >= params_.out2in.size()) {
-                    throw nn_error("index overflow");
-                }
-                params_.in2out[in_index] = out_index;
-                params_.out2in[out_index].push_back(in_index);
-            }
-        }
-    }
-
-    void init_connection() {
-        params_.in2out.resize(params_.in.size());
-        params_.out2in.resize(params_.out.size());
-
-        for (serial_size_t c = 0; c < params_.in.depth_; ++c) {
-            for (serial_size_t y = 0; y < params_.out.height_; ++y) {
-                for (serial_size_t x = 0; x < params_.out.width_; ++x) {
-                    connect_kernel(params_.pool_size_x,
-                                   params_.pool_size_y,
-                                   x, y, c);
-                }
-            }
-        }
-    }
+    /* Contexts reused by every forward/backward call */
+    OpKernelContext fwd_ctx_;
+    OpKernelContext bwd_ctx_;
 
     void init_backend(backend_t backend_type) {
 	core::OpKernelConstruction ctx =
@@ -189,7 +189,7 @@ class quantized_convolutional_layer : public feedforward_layer<Activation> {
                                   serial_size_t              w_stride = 1,
                                   serial_size_t              h_stride = 1,
                                   backend_t      backend_type = core::backend_t::internal)
-        : Base(has_bias ? 3 : 2, 1, std_input_order(has_bias)) {
+        : Base(std_input_order(has_bias)) {
             conv_set_params(shape3d(in_width, in_height, in_channels),
                             window_width, window_height,
                             out_channels, pad_type, has_bias,
@@ -236,6 +236,40 @@ class quantized_convolutional_layer : public feedforward_layer<Activation> {
         }
     }
 
+    /**
+     * use fixed activation ranges (e.g. from quantization_calibrator)
+     * instead of computing them from every input
+     **/
+    void set_quantization_ranges(const core::quantization_ranges& ranges) {
+        params_.q_ranges = ranges;
+    }
+
+    const core::quantization_ranges& quantization_ranges() const {
+        return params_.q_ranges;
+    }
+
+    bool quantized_input_range(float_t* min, float_t* max) const override {
+        if (!params_.q_ranges.valid) return false;
+        *min = params_.q_ranges.in_min;
+        *max = params_.q_ranges.in_max;
+        return true;
+    }
+
+    bool can_forward_quantized() const override {
+        core::kernels::quantized_epilogue ep;
+        return Base::backend_type() == core::backend_t::internal &&
+               core::kernels::make_quantized_epilogue(this->h_, &ep);
+    }
+
+    void forward_quantized(const quantized_tensor& in, quantized_tensor& out) override {
+        core::kernels::quantized_epilogue& ep = epilogue_;
+        core::kernels::make_quantized_epilogue(this->h_, &ep);
+
+        const std::vector<const vec_t*> w = static_cast<const layer*>(this)->weights();
+        const vec_t no_bias;
+        Base::backend_->conv2d_qq(*w[0], params_.has_bias ? *w[1] : no_bias, in, ep, out);
+    }
+
     /**
      * return delta of previous layer (delta=\frac{dE}{da}, a=wx in fully-connected layer)
      * @param in_data      input vectors (same vectors as forward_propagation)
@@ -328,6 +362,7 @@ class quantized_convolutional_layer : public feedforward_layer<Activation> {
         params_.w_stride = w_stride;
         params_.h_stride = h_stride;
         params_.tbl      = tbl;
+        init();
     }
 
     void init() {
@@ -387,8 +422,8 @@ class quantized_convolutional_layer : public feedforward_layer<Activation> {
         cws.prev_out_padded_.resize(sample_count);
 
         if (params_.pad_type == padding::same) {
-            cws.prev_out_buf_.resize(sample_count, cws.prev_out_buf_[0]);
-            cws.prev_delta_padded_.resize(sample_count, cws.prev_delta_padded_[0]);
+            cws.prev_out_buf_.resize(sample_count, vec_t(params_.in_padded.size(), float_t(0)));
+            cws.prev_delta_padded_.resize(sample_count, vec_t(params_.in_padded.size(), float_t(0)));
         }
 
         for (serial_size_t sample = 0; sample < sample_count; ++sample) {
@@ -499,6 +534,9 @@ class quantized_convolutional_layer : public feedforward_layer<Activation> {
 
     /* Workers buffers */
     conv_layer_worker_specific_storage cws_;
+
+    /* Epilogue of the uint8 path, kept for its activation table */
+    core::kernels::quantized_epilogue epilogue_;
 };
 
 }  // namespace tiny_dnn
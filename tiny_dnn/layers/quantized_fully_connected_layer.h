@@ -98,6 +98,40 @@ public:
         }
     }
 
+    /**
+     * use fixed activation ranges (e.g. from quantization_calibrator)
+     * instead of computing them from every input
+     **/
+    void set_quantization_ranges(const core::quantization_ranges& ranges) {
+        params_.q_ranges_ = ranges;
+    }
+
+    const core::quantization_ranges& quantization_ranges() const {
+        return params_.q_ranges_;
+    }
+
+    bool quantized_input_range(float_t* min, float_t* max) const override {
+        if (!params_.q_ranges_.valid) return false;
+        *min = params_.q_ranges_.in_min;
+        *max = params_.q_ranges_.in_max;
+        return true;
+    }
+
+    bool can_forward_quantized() const override {
+        core::kernels::quantized_epilogue ep;
+        return Base::backend_type() == core::backend_t::internal &&
+               core::kernels::make_quantized_epilogue(this->h_, &ep);
+    }
+
+    void forward_quantized(const quantized_tensor& in, quantized_tensor& out) override {
+        core::kernels::quantized_epilogue& ep = epilogue_;
+        core::kernels::make_quantized_epilogue(this->h_, &ep);
+
+        const std::vector<const vec_t*> w = static_cast<const layer*>(this)->weights();
+        const vec_t no_bias;
+        Base::backend_->fully_qq(*w[0], params_.has_bias_ ? *w[1] : no_bias, in, ep, out);
+    }
+
     void back_propagation(const std::vector<tensor_t*>& in_data,
                           const std::vector<tensor_t*>& out_data,
                           std::vector<tensor_t*>&       out_grad,
@@ -109,6 +143,8 @@ public:
 
 protected:
     fully_params params_;
+    // kept for its activation table, see requantize_with_epilogue
+    core::kernels::quantized_epilogue epilogue_;
 
     void set_params(const serial_size_t in_size,
                     const serial_size_t out_size,
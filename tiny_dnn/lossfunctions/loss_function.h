@@ -208,10 +208,11 @@ inline void apply_cost_if_defined(std::vector<vec_t>& sample_gradient,
 }
 
 // gradient for a minibatch
+// t and t_cost point to y.size() samples each, t_cost may be nullptr
 template <typename E>
 std::vector<tensor_t> gradient(const std::vector<tensor_t>& y,
-                               const std::vector<tensor_t>& t,
-                               const std::vector<tensor_t>& t_cost) {
+                               const tensor_t* t,
+                               const tensor_t* t_cost) {
 
     const serial_size_t sample_count  = static_cast<serial_size_t>(y.size());
     const serial_size_t channel_count = static_cast<serial_size_t>(y[0].size());
@@ -219,19 +220,17 @@ std::vector<tensor_t> gradient(const std::vector<tensor_t>& y,
     std::vector<tensor_t> gradients(sample_count);
  
     CNN_UNREFERENCED_PARAMETER(channel_count);
-    assert(y.size() == t.size());
-    assert(t_cost.empty() || t_cost.size() == t.size());
 
     // @todo add parallelism
     for (serial_size_t sample = 0; sample < sample_count; ++sample) {
         assert(y[sample].size() == channel_count);
         assert(t[sample].size() == channel_count);
-        assert(t_cost.empty() || t_cost[sample].empty() ||
+        assert(!t_cost || t_cost[sample].empty() ||
                t_cost[sample].size() == channel_count);
 
         gradients[sample] = gradient<E>(y[sample], t[sample]);
 
-        if (sample < t_cost.size()) {
+        if (t_cost) {
             apply_cost_if_defined(gradients[sample], t_cost[sample]);
         }
     }
@@ -239,4 +238,14 @@ std::vector<tensor_t> gradient(const std::vector<tensor_t>& y,
     return gradients;
 }
 
+template <typename E>
+std::vector<tensor_t> gradient(const std::vector<tensor_t>& y,
+                               const std::vector<tensor_t>& t,
+                               const std::vector<tensor_t>& t_cost) {
+    assert(y.size() == t.size());
+    assert(t_cost.empty() || t_cost.size() == t.size());
+
+    return gradient<E>(y, t.data(), t_cost.empty() ? nullptr : t_cost.data());
+}
+
 } // namespace tiny_dnn
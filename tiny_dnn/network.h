@@ -33,11 +33,13 @@
 #include <map>
 #include <set>
 #include <limits>
+#include <numeric>
 #include <string>
 #include <vector>
 
 #include "tiny_dnn/nodes.h"
 #include "tiny_dnn/util/util.h"
+#include "tiny_dnn/util/batch_pipeline.h"
 #include "tiny_dnn/lossfunctions/loss_function.h"
 #include "tiny_dnn/activations/activation_function.h"
 
@@ -196,6 +198,33 @@ class network {
     **/
     std::vector<tensor_t> predict(const std::vector<tensor_t>& in) { return fprop(in); }
 
+    /**
+     * executes forward-propagation on caller-owned storage, without copying
+     * the inputs or the outputs.
+     *
+     * @param in batch of a single-input network, indexed [sample][feature].
+     *           it is swapped into the network during the call and handed
+     *           back unchanged.
+     * @return output of the network, indexed [sample][feature]. it refers to
+     *         the network's own storage and stays valid until the next call
+     *         of predict/fprop
+     *
+     * inference only: the network does not keep the inputs, so gradients
+     * can't be computed from this pass (backward throws nn_error).
+     **/
+    const tensor_t& predict_bound(tensor_t& in) {
+        return *net_.forward_bound({ &in })[0];
+    }
+
+    /**
+     * multi-input/output version of the above.
+     * in[i] holds the i-th input channel, indexed [sample][feature];
+     * the result is indexed [output channel] -> [sample][feature]
+     **/
+    std::vector<const tensor_t*> predict_bound(const std::vector<tensor_t*>& in) {
+        return net_.forward_bound(in);
+    }
+
     /**
      * executes forward-propagation and returns maximum output
      **/
@@ -329,6 +358,69 @@ class network {
                           reset_weights, n_threads, t_cost_tensor);
     }
 
+    /**
+     * trains the network for a fixed number of epochs on minibatches produced
+     * by a batch_source.
+     *
+     * batches are assembled by background workers (see batch_pipeline) while
+     * the network trains on the current one, so data loading, shuffling and
+     * augmentation overlap with computation, and the dataset does not have to
+     * be held in memory as a whole.
+     *
+     * @code
+     * tensor_batch_source src(data, out, 32, true);
+     * src.set_transform([](tensor_t& in, tensor_t& t) { ... });
+     *
+     * net.fit<mse>(opt, src, 10, on_batch, on_epoch);
+     * @endcode
+     *
+     * @param optimizer          optimizing algorithm for training
+     * @param source             producer of the minibatches
+     * @param epoch              number of training epochs
+     * @param on_batch_enumerate callback for each mini-batch enumerate
+     * @param on_epoch_enumerate callback for each epoch
+     * @param reset_weights      set true if reset current network weights
+     * @param prefetch_depth     number of batches prepared ahead of training
+     * @param n_workers          number of background threads calling source
+     **/
+    template <typename Error, typename Optimizer,
+              typename OnBatchEnumerate, typename OnEpochEnumerate>
+    bool fit(Optimizer&       optimizer,
+             batch_source&    source,
+             int              epoch,
+             OnBatchEnumerate on_batch_enumerate,
+             OnEpochEnumerate on_epoch_enumerate,
+             const bool       reset_weights = false,
+             size_t           prefetch_depth = 2,
+             size_t           n_workers = 1) {
+        set_netphase(net_phase::train);
+        net_.setup(reset_weights);
+
+        for (auto n : net_)
+            n->set_parallelize(true);
+        optimizer.reset();
+
+        batch_pipeline pipeline(source, epoch, prefetch_depth, n_workers);
+        minibatch batch;
+
+        for (int iter = 0; iter < epoch; iter++) {
+            for (size_t i = 0; i < pipeline.batches_per_epoch(); i++) {
+                pipeline.next(&batch);
+                if (batch.size() == 0 || batch.target.size() != batch.size()) {
+                    throw nn_error("batch_source produced an invalid minibatch");
+                }
+                check_target_cost_matrix(batch.target, batch.t_cost);
+                train_once<Error>(optimizer, &batch.in[0], &batch.target[0],
+                    static_cast<int>(batch.size()), CNN_TASK_SIZE,
+                    batch.t_cost.empty() ? nullptr : &batch.t_cost[0]);
+                on_batch_enumerate();
+            }
+            on_epoch_enumerate();
+        }
+        set_netphase(net_phase::test);
+        return true;
+    }
+
     /**
      * @param optimizer          optimizing algorithm for training
      * @param inputs             array of input data
@@ -383,68 +475,182 @@ class network {
         for (auto n : net_) {
             n->set_context(phase);
         }
+        if (phase == net_phase::train) {
+            net_.set_inference_only(false);
+            net_.set_quantized_execution(false);
+        }
+    }
+
+    /**
+     * switch to inference-only execution, which implies net_phase::test.
+     * forward passes then never allocate, resize or clear gradient buffers,
+     * and the ones allocated so far are released. intermediate activations
+     * share a small set of buffers planned on their live ranges (see
+     * memory_planner). switching the netphase back to train (e.g. by
+     * fit/train) restores normal execution.
+     *
+     * @return number of bytes of gradient and activation memory released
+     **/
+    size_t set_inference_only(bool inference_only = true) {
+        if (inference_only) set_netphase(net_phase::test);
+        return net_.set_inference_only(inference_only);
+    }
+
+    /**
+     * run consecutive quantized layers (quantized_convolutional_layer,
+     * quantized_fully_connected_layer) on uint8 activations, converting
+     * from/to float only where a run of such layers starts and ends.
+     * activations supported by the uint8 kernels are identity, relu and
+     * other elementwise functions (applied through a lookup table).
+     * implies net_phase::test; switching back to train disables it.
+     * sequential networks only, graph networks throw nn_not_implemented_error.
+     **/
+    void set_quantized_execution(bool enable = true) {
+        net_.set_quantized_execution(enable);
+        if (enable) set_netphase(net_phase::test);
+    }
+
+    /**
+     * lay out the weights of all layers in one contiguous, 64 byte aligned
+     * buffer. layers keep using their weight vectors, which become views into
+     * the buffer, so the whole model can be snapshotted, restored or averaged
+     * in one pass (see parameter_arena). call again after changing the
+     * network's structure or layer shapes.
+     **/
+    parameter_arena& pack_parameters() {
+        return net_.pack_parameters();
+    }
+
+    /**
+     * parameter buffer of the last pack_parameters (empty before)
+     **/
+    parameter_arena& parameters() { return net_.parameters(); }
+    const parameter_arena& parameters() const { return net_.parameters(); }
+
+    /**
+     * activation sharing plan of the inference-only mode
+     **/
+    const memory_planner& memory_plan() const {
+        return net_.memory_plan();
+    }
+
+    /**
+     * freeze the network into a static execution plan for batches of
+     * batch_size samples. predict/fit on such batches then run the layers'
+     * kernels back to back, without resolving connections or resizing
+     * buffers; other batch sizes keep working through the regular path.
+     *
+     *   net.set_inference_only();
+     *   net.compile(1);
+     *   for (auto& x : requests) net.predict(x);
+     **/
+    void compile(serial_size_t batch_size = 1) {
+        net_.compile(batch_size);
+    }
+
+    /**
+     * batch size passed to compile, 0 if the network isn't compiled
+     **/
+    serial_size_t compiled_batch_size() const {
+        return net_.compiled_batch_size();
     }
 
     /**
      * test and generate confusion-matrix for classification task
+     *
+     * @param batch_size number of samples forwarded through the network at once
      **/
-    result test(const std::vector<vec_t>& in, const std::vector<label_t>& t) {
-        result test_result;
+    result test(const std::vector<vec_t>& in, const std::vector<label_t>& t,
+                size_t batch_size = CNN_EVAL_BATCH_SIZE) {
         set_netphase(net_phase::test);
-        for (size_t i = 0; i < in.size(); i++) {
-            const label_t predicted = fprop_max_index(in[i]);
-            const label_t actual = t[i];
+        std::vector<result> partial(eval_slots(in.size()));
+
+        fprop_batched(in, batch_size, [&](size_t first, const tensor_t& out) {
+            for_i_slotted(true, out.size(), partial.size(), [&](int slot, int i) {
+                const label_t predicted = label_t(max_index(out[i]));
+                const label_t actual = t[first + i];
+
+                if (predicted == actual) partial[slot].num_success++;
+                partial[slot].num_total++;
+                partial[slot].confusion_matrix[predicted][actual]++;
+            });
+        });
 
-            if (predicted == actual) test_result.num_success++;
-            test_result.num_total++;
-            test_result.confusion_matrix[predicted][actual]++;
+        result test_result;
+        for (const result& r : partial) {
+            test_result.num_success += r.num_success;
+            test_result.num_total += r.num_total;
+            for (const auto& row : r.confusion_matrix) {
+                for (const auto& col : row.second) {
+                    test_result.confusion_matrix[row.first][col.first] += col.second;
+                }
+            }
         }
         return test_result;
     }
 
     /**
      * generate output for each input
+     *
+     * @param batch_size number of samples forwarded through the network at once
      **/
-    std::vector<vec_t> test(const std::vector<vec_t>& in) {
+    std::vector<vec_t> test(const std::vector<vec_t>& in,
+                            size_t batch_size = CNN_EVAL_BATCH_SIZE) {
         std::vector<vec_t> test_result(in.size());
         set_netphase(net_phase::test);
-        for (size_t i = 0; i < in.size(); i++) {
-            test_result[i] = predict(in[i]);
-        }
+        fprop_batched(in, batch_size, [&](size_t first, const tensor_t& out) {
+            for_i(out.size(), [&](int i) {
+                test_result[first + i] = out[i];
+            });
+        });
         return test_result;
     }
 
     /**
      * calculate loss value (the smaller, the better) for regression task
+     *
+     * @param batch_size number of samples forwarded through the network at once
      **/
     template <typename E>
     float_t get_loss(const std::vector<vec_t>& in,
-                     const std::vector<vec_t>& t) {
-        float_t sum_loss = float_t(0);
-
-        for (size_t i = 0; i < in.size(); i++) {
-            const vec_t predicted = predict(in[i]);
-            sum_loss += E::f(predicted, t[i]);
-        }
-        return sum_loss;
+                     const std::vector<vec_t>& t,
+                     size_t batch_size = CNN_EVAL_BATCH_SIZE) {
+        std::vector<float_t> partial(eval_slots(in.size()), float_t(0));
+
+        fprop_batched(in, batch_size, [&](size_t first, const tensor_t& out) {
+            for_i_slotted(true, out.size(), partial.size(), [&](int slot, int i) {
+                partial[slot] += E::f(out[i], t[first + i]);
+            });
+        });
+        return std::accumulate(partial.begin(), partial.end(), float_t(0));
     }
 
     /**
      * calculate loss value (the smaller, the better) for regression task
+     *
+     * @param batch_size number of samples forwarded through the network at once
      **/
     template <typename E, typename T>
-    float_t get_loss(const std::vector<T>& in, const std::vector<tensor_t>& t) {
-        float_t sum_loss = float_t(0);
+    float_t get_loss(const std::vector<T>& in, const std::vector<tensor_t>& t,
+                     size_t batch_size = CNN_EVAL_BATCH_SIZE) {
+        if (batch_size == 0) throw nn_error("batch size must be positive");
+
+        std::vector<float_t> partial(eval_slots(in.size()), float_t(0));
         std::vector<tensor_t> in_tensor;
         normalize_tensor(in, in_tensor);
 
-        for (size_t i = 0; i < in.size(); i++) {
-            const tensor_t predicted = predict(in_tensor[i]);
-            for (size_t j = 0; j < predicted.size(); j++) {
-                sum_loss += E::f(predicted[j], t[i][j]);
-            }
+        for (size_t first = 0; first < in.size(); first += batch_size) {
+            const size_t count = std::min(batch_size, in.size() - first);
+            const std::vector<tensor_t> out = net_.forward(
+                &in_tensor[first], static_cast<serial_size_t>(count));
+
+            for_i_slotted(true, count, partial.size(), [&](int slot, int i) {
+                for (size_t j = 0; j < out[i].size(); j++) {
+                    partial[slot] += E::f(out[i][j], t[first + i][j]);
+                }
+            });
         }
-        return sum_loss;
+        return std::accumulate(partial.begin(), partial.end(), float_t(0));
     }
 
     /**
@@ -478,21 +684,21 @@ class network {
             switch (mode) {
             case GRAD_CHECK_ALL:
                 for (int i = 0; i < static_cast<int>(w.size()); i++)
-                    if (!calc_delta<E>(in, v, w, dw, i, eps)) {
+                    if (!calc_delta<E>(current, in, v, w, dw, i, eps)) {
                         return false;
                     }
                 for (int i = 0; i < static_cast<int>(b.size()); i++)
-                    if (!calc_delta<E>(in, v, b, db, i, eps)) {
+                    if (!calc_delta<E>(current, in, v, b, db, i, eps)) {
                         return false;
                     }
                 break;
             case GRAD_CHECK_RANDOM:
                 for (int i = 0; i < 10; i++)
-                    if (!calc_delta<E>(in, v, w, dw, uniform_idx(w), eps)) {
+                    if (!calc_delta<E>(current, in, v, w, dw, uniform_idx(w), eps)) {
                         return false;
                     }
                 for (int i = 0; i < 10; i++)
-                    if (!calc_delta<E>(in, v, b, db, uniform_idx(b), eps)) {
+                    if (!calc_delta<E>(current, in, v, b, db, uniform_idx(b), eps)) {
                         return false;
                     }
                 break;
@@ -651,6 +857,26 @@ class network {
         }
     }
 
+    /**
+     * save the weights in a versioned, aligned binary format that
+     * map_weights can use in place.
+     **/
+    void save_weights_mappable(const std::string& filename) const {
+        net_.save_parameters(filename);
+    }
+
+    /**
+     * use the weights of a file written by save_weights_mappable without
+     * reading or copying them: the file is mapped into memory and the
+     * layers' weights become views into the mapped pages (see
+     * parameter_arena). pages are shared between processes mapping the
+     * same file and copied privately only when written, e.g. by training.
+     * the network architecture must match the one the file was saved from.
+     **/
+    void map_weights(const std::string& filename) {
+        net_.map_parameters(filename);
+    }
+
     /**
      * save the network architecture as json string
      **/
@@ -736,6 +962,35 @@ class network {
         return label_t(max_index(fprop(in)));
     }
 
+    /**
+     * forwards in through a single-input network, batch_size samples at a
+     * time, and calls f(index of the first sample, output) for each batch.
+     * the output is indexed [sample][feature] and refers to the network's
+     * own storage, so it is only valid inside f.
+     **/
+    template <typename OnBatch>
+    void fprop_batched(const std::vector<vec_t>& in, size_t batch_size,
+                       OnBatch f) {
+        if (batch_size == 0) throw nn_error("batch size must be positive");
+
+        tensor_t batch;
+        for (size_t first = 0; first < in.size(); first += batch_size) {
+            const size_t count = std::min(batch_size, in.size() - first);
+            // assign() reuses the storage of the previous batch
+            batch.assign(in.begin() + first, in.begin() + first + count);
+            for (const vec_t& v : batch) {
+                if (v.size() != (size_t)in_data_size())
+                    data_mismatch(**net_.begin(), v);
+            }
+            f(first, *net_.forward_bound({ &batch })[0]);
+        }
+    }
+
+    // number of partial results the evaluation reductions are split into
+    static size_t eval_slots(size_t sample_count) {
+        return std::max(size_t(1), std::min(size_t(CNN_TASK_SIZE), sample_count));
+    }
+
  private:
     template <typename Layer>
     friend network<sequential>& operator << (network<sequential>& n, Layer&& l);
@@ -821,13 +1076,10 @@ class network {
                         int             batch_size,
                         const int       num_tasks,
                         const tensor_t* t_cost) {
-        std::vector<tensor_t> in_batch(&in[0], &in[0] + batch_size);
-        std::vector<tensor_t> t_batch(&t[0], &t[0] + batch_size);
-        std::vector<tensor_t> t_cost_batch = t_cost
-            ? std::vector<tensor_t>(&t_cost[0], &t_cost[0] + batch_size)
-            : std::vector<tensor_t>();
-
-        bprop<E>(fprop(in_batch), t_batch, t_cost_batch);
+        // the minibatch is read in place from the training set
+        const std::vector<tensor_t> out =
+            net_.forward(in, static_cast<serial_size_t>(batch_size));
+        net_.backward(gradient<E>(out, t, t_cost));
         net_.update_weights(&optimizer, batch_size);
     }
 
@@ -860,7 +1112,8 @@ class network {
 //    }
 
     template <typename E>
-    bool calc_delta(const std::vector<tensor_t>& in,
+    bool calc_delta(layerptr_t owner,
+                    const std::vector<tensor_t>& in,
                     const std::vector<tensor_t>& v,
                     vec_t& w, tensor_t& dw, int check_index, double eps) {
         static const float_t delta = std::sqrt(
@@ -886,25 +1139,28 @@ class network {
 
         float_t f_p = float_t(0);
         w[check_index] = prev_w + delta;
+        owner->weights_modified();
         for (serial_size_t i = 0; i < sample_count; i++) {
             f_p += get_loss<E>(in[i], v[i]);
         }
 
         float_t f_m = float_t(0);
         w[check_index] = prev_w - delta;
+        owner->weights_modified();
         for (serial_size_t i = 0; i < sample_count; i++) {
             f_m += get_loss<E>(in[i], v[i]);
         }
 
         float_t delta_by_numerical = (f_p - f_m) / (float_t(2) * delta);
         w[check_index] = prev_w;
+        owner->weights_modified();
 
         // calculate dw/dE by bprop
         bprop<E>(fprop(in), v, std::vector<tensor_t>());
 
         float_t delta_by_bprop = 0;
-        for (serial_size_t sample = 0; sample < sample_count; ++sample) {
-            delta_by_bprop += dw[sample][check_index];
+        for (const vec_t& dw_slot : dw) {
+            delta_by_bprop += dw_slot[check_index];
         }
         net_.clear_grads();
 
@@ -91,6 +91,12 @@ public:
 
 /**
  * class containing input/output data
+ *
+ * data and gradients are stored as tensor_t, one separately allocated vec_t
+ * per sample (trainable weights: one vec_t). samples are not contiguous in
+ * memory: kernels which want a batch as one matrix pack it themselves.
+ * the per-sample buffers are kept across minibatches (see set_sample_count),
+ * so training and inference don't allocate them after warm-up.
  **/
 class edge {
  public:
@@ -99,22 +105,94 @@ class edge {
           vtype_(vtype),
           data_({vec_t(shape.size())}),
           grad_({vec_t(shape.size())}),
+          grad_stale_(false),
           prev_(prev) {}
 
+    /**
+     * sum up the gradient slots into dst.
+     * the parameter range is split into blocks reduced in parallel, each
+     * block reading all slots, so the slots themselves are left intact.
+     **/
     void merge_grads(vec_t *dst) {
-        dst->resize(grad_[0].size());
-        std::fill(dst->begin(), dst->end(), static_cast<float_t>(0));
-
-        // @todo consider adding parallelism
-		for (size_t sample = 0, sample_count = grad_.size(); sample < sample_count; ++sample) {
-			vectorize::reduce<float_t>(&grad_[sample][0], dst->size(), &(*dst)[0]);
-		}
+        const size_t size = grad_[0].size();
+        if (grad_stale_) {
+            dst->assign(size, float_t(0));
+            return;
+        }
+        dst->resize(size);
+
+        for_(size >= 4096, 0, size, [&](const blocked_range& r) {
+            const size_t n = r.end() - r.begin();
+            float_t* pdst = &(*dst)[r.begin()];
+            std::copy(&grad_[0][r.begin()], &grad_[0][r.begin()] + n, pdst);
+            for (size_t slot = 1, slot_count = grad_.size(); slot < slot_count; ++slot) {
+                vectorize::reduce<float_t>(&grad_[slot][r.begin()], n, pdst);
+            }
+        }, 1024);
     }
 
+    /**
+     * mark the gradients as zero. the zero-fill is deferred to the next
+     * mutable access (get_gradient) and then done as one parallel pass
+     * before the kernels accumulate into the buffers; gradients overwritten
+     * as a whole (overwrite_gradient) or never used again are not filled
+     * at all. merge_grads of cleared gradients yields zeros.
+     **/
     void clear_grads() {
-		for (size_t sample = 0, sample_count = grad_.size(); sample < sample_count; ++sample) {
-			std::fill(grad_[sample].begin(), grad_[sample].end(), (float_t)0);
-		}
+        grad_stale_ = true;
+    }
+
+    /**
+     * resize data/gradient so that they have room for sample_count samples.
+     *
+     * per-sample buffers dropped by a smaller batch are kept aside and handed
+     * back when the batch grows again, so alternating batch sizes (e.g. the
+     * last, partial minibatch of an epoch) never reallocate after warm-up.
+     *
+     * @param resize_data set false for trainable weights, which have only
+     *                    one data vector regardless of the batch size
+     * @param resize_grad set false in inference-only mode, gradients are
+     *                    then neither allocated nor resized
+     **/
+    void set_sample_count(serial_size_t sample_count,
+                          bool resize_data = true,
+                          bool resize_grad = true) {
+        if (resize_data) {
+            resize_samples(&data_, &spare_data_, sample_count);
+        }
+        if (resize_grad) {
+            resize_samples(&grad_, &spare_grad_, sample_count);
+        }
+    }
+
+    /**
+     * free the data storage, including spare buffers.
+     * the next set_sample_count with resize_data re-allocates it.
+     *
+     * @return number of bytes released
+     **/
+    size_t release_data() {
+        size_t bytes = 0;
+        for (const auto& v : data_) bytes += v.capacity() * sizeof(float_t);
+        for (const auto& v : spare_data_) bytes += v.capacity() * sizeof(float_t);
+        tensor_t().swap(data_);
+        tensor_t().swap(spare_data_);
+        return bytes;
+    }
+
+    /**
+     * free the gradient storage, including spare buffers.
+     * the next set_sample_count with resize_grad re-allocates it.
+     *
+     * @return number of bytes released
+     **/
+    size_t release_gradients() {
+        size_t bytes = 0;
+        for (const auto& v : grad_) bytes += v.capacity() * sizeof(float_t);
+        for (const auto& v : spare_grad_) bytes += v.capacity() * sizeof(float_t);
+        tensor_t().swap(grad_);
+        tensor_t().swap(spare_grad_);
+        return bytes;
     }
 
     tensor_t* get_data() {
@@ -126,10 +204,16 @@ class edge {
     }
 
     tensor_t* get_gradient() {
+        if (grad_stale_) zero_grads();
         return &grad_;
     }
 
-    const tensor_t* get_gradient() const {
+    /**
+     * gradient storage for a caller which assigns every sample, skipping
+     * the pending zero-fill of clear_grads
+     **/
+    tensor_t* overwrite_gradient() {
+        grad_stale_ = false;
         return &grad_;
     }
 
@@ -142,10 +226,42 @@ class edge {
     void add_next_node(node* next) { next_.push_back(next); }
 
  private:
+    // parallel across blocks of each sample, for weight gradients with
+    // many parameters and few (per-thread) slots
+    void zero_grads() {
+        for (vec_t& g : grad_) {
+            for_(g.size() >= 4096, 0, g.size(), [&](const blocked_range& r) {
+                std::fill(g.begin() + r.begin(), g.begin() + r.end(), float_t(0));
+            }, 1024);
+        }
+        grad_stale_ = false;
+    }
+
+    void resize_samples(tensor_t* samples, tensor_t* spare,
+                        serial_size_t sample_count) {
+        while (samples->size() > sample_count) {
+            spare->push_back(std::move(samples->back()));
+            samples->pop_back();
+        }
+        while (samples->size() < sample_count) {
+            if (!spare->empty()) {
+                samples->push_back(std::move(spare->back()));
+                spare->pop_back();
+            } else if (!samples->empty()) {
+                samples->push_back((*samples)[0]);
+            } else {
+                samples->push_back(vec_t(shape_.size()));
+            }
+        }
+    }
+
     shape3d shape_;
     vector_type vtype_;
     tensor_t data_;
     tensor_t grad_;
+    bool grad_stale_;          // cleared by clear_grads, not yet zero-filled
+    tensor_t spare_data_;      // buffers of samples beyond the current batch
+    tensor_t spare_grad_;
     node* prev_;               // previous node, "producer" of this tensor
     std::vector<node*> next_;  // next nodes, "consumers" of this tensor
 };
@@ -26,6 +26,7 @@
 */
 #pragma once
 
+#include <algorithm>
 #include <vector>
 #include <tuple>
 #include <unordered_map>
@@ -33,7 +34,11 @@
 #include <cereal/types/tuple.hpp>
 
 #include "tiny_dnn/util/util.h"
+#include "tiny_dnn/util/memory_planner.h"
+#include "tiny_dnn/util/parameter_arena.h"
+#include "tiny_dnn/io/weight_file.h"
 #include "tiny_dnn/layers/layer.h"
+#include "tiny_dnn/core/kernels/tiny_quantization_kernel.h"
 #include "tiny_dnn/optimizers/optimizer.h"
 
 namespace cereal {
@@ -90,28 +95,164 @@ class nodes {
     /**
      * propagate gradient
      * @param first        : gradient of cost function(dE/dy)
-     * @param worker_index : id of worker-task
+     *                       indexed [sample][output channel]
      **/
     virtual
-    void backward(const std::vector<tensor_t>& first) = 0;
+    void backward(const std::vector<tensor_t>& first) {
+        const std::vector<edgeptr_t> out = output_edges();
+
+        if (first.empty() || first[0].size() != out.size()) {
+            throw nn_error("input size mismatch");
+        }
+        if (inputs_handed_back_) {
+            throw nn_error("backward after forward_bound: the inputs of that "
+                           "forward were handed back to the caller");
+        }
+
+        const serial_size_t sample_count = static_cast<serial_size_t>(first.size());
+        scatter_samples(first.data(), sample_count, out, true);
+
+        if (use_plan(sample_count)) {
+            for (auto l = nodes_.rbegin(); l != nodes_.rend(); l++) {
+                (*l)->backward_compiled();
+            }
+            return;
+        }
+
+        for (auto l = nodes_.rbegin(); l != nodes_.rend(); l++) {
+            (*l)->backward();
+        }
+    }
 
     /**
-     * @param first input  : data vectors
-     * @param worker_index : id of worker-task
+     * @param first input  : data vectors, indexed [sample][input channel]
+     * @return outputs, indexed [sample][output channel]
      **/
     virtual
-    std::vector<tensor_t> forward(const std::vector<tensor_t>& first) = 0; // NOLINT
+    std::vector<tensor_t> forward(const std::vector<tensor_t>& first) { // NOLINT
+        return forward(first.data(), static_cast<serial_size_t>(first.size()));
+    }
+
+    /**
+     * same as above, taking the samples as a plain array so that callers
+     * holding a larger dataset don't have to copy a minibatch out first
+     **/
+    std::vector<tensor_t> forward(const tensor_t* first,
+                                  serial_size_t sample_count) {
+        const std::vector<edgeptr_t> in = input_edges();
+
+        if (sample_count == 0 || first[0].size() != in.size()) {
+            throw nn_error("input size mismatch");
+        }
+
+        scatter_samples(first, sample_count, in, false);
+
+        run_forward(sample_count);
+
+        return gather_samples(output_edges());
+    }
+
+    /**
+     * forward-propagation on caller-owned storage, without any copy.
+     *
+     * in[channel] holds one input channel for the whole batch, indexed
+     * [sample][feature] - the layout the layers work on. each tensor is
+     * swapped into the network for the duration of the call and handed back
+     * unchanged afterwards.
+     *
+     * @return output tensors indexed [output channel] -> [sample][feature].
+     *         they refer to the network's own storage and stay valid until
+     *         the next forward
+     *
+     * the network no longer holds the inputs afterwards, so this is for
+     * inference only: backward throws until the next forward.
+     **/
+    std::vector<const tensor_t*> forward_bound(const std::vector<tensor_t*>& in) {
+        const std::vector<edgeptr_t> edges = input_edges();
+
+        if (in.size() != edges.size() || in[0]->empty()) {
+            throw nn_error("input size mismatch");
+        }
+
+        const serial_size_t sample_count = static_cast<serial_size_t>(in[0]->size());
+
+        for (size_t channel = 0; channel < in.size(); channel++) {
+            const size_t dim = edges[channel]->shape().size();
+            if (in[channel]->size() != sample_count ||
+                std::any_of(in[channel]->begin(), in[channel]->end(),
+                            [&](const vec_t& v) { return v.size() != dim; })) {
+                throw nn_error("input size mismatch");
+            }
+        }
+
+        for (size_t channel = 0; channel < in.size(); channel++) {
+            edges[channel]->get_data()->swap(*in[channel]);
+        }
+
+        try {
+            run_forward(sample_count);
+        } catch (...) {
+            for (size_t channel = 0; channel < in.size(); channel++) {
+                edges[channel]->get_data()->swap(*in[channel]);
+            }
+            throw;
+        }
+
+        for (size_t channel = 0; channel < in.size(); channel++) {
+            edges[channel]->get_data()->swap(*in[channel]);
+        }
+        inputs_handed_back_ = true;
+
+        std::vector<const tensor_t*> out;
+        for (auto& e : output_edges()) {
+            out.push_back(e->get_data());
+        }
+        return out;
+    }
 
     /**
      * update weights and clear all gradients
      **/
     virtual
     void update_weights(optimizer *opt, int batch_size) {
+        // all parameters are handed over at once, so the optimizer can
+        // update them in a single sweep. it runs in parallel unless a layer
+        // holding parameters has parallelization turned off
+        params_.clear();
+        bool parallelize = true;
+        for (auto l : nodes_) {
+            const size_t count = params_.size();
+            l->trainable_parameters(&params_);
+            if (params_.size() != count) parallelize = parallelize && l->parallelize();
+        }
+        opt->update_parameters(params_, float_t(1) / float_t(batch_size), parallelize);
         for (auto l : nodes_) {
-            l->update_weight(opt, batch_size);
+            l->finish_update();
         }
     }
 
+    /**
+     * freeze the network into a static execution plan for batches of
+     * batch_size samples: the edges of every layer are resolved and all
+     * buffers are sized once, so that forward/backward of such batches
+     * only run the layers' kernels in order.
+     *
+     * batches of other sizes still run through the regular path; the plan
+     * is sized again on the next batch of batch_size samples. adding layers
+     * or switching inference-only mode also re-sizes it.
+     **/
+    void compile(serial_size_t batch_size) {
+        if (batch_size == 0) throw nn_error("batch size must be positive");
+        setup(false);
+        plan_batch_size_ = batch_size;
+        prepare_plan();
+    }
+
+    /**
+     * batch size of the execution plan, 0 if the network isn't compiled
+     **/
+    serial_size_t compiled_batch_size() const { return plan_batch_size_; }
+
     /**
      * setup all weights, must be called before forward/backward
      **/
@@ -127,6 +268,72 @@ class nodes {
         }
     }
 
+    /**
+     * switch all layers to/from inference-only mode, see
+     * layer::set_inference_only. in inference-only mode activations are
+     * additionally shared between layers according to a memory_planner
+     * built on the execution order.
+     *
+     * @return number of bytes released
+     **/
+    size_t set_inference_only(bool inference_only) {
+        size_t released = 0;
+        for (auto l : nodes_) {
+            released += l->set_inference_only(inference_only);
+        }
+        planner_.clear();
+        if (inference_only) {
+            released += planner_.plan(nodes_, output_nodes());
+        }
+        plan_stale_ = true;
+        return released;
+    }
+
+    const memory_planner& memory_plan() const { return planner_; }
+
+    /**
+     * move the weights of all layers into one contiguous buffer,
+     * in layer order. see parameter_arena.
+     **/
+    parameter_arena& pack_parameters() {
+        setup(false);
+        arena_.bind(weight_vectors());
+        arena_.set_on_modified(weights_modified_hook());
+        return arena_;
+    }
+
+    /**
+     * let the weights of all layers view the weights of a file written by
+     * save_weight_file, mapped into memory. the layers are neither set up
+     * nor initialized beforehand, their weights are taken from the file.
+     **/
+    parameter_arena& map_parameters(const std::string& path) {
+        map_weight_file(path, weight_vectors(), &arena_);
+        arena_.set_on_modified(weights_modified_hook());
+        for (auto l : nodes_) l->set_weights_loaded();
+        return arena_;
+    }
+
+    void save_parameters(const std::string& path) const {
+        std::vector<const vec_t*> params;
+        for (auto l : nodes_) {
+            for (auto w : static_cast<const layer*>(l)->weights()) params.push_back(w);
+        }
+        save_weight_file(path, params);
+    }
+
+    parameter_arena& parameters() { return arena_; }
+    const parameter_arena& parameters() const { return arena_; }
+
+    /**
+     * keep activations in uint8 between consecutive quantized layers,
+     * converting from/to float only around such runs. inference only,
+     * implemented by sequential networks; graph networks throw
+     * nn_not_implemented_error when it is enabled.
+     **/
+    virtual void set_quantized_execution(bool enable) { quantized_execution_ = enable; }
+    bool quantized_execution() const { return quantized_execution_; }
+
     size_t size() const { return nodes_.size(); }
     iterator begin() { return nodes_.begin(); }
     iterator end() { return nodes_.end(); }
@@ -218,36 +425,140 @@ class nodes {
  protected:
     template <typename T>
     void push_back(T&& node) {
+        plan_stale_ = true;
         push_back_impl(std::forward<T>(node),
                        typename std::is_rvalue_reference<decltype(node)>::type()); // NOLINT
     }
 
     template <typename T>
     void push_back(std::shared_ptr<T> node) {
+        plan_stale_ = true;
         own_nodes_.push_back(node);
         nodes_.push_back(own_nodes_.back().get());
     }
 
     // transform indexing so that it's more suitable for per-layer operations
     // input:  [sample][channel][feature]
-    // output: [channel][sample][feature]
-    std::vector<tensor_t> reorder_for_layerwise_processing(const std::vector<tensor_t>& input) {
-        const serial_size_t sample_count = static_cast<serial_size_t>(input.size());
-        const serial_size_t channel_count = static_cast<serial_size_t>(input[0].size());
-
-        // @todo we could perhaps pass pointers to underlying vec_t objects, in order to avoid copying
-        std::vector<tensor_t> output(channel_count, tensor_t(sample_count));
-
-        for (serial_size_t sample = 0; sample < sample_count; ++sample) {
-            assert(input[sample].size() == channel_count);
-            for (serial_size_t channel = 0; channel < channel_count; ++channel) {
-                output[channel][sample] = input[sample][channel];
+    // output: [channel][sample][feature], written into the edges' own
+    //         buffers so that nothing is allocated once they are warm
+    void scatter_samples(const tensor_t* input,
+                         serial_size_t sample_count,
+                         const std::vector<edgeptr_t>& edges,
+                         bool gradient) {
+        const serial_size_t channel_count = static_cast<serial_size_t>(edges.size());
+
+        for (serial_size_t channel = 0; channel < channel_count; ++channel) {
+            edge& e = *edges[channel];
+            e.set_sample_count(sample_count, !gradient, gradient);
+            tensor_t& dst = gradient ? *e.overwrite_gradient() : *e.get_data();
+
+            for (serial_size_t sample = 0; sample < sample_count; ++sample) {
+                assert(input[sample].size() == channel_count);
+                dst[sample] = input[sample][channel];
+            }
+        }
+    }
+
+    // normalize indexing back to [sample][channel][feature]
+    std::vector<tensor_t> gather_samples(const std::vector<edgeptr_t>& edges) const {
+        const serial_size_t channel_count = static_cast<serial_size_t>(edges.size());
+        const serial_size_t sample_count =
+            static_cast<serial_size_t>(edges[0]->get_data()->size());
+
+        std::vector<tensor_t> output(sample_count, tensor_t(channel_count));
+
+        for (serial_size_t channel = 0; channel < channel_count; ++channel) {
+            const tensor_t& src = *edges[channel]->get_data();
+            assert(src.size() == sample_count);
+            for (serial_size_t sample = 0; sample < sample_count; ++sample) {
+                output[sample][channel] = src[sample];
             }
         }
 
         return output;
     }
 
+    // first data input of each network input, in channel order
+    std::vector<edgeptr_t> input_edges() const {
+        std::vector<edgeptr_t> edges;
+        for (auto l : input_nodes()) {
+            const std::vector<vector_type> types = l->in_types();
+            const std::vector<edgeptr_t> in = l->inputs();
+            auto it = std::find(types.begin(), types.end(), vector_type::data);
+            if (it == types.end()) throw nn_error("input layer has no data input");
+            edges.push_back(in[std::distance(types.begin(), it)]);
+        }
+        return edges;
+    }
+
+    // first data output of each network output, in channel order
+    std::vector<edgeptr_t> output_edges() const {
+        std::vector<edgeptr_t> edges;
+        for (auto l : output_nodes()) {
+            const std::vector<vector_type> types = l->out_types();
+            const std::vector<edgeptr_t> out = l->outputs();
+            auto it = std::find(types.begin(), types.end(), vector_type::data);
+            if (it == types.end()) throw nn_error("output layer has no data output");
+            edges.push_back(out[std::distance(types.begin(), it)]);
+        }
+        return edges;
+    }
+
+    // run forward of all nodes in order, sharing activation storage if planned
+    virtual void forward_nodes(serial_size_t sample_count) {
+        for (size_t i = 0; i < nodes_.size(); i++) {
+            planner_.acquire(i, sample_count);
+            nodes_[i]->forward();
+            planner_.release(i);
+        }
+    }
+
+    // size the buffers of the execution plan, in execution order so that
+    // activations shared by the memory planner are only sized while live
+    void prepare_plan() {
+        for (size_t i = 0; i < nodes_.size(); i++) {
+            planner_.acquire(i, plan_batch_size_);
+            nodes_[i]->compile(plan_batch_size_);
+            planner_.release(i);
+        }
+        plan_stale_ = false;
+    }
+
+    // true if a batch of sample_count samples runs through the plan
+    bool use_plan(serial_size_t sample_count) {
+        if (plan_batch_size_ == 0 || quantized_execution_) return false;
+        if (sample_count != plan_batch_size_) {
+            // the regular path resizes the buffers
+            plan_stale_ = true;
+            return false;
+        }
+        if (plan_stale_) prepare_plan();
+        return true;
+    }
+
+    void run_forward(serial_size_t sample_count) {
+        inputs_handed_back_ = false;
+        if (!use_plan(sample_count)) {
+            forward_nodes(sample_count);
+            return;
+        }
+        for (size_t i = 0; i < nodes_.size(); i++) {
+            planner_.acquire(i, sample_count);
+            nodes_[i]->forward_compiled();
+            planner_.release(i);
+        }
+    }
+
+    // layers fed by forward
+    virtual std::vector<layerptr_t> input_nodes() const {
+        return { nodes_.front() };
+    }
+
+    // layers whose outputs are returned by forward
+    virtual std::vector<layerptr_t> output_nodes() const {
+        return { nodes_.back() };
+    }
+
     template <typename T>
     void push_back_impl(T&& node, std::true_type) {  // is_rvalue_reference
         own_nodes_.push_back(std::make_shared<
@@ -264,6 +575,37 @@ class nodes {
     std::vector<std::shared_ptr<layer>> own_nodes_;
     /* List of all nodes which includes own_nodes */
     std::vector<layerptr_t> nodes_;
+    /* Activation sharing in inference-only mode */
+    memory_planner planner_;
+    /* uint8 activations between quantized layers, see set_quantized_execution */
+    bool quantized_execution_ = false;
+    /* Batch size of the execution plan, 0 if not compiled, see compile */
+    serial_size_t plan_batch_size_ = 0;
+    /* Buffers no longer sized for the plan */
+    bool plan_stale_ = false;
+    /* Last forward was forward_bound, its inputs are gone */
+    bool inputs_handed_back_ = false;
+    // weights of all layers, in layer order
+    std::vector<vec_t*> weight_vectors() {
+        std::vector<vec_t*> params;
+        for (auto l : nodes_) {
+            for (auto w : l->weights()) params.push_back(w);
+        }
+        return params;
+    }
+
+    // invalidates the weight caches of all layers after bulk writes to the arena
+    std::function<void()> weights_modified_hook() const {
+        std::vector<layer*> layers(nodes_.begin(), nodes_.end());
+        return [layers]() {
+            for (auto l : layers) l->weights_modified();
+        };
+    }
+
+    /* contiguous weight storage, see pack_parameters */
+    parameter_arena arena_;
+    /* parameters handed to the optimizer, kept to reuse the storage */
+    std::vector<trainable_parameter> params_;
 };
 
 /**
@@ -271,34 +613,6 @@ class nodes {
  **/
 class sequential : public nodes {
  public:
-    void backward(const std::vector<tensor_t>& first) override {
-
-        const std::vector<tensor_t> reordered_grad = reorder_for_layerwise_processing(first);
-        assert(reordered_grad.size() == 1);
-
-        nodes_.back()->set_out_grads({ reordered_grad[0] });
-
-        for (auto l = nodes_.rbegin(); l != nodes_.rend(); l++) {
-            (*l)->backward();
-        }
-    }
-
-    std::vector<tensor_t> forward(const std::vector<tensor_t>& first) override {
-
-        const std::vector<tensor_t> reordered_data = reorder_for_layerwise_processing(first);
-        assert(reordered_data.size() == 1);
-
-        nodes_.front()->set_in_data({ reordered_data[0] });
-
-        for (auto l : nodes_) {
-            l->forward();
-        }
-
-        const std::vector<tensor_t> out = nodes_.back()->output();
-
-        return normalize_out(out);
-    }
-
     template <typename T>
     void add(T&& layer) {
         push_back(std::forward<T>(layer));
@@ -336,23 +650,61 @@ class sequential : public nodes {
     template <typename OutputArchive>
     void save_connections(OutputArchive& ) const { }
 
+protected:
+    // with quantized execution, consecutive layers supporting
+    // layer::forward_quantized pass uint8 activations to each other
+    // and only the last one of such a run writes its output edge
+    void forward_nodes(serial_size_t sample_count) override {
+        if (!quantized_execution_) {
+            nodes::forward_nodes(sample_count);
+            return;
+        }
+
+        bool quantized = false;  // current activations are in q_in_
+        for (size_t i = 0; i < nodes_.size(); i++) {
+            layerptr_t l = nodes_[i];
+            planner_.acquire(i, sample_count);
+
+            if (l->can_forward_quantized()) {
+                if (!quantized) {
+                    const tensor_t& in = *l->inputs()[0]->get_data();
+                    float_t min_in, max_in;
+                    const bool fixed = l->quantized_input_range(&min_in, &max_in);
+                    q_in_.resize(in.size());
+                    for (size_t s = 0; s < in.size(); s++) {
+                        if (fixed) {
+                            core::kernels::float_vec_to_quantized(in[s], min_in, max_in, &q_in_[s]);
+                        } else {
+                            core::kernels::float_vec_to_quantized(in[s], &q_in_[s]);
+                        }
+                    }
+                    quantized = true;
+                }
+                l->forward_quantized(q_in_, q_out_);
+                std::swap(q_in_, q_out_);
+
+                const bool next_quantized = i + 1 < nodes_.size() &&
+                                            nodes_[i + 1]->can_forward_quantized();
+                if (!next_quantized) {
+                    l->set_sample_count(sample_count);
+                    tensor_t& out = *l->outputs()[0]->get_data();
+                    for (size_t s = 0; s < q_in_.size(); s++) {
+                        core::kernels::quantized_vec_to_float(q_in_[s], &out[s]);
+                    }
+                    quantized = false;
+                }
+            } else {
+                l->forward();
+            }
+            planner_.release(i);
+        }
+    }
+
 private:
     friend class nodes;
 
-    std::vector<tensor_t> normalize_out(const std::vector<tensor_t>& out)
-    {
-        // normalize indexing back to [sample][layer][feature]
-        std::vector<tensor_t> normalized_output;
-
-        const size_t sample_count = out[0].size();
-        normalized_output.resize(sample_count, tensor_t(1));
-
-        for (size_t sample = 0; sample < sample_count; ++sample) {
-            normalized_output[sample][0] = out[0][sample];
-        }
-
-        return normalized_output;
-    }
+    quantized_tensor q_in_;
+    quantized_tensor q_out_;
 };
 
 /**
@@ -361,45 +713,11 @@ private:
  **/
 class graph : public nodes {
  public:
-    void backward(const std::vector<tensor_t>& out_grad) override {
-
-        serial_size_t output_channel_count = static_cast<serial_size_t>(out_grad[0].size());
-
-        if (output_channel_count != output_layers_.size()) {
-            throw nn_error("input size mismatch");
-        }
-
-        const std::vector<tensor_t> reordered_grad = reorder_for_layerwise_processing(out_grad);
-        assert(reordered_grad.size() == output_channel_count);
-
-        for (serial_size_t i = 0; i < output_channel_count; i++) {
-            output_layers_[i]->set_out_grads({ reordered_grad[i] });
-        }
-
-        for (auto l = nodes_.rbegin(); l != nodes_.rend(); l++) {
-            (*l)->backward();
+    void set_quantized_execution(bool enable) override {
+        if (enable) {
+            throw nn_not_implemented_error("quantized execution is not implemented for graph networks");
         }
-    }
-
-    std::vector<tensor_t> forward(const std::vector<tensor_t>& in_data) override {
-
-        serial_size_t input_data_channel_count = static_cast<serial_size_t>(in_data[0].size());
-
-        if (input_data_channel_count != input_layers_.size()) {
-            throw nn_error("input size mismatch");
-        }
-
-        const std::vector<tensor_t> reordered_data = reorder_for_layerwise_processing(in_data);
-        assert(reordered_data.size() == input_data_channel_count);
-
-        for (serial_size_t channel_index = 0; channel_index < input_data_channel_count; channel_index++) {
-            input_layers_[channel_index]->set_in_data({ reordered_data[channel_index] });
-        }
-
-        for (auto l : nodes_) {
-            l->forward();
-        }
-        return merge_outs();
+        nodes::set_quantized_execution(false);
     }
 
     void construct(const std::vector<layerptr_t>& input,
@@ -437,6 +755,7 @@ class graph : public nodes {
         for (auto& n : sorted) {
             nodes_.push_back(n);
         }
+        plan_stale_ = true;
 
         input_layers_ = input;
         output_layers_ = output;
@@ -444,6 +763,15 @@ class graph : public nodes {
         setup(false);
     }
 
+protected:
+    std::vector<layerptr_t> input_nodes() const override {
+        return input_layers_;
+    }
+
+    std::vector<layerptr_t> output_nodes() const override {
+        return output_layers_;
+    }
+
 private:
     friend class nodes;
 
@@ -518,28 +846,6 @@ private:
         }
     }
 
-     // normalize indexing back to [sample][layer][feature]
-     std::vector<tensor_t> merge_outs() {
-         std::vector<tensor_t> merged;
-         serial_size_t output_channel_count = static_cast<serial_size_t>(output_layers_.size());
-         for (serial_size_t output_channel = 0; output_channel < output_channel_count; ++output_channel) {
-             std::vector<tensor_t> out = output_layers_[output_channel]->output();
-
-             serial_size_t sample_count = static_cast<serial_size_t>(out[0].size());
-             if (output_channel == 0) {
-                 assert(merged.empty());
-                 merged.resize(sample_count, tensor_t(output_channel_count));
-             }
-
-             assert(merged.size() == sample_count);
-
-             for (serial_size_t sample = 0; sample < sample_count; ++sample) {
-                 merged[sample][output_channel] = out[0][sample];
-             }
-         }
-         return merged;
-     }
-
     serial_size_t find_index(const std::vector<node*>& nodes,
                           layerptr_t target) {
         for (serial_size_t i = 0; i < nodes.size(); i++) {
@@ -569,6 +875,7 @@ template <typename InputArchive>
 void nodes::load_model(InputArchive & ia) {
     own_nodes_.clear();
     nodes_.clear();
+    plan_stale_ = true;
 
     ia(cereal::make_nvp("nodes", own_nodes_));
 
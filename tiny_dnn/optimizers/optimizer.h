@@ -26,10 +26,24 @@
 */
 #pragma once
 #include "tiny_dnn/util/util.h"
+#include "tiny_dnn/util/product.h"
+#include <array>
 #include <unordered_map>
 
 namespace tiny_dnn {
 
+/**
+ * trainable parameter handed to optimizer::update_parameters:
+ * the weights and their gradient, split into per-thread slots
+ * which are summed up by the update.
+ **/
+struct trainable_parameter {
+    trainable_parameter(vec_t* w, const tensor_t* g) : weight(w), grads(g) {}
+
+    vec_t*          weight;
+    const tensor_t* grads;
+};
+
 /**
  * base class of optimizer
  * usesHessian : true if an optimizer uses hessian (2nd order derivative of loss function)
@@ -47,24 +61,171 @@ struct optimizer {
     virtual ~optimizer() = default;
     virtual void update(const vec_t& dW, vec_t &W, bool parallelize) = 0;
     virtual void reset() {} // override to implement pre-learning action
+
+    /**
+     * update all parameters of a network with their gradients scaled by
+     * `scale` (1/batch_size). called once per minibatch.
+     *
+     * this default merges and scales each gradient into a temporary and
+     * calls update(); the built-in optimizers override it with a fused kernel.
+     **/
+    virtual void update_parameters(const std::vector<trainable_parameter>& params,
+                                   float_t scale, bool parallelize) {
+        for (const auto& p : params) {
+            const tensor_t& grads = *p.grads;
+            diff_ = grads[0];
+            for (size_t slot = 1; slot < grads.size(); slot++) {
+                vectorize::reduce<float_t>(&grads[slot][0], diff_.size(), &diff_[0]);
+            }
+            for (auto& d : diff_) d *= scale;
+            // parallelize only when target size is big enough to mitigate
+            // thread spawning overhead.
+            update(diff_, *p.weight, parallelize && p.weight->size() >= 512);
+        }
+    }
+
+private:
+    vec_t diff_;
 };
 
-// helper class to hold N values for each weight
+/**
+ * helper class to hold N values for each weight, and base class of the
+ * built-in optimizers.
+ *
+ * the values of all weights live in N flat arenas; each weight owns a range
+ * at a fixed offset, assigned the first time it is updated. derived classes
+ * only implement update_block, which is applied to ranges of at most
+ * block_size elements in parallel.
+ **/
 template <int N>
 struct stateful_optimizer : public optimizer {
+    enum { block_size = 1024 };
+
     void reset() override {
-        for (auto& e : E_) e.clear();
+        for (auto& e : E_) vec_t().swap(e);
+        keys_.clear();
+        sizes_.clear();
+        offsets_.clear();
+        index_.clear();
+        param_index_.clear();
+        arena_size_ = 0;
+    }
+
+    void update(const vec_t& dW, vec_t& W, bool parallelize) override {
+        begin_update();
+        const size_t offset = offsets_[index_of(W)];
+        for_(parallelize, 0, W.size(), [&](const blocked_range& r) {
+            const size_t end = static_cast<size_t>(r.end());
+            for (size_t b = static_cast<size_t>(r.begin()); b < end; b += block_size) {
+                update_range(&dW[b], float_t(1), &W[b], offset + b,
+                             std::min<size_t>(block_size, end - b));
+            }
+        }, block_size);
+    }
+
+    /**
+     * merge, scale and apply the gradients of all parameters in one
+     * parallel sweep over blocks of block_size elements.
+     **/
+    void update_parameters(const std::vector<trainable_parameter>& params,
+                           float_t scale, bool parallelize) override {
+        begin_update();
+        layout(params);
+
+        blocks_.clear();
+        for (size_t p = 0; p < params.size(); p++) {
+            const size_t size = params[p].weight->size();
+            for (size_t b = 0; b < size; b += block_size) {
+                blocks_.push_back({ p, b, std::min<size_t>(size, b + block_size) });
+            }
+        }
+
+        for_i(parallelize && blocks_.size() > 1, blocks_.size(), [&](int i) {
+            const block& blk = blocks_[i];
+            const tensor_t& grads = *params[blk.param].grads;
+            const size_t n = blk.end - blk.begin;
+            const float_t* dW = &grads[0][blk.begin];
+
+            if (grads.size() > 1) {
+                static thread_local vec_t merged;
+                merged.resize(block_size);
+                std::copy(dW, dW + n, merged.begin());
+                for (size_t slot = 1; slot < grads.size(); slot++) {
+                    vectorize::reduce<float_t>(&grads[slot][blk.begin], n, &merged[0]);
+                }
+                dW = &merged[0];
+            }
+            update_range(dW, scale, &(*params[blk.param].weight)[blk.begin],
+                         offsets_[param_index_[blk.param]] + blk.begin, n);
+        }, 1);
     }
 
 protected:
-    template <int Index>
-    vec_t& get(const vec_t& key) {
-        static_assert(Index < N, "index out of range");
-        if (E_[Index][&key].empty())
-            E_[Index][&key].resize(key.size(), float_t());
-        return E_[Index][&key];
+    /**
+     * W[i] -= f(scale * dW[i], state[k][i]) for i in [0, n),
+     * state[k] pointing at the matching range of the k-th arena.
+     **/
+    virtual void update_block(const float_t* dW, float_t scale, float_t* W,
+                              const std::array<float_t*, N>& state, size_t n) = 0;
+
+    // called once before each update/update_parameters
+    virtual void begin_update() {}
+
+private:
+    struct block {
+        size_t param;
+        size_t begin;
+        size_t end;
+    };
+
+    void update_range(const float_t* dW, float_t scale, float_t* W,
+                      size_t offset, size_t n) {
+        std::array<float_t*, N> state;
+        for (size_t k = 0; k < N; k++) state[k] = E_[k].data() + offset;
+        update_block(dW, scale, W, state, n);
     }
-    std::unordered_map<const vec_t*, vec_t> E_[N];
+
+    // map params to arena ranges. re-checks pointers and sizes only,
+    // the hash lookup runs when the parameter set changes.
+    void layout(const std::vector<trainable_parameter>& params) {
+        bool same = param_index_.size() == params.size();
+        for (size_t p = 0; same && p < params.size(); p++) {
+            const size_t idx = param_index_[p];
+            same = keys_[idx] == params[p].weight &&
+                   sizes_[idx] == params[p].weight->size();
+        }
+        if (same) return;
+
+        param_index_.resize(params.size());
+        for (size_t p = 0; p < params.size(); p++) {
+            param_index_[p] = index_of(*params[p].weight);
+        }
+    }
+
+    size_t index_of(const vec_t& key) {
+        auto it = index_.find(&key);
+        if (it != index_.end() && sizes_[it->second] == key.size()) {
+            return it->second;
+        }
+        // new (or resized) weight: append a zero-initialized range
+        const size_t idx = keys_.size();
+        keys_.push_back(&key);
+        sizes_.push_back(key.size());
+        offsets_.push_back(arena_size_);
+        arena_size_ += key.size();
+        for (auto& e : E_) e.resize(arena_size_, float_t(0));
+        index_[&key] = idx;
+        return idx;
+    }
+
+    std::array<vec_t, N> E_;
+    size_t arena_size_ = 0;
+    std::vector<const vec_t*> keys_;
+    std::vector<size_t> sizes_;
+    std::vector<size_t> offsets_;
+    std::unordered_map<const vec_t*, size_t> index_;
+    std::vector<size_t> param_index_;  // arena entry of each parameter of the last update
+    std::vector<block> blocks_;
 };
 
 /**
@@ -77,15 +238,26 @@ protected:
 struct adagrad : public stateful_optimizer<1> {
     adagrad() : alpha(float_t(0.01)), eps(float_t(1e-8)) {}
 
-    void update(const vec_t& dW, vec_t &W, bool parallelize) {
-        vec_t& g = get<0>(W);
-        for_i(parallelize, static_cast<int>(W.size()), [&](int i) {
-            g[i] += dW[i] * dW[i];
-            W[i] -= alpha * dW[i] / (std::sqrt(g[i]) + eps);
-        });
-    }
-
     float_t alpha; // learning rate
+protected:
+    struct kernel {
+        const float_t* dW; float_t* W; float_t* g;
+        float_t scale, alpha, eps;
+
+        template <typename V>
+        void operator()(V, size_t i) const {
+            auto d  = V::mul(V::loadu(dW + i), V::set1(scale));
+            auto gi = V::add(V::loadu(g + i), V::mul(d, d));
+            V::storeu(g + i, gi);
+            V::storeu(W + i, V::sub(V::loadu(W + i),
+                V::div(V::mul(V::set1(alpha), d), V::add(V::sqrt(gi), V::set1(eps)))));
+        }
+    };
+
+    void update_block(const float_t* dW, float_t scale, float_t* W,
+                      const std::array<float_t*, 1>& state, size_t n) override {
+        vectorize::elementwise<float_t>(n, kernel{ dW, W, state[0], scale, alpha, eps });
+    }
 private:
     float_t eps;
 };
@@ -99,18 +271,28 @@ private:
 struct RMSprop : public stateful_optimizer<1> {
     RMSprop() : alpha(float_t(0.0001)), mu(float_t(0.99)), eps(float_t(1e-8)) {}
 
-    void update(const vec_t& dW, vec_t& W, bool parallelize) {
-        vec_t& g = get<0>(W);
-
-        for_i(parallelize, static_cast<int>(W.size()), [&](int i)
-        {
-            g[i] = mu * g[i] + (1 - mu) * dW[i] * dW[i];
-            W[i] -= alpha * dW[i] / std::sqrt(g[i] + eps);
-        });
-    }
-
     float_t alpha; // learning rate
     float_t mu; // decay term
+protected:
+    struct kernel {
+        const float_t* dW; float_t* W; float_t* g;
+        float_t scale, alpha, mu, eps;
+
+        template <typename V>
+        void operator()(V, size_t i) const {
+            auto d  = V::mul(V::loadu(dW + i), V::set1(scale));
+            auto gi = V::add(V::mul(V::set1(mu), V::loadu(g + i)),
+                             V::mul(V::set1(float_t(1) - mu), V::mul(d, d)));
+            V::storeu(g + i, gi);
+            V::storeu(W + i, V::sub(V::loadu(W + i),
+                V::div(V::mul(V::set1(alpha), d), V::sqrt(V::add(gi, V::set1(eps))))));
+        }
+    };
+
+    void update_block(const float_t* dW, float_t scale, float_t* W,
+                      const std::array<float_t*, 1>& state, size_t n) override {
+        vectorize::elementwise<float_t>(n, kernel{ dW, W, state[0], scale, alpha, mu, eps });
+    }
 private:
     float_t eps; // constant value to avoid zero-division
 };
@@ -125,25 +307,41 @@ private:
 struct adam : public stateful_optimizer<2> {
     adam() : alpha(float_t(0.001)), b1(float_t(0.9)), b2(float_t(0.999)), b1_t(float_t(0.9)), b2_t(float_t(0.999)), eps(float_t(1e-8)) {}
 
-    void update(const vec_t& dW, vec_t& W, bool parallelize) {
-        vec_t& mt = get<0>(W);
-        vec_t& vt = get<1>(W);
-
-        b1_t*=b1;b2_t*=b2;
-
-        for_i(parallelize, static_cast<int>(W.size()), [&](int i){
-            mt[i] = b1 * mt[i] + (float_t(1) - b1) * dW[i];
-            vt[i] = b2 * vt[i] + (float_t(1) - b2) * dW[i] * dW[i];
-
-            W[i] -= alpha * ( mt[i]/(float_t(1) -b1_t) ) / std::sqrt( (vt[i]/(float_t(1)-b2_t)) + eps);
-        });
-    }
-
     float_t alpha; // learning rate
     float_t b1; // decay term
     float_t b2; // decay term
     float_t b1_t; // decay term power t
     float_t b2_t; // decay term power t   
+protected:
+    struct kernel {
+        const float_t* dW; float_t* W; float_t* mt; float_t* vt;
+        float_t scale, alpha, b1, b2, rcp_b1_t, rcp_b2_t, eps;
+
+        template <typename V>
+        void operator()(V, size_t i) const {
+            auto d  = V::mul(V::loadu(dW + i), V::set1(scale));
+            auto m  = V::add(V::mul(V::set1(b1), V::loadu(mt + i)),
+                             V::mul(V::set1(float_t(1) - b1), d));
+            auto v  = V::add(V::mul(V::set1(b2), V::loadu(vt + i)),
+                             V::mul(V::set1(float_t(1) - b2), V::mul(d, d)));
+            V::storeu(mt + i, m);
+            V::storeu(vt + i, v);
+            V::storeu(W + i, V::sub(V::loadu(W + i),
+                V::div(V::mul(V::set1(alpha * rcp_b1_t), m),
+                       V::sqrt(V::add(V::mul(v, V::set1(rcp_b2_t)), V::set1(eps))))));
+        }
+    };
+
+    // one step of the bias correction per update
+    void begin_update() override {
+        b1_t *= b1; b2_t *= b2;
+    }
+
+    void update_block(const float_t* dW, float_t scale, float_t* W,
+                      const std::array<float_t*, 2>& state, size_t n) override {
+        vectorize::elementwise<float_t>(n, kernel{ dW, W, state[0], state[1], scale, alpha, b1, b2,
+            float_t(1) / (float_t(1) - b1_t), float_t(1) / (float_t(1) - b2_t), eps });
+    }
 private:
     float_t eps; // constant value to avoid zero-division
 };
@@ -155,17 +353,28 @@ private:
  *
  * slightly faster than tiny_dnn::momentum
  **/
-struct gradient_descent : public optimizer {
+struct gradient_descent : public stateful_optimizer<0> {
     gradient_descent() : alpha(float_t(0.01)), lambda(float_t(0)) {}
 
-    void update(const vec_t& dW, vec_t& W, bool parallelize) {
-        for_i(parallelize, static_cast<int>(W.size()), [&](int i){
-            W[i] = W[i] - alpha * (dW[i] + lambda * W[i]);
-        });
-    }
-
     float_t alpha; // learning rate
     float_t lambda; // weight decay
+protected:
+    struct kernel {
+        const float_t* dW; float_t* W;
+        float_t scale, alpha, lambda;
+
+        template <typename V>
+        void operator()(V, size_t i) const {
+            auto w = V::loadu(W + i);
+            auto d = V::add(V::mul(V::loadu(dW + i), V::set1(scale)), V::mul(V::set1(lambda), w));
+            V::storeu(W + i, V::sub(w, V::mul(V::set1(alpha), d)));
+        }
+    };
+
+    void update_block(const float_t* dW, float_t scale, float_t* W,
+                      const std::array<float_t*, 0>&, size_t n) override {
+        vectorize::elementwise<float_t>(n, kernel{ dW, W, scale, alpha, lambda });
+    }
 };
 
 /**
@@ -179,19 +388,28 @@ struct momentum : public stateful_optimizer<1> {
 public:
     momentum() : alpha(float_t(0.01)), lambda(float_t(0)), mu(float_t(0.9)) {}
 
-    void update(const vec_t& dW, vec_t& W, bool parallelize) {
-        vec_t& dWprev = get<0>(W);
-
-        for_i(parallelize, static_cast<int>(W.size()), [&](int i){
-            float_t V = mu * dWprev[i] - alpha * (dW[i] + W[i] * lambda);
-            W[i]      += V;
-            dWprev[i] =  V;
-        });
-    }
-
     float_t alpha; // learning rate
     float_t lambda; // weight decay
     float_t mu; // momentum
+protected:
+    struct kernel {
+        const float_t* dW; float_t* W; float_t* dWprev;
+        float_t scale, alpha, lambda, mu;
+
+        template <typename V>
+        void operator()(V, size_t i) const {
+            auto w = V::loadu(W + i);
+            auto d = V::add(V::mul(V::loadu(dW + i), V::set1(scale)), V::mul(V::set1(lambda), w));
+            auto v = V::sub(V::mul(V::set1(mu), V::loadu(dWprev + i)), V::mul(V::set1(alpha), d));
+            V::storeu(W + i, V::add(w, v));
+            V::storeu(dWprev + i, v);
+        }
+    };
+
+    void update_block(const float_t* dW, float_t scale, float_t* W,
+                      const std::array<float_t*, 1>& state, size_t n) override {
+        vectorize::elementwise<float_t>(n, kernel{ dW, W, state[0], scale, alpha, lambda, mu });
+    }
 };
 
 } // namespace tiny_dnn
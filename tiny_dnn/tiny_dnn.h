@@ -72,6 +72,10 @@
 #include "tiny_dnn/io/layer_factory.h"
 #include "tiny_dnn/util/serialization_helper.h"
 #include "tiny_dnn/util/deserialization_helper.h"
+#ifndef CNN_NO_SERIALIZATION
+// layers are cloned through the serializer
+#include "tiny_dnn/util/quantization_calibrator.h"
+#endif
 
 #ifdef CNN_USE_CAFFE_CONVERTER
 // experimental / require google protobuf
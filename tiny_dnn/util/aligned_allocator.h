@@ -33,9 +33,17 @@
 #include <mm_malloc.h>
 #endif
 #include "nn_error.h"
+#include "memory_region.h"
 
 namespace tiny_dnn {
 
+/**
+ * allocator returning memory aligned to `alignment` bytes.
+ *
+ * vectors allocated inside a detail::region_placement live in a
+ * preallocated region instead (see parameter_arena); freeing memory costs
+ * a lock-free range check once such a region exists.
+ **/
 template <typename T, std::size_t alignment>
 class aligned_allocator {
 public:
@@ -66,6 +74,8 @@ public:
     }
 
     pointer allocate(size_type size, const void* = nullptr) {
+        if (void* r = detail::region_placement::take(sizeof(T) * size))
+            return static_cast<pointer>(r);
         void* p = aligned_alloc(alignment, sizeof(T) * size);
         if (!p && size > 0)
             throw nn_error("failed to allocate");
@@ -77,7 +87,8 @@ public:
     }
 
     void deallocate(pointer ptr, size_type) {
-        aligned_free(ptr);
+        if (!detail::memory_regions::instance().detach(ptr))
+            aligned_free(ptr);
     }
 
     template<class U, class V>
@@ -102,6 +113,10 @@ public:
         ::new(p) U();
     }
 
+    // elements of a vector built over a region keep its contents
+    template<class U>
+    void construct(U*, const detail::keep_contents&) {}
+
     template<class U>
     void destroy(U* ptr) {
         ptr->~U();
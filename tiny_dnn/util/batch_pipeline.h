@@ -0,0 +1,328 @@
+/*
+    Copyright (c) 2016, Taiga Nomi
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "tiny_dnn/util/util.h"
+
+namespace tiny_dnn {
+
+/**
+ * one minibatch as consumed by network::fit.
+ * all tensors are indexed [sample][channel].
+ **/
+struct minibatch {
+    std::vector<tensor_t> in;
+    std::vector<tensor_t> target;
+    std::vector<tensor_t> t_cost;  // empty, or one entry per sample
+
+    size_t size() const { return in.size(); }
+};
+
+/**
+ * producer of training minibatches.
+ *
+ * make_batch is called from the background workers of batch_pipeline, for
+ * distinct indices concurrently, and must therefore be thread-safe. buffers
+ * of a batch handed back by the consumer are passed in again, so an
+ * implementation which assigns into them instead of re-creating them does
+ * not allocate after warm-up.
+ **/
+class batch_source {
+ public:
+    virtual ~batch_source() {}
+
+    /**
+     * number of minibatches per epoch
+     **/
+    virtual size_t batch_count() const = 0;
+
+    /**
+     * called once before the first batch of each epoch is requested.
+     * no make_batch call is in flight at that time, so this is the place
+     * to e.g. reshuffle the dataset.
+     **/
+    virtual void begin_epoch(int epoch) {
+        CNN_UNREFERENCED_PARAMETER(epoch);
+    }
+
+    /**
+     * assemble the index-th minibatch of the current epoch into *batch
+     **/
+    virtual void make_batch(size_t index, minibatch* batch) = 0;
+};
+
+/**
+ * batch_source over an in-memory dataset, with optional per-epoch
+ * shuffling and a per-sample transform (e.g. augmentation) applied to
+ * the copies while they are assembled.
+ **/
+class tensor_batch_source : public batch_source {
+ public:
+    /**
+     * transform(in, target) is called on the copy of each sample, from
+     * worker threads
+     **/
+    typedef std::function<void(tensor_t&, tensor_t&)> transform_t;
+
+    tensor_batch_source(const std::vector<tensor_t>& inputs,
+                        const std::vector<tensor_t>& targets,
+                        size_t batch_size,
+                        bool shuffle = false,
+                        unsigned int seed = 0)
+        : inputs_(inputs), targets_(targets), batch_size_(batch_size),
+          shuffle_(shuffle), seed_(seed), order_(inputs.size()) {
+        if (inputs.size() != targets.size() || batch_size == 0) {
+            throw nn_error("inputs and targets must have the same, non-zero size");
+        }
+        std::iota(order_.begin(), order_.end(), size_t(0));
+    }
+
+    /**
+     * @param t_cost per-sample cost of the targets, indexed like targets
+     **/
+    void set_target_cost(const std::vector<tensor_t>& t_cost) {
+        if (!t_cost.empty() && t_cost.size() != targets_.size()) {
+            throw nn_error("target cost must have one entry per sample");
+        }
+        t_cost_ = t_cost;
+    }
+
+    void set_transform(transform_t transform) {
+        transform_ = transform;
+    }
+
+    size_t batch_count() const override {
+        return (inputs_.size() + batch_size_ - 1) / batch_size_;
+    }
+
+    void begin_epoch(int epoch) override {
+        if (!shuffle_) return;
+        std::iota(order_.begin(), order_.end(), size_t(0));
+        std::mt19937 gen(seed_ + static_cast<unsigned int>(epoch));
+        std::shuffle(order_.begin(), order_.end(), gen);
+    }
+
+    void make_batch(size_t index, minibatch* batch) override {
+        const size_t begin = index * batch_size_;
+        const size_t end = std::min(begin + batch_size_, inputs_.size());
+        const size_t n = end - begin;
+
+        batch->in.resize(n);
+        batch->target.resize(n);
+        batch->t_cost.resize(t_cost_.empty() ? 0 : n);
+
+        for (size_t i = 0; i < n; i++) {
+            const size_t sample = order_[begin + i];
+            batch->in[i] = inputs_[sample];
+            batch->target[i] = targets_[sample];
+            if (!t_cost_.empty()) batch->t_cost[i] = t_cost_[sample];
+            if (transform_) transform_(batch->in[i], batch->target[i]);
+        }
+    }
+
+ private:
+    const std::vector<tensor_t>& inputs_;
+    const std::vector<tensor_t>& targets_;
+    std::vector<tensor_t> t_cost_;
+    size_t batch_size_;
+    bool shuffle_;
+    unsigned int seed_;
+    std::vector<size_t> order_;
+    transform_t transform_;
+};
+
+/**
+ * bounded producer/consumer queue of minibatches.
+ *
+ * background workers call source.make_batch for upcoming batches while the
+ * consumer trains on the current one. at most `depth` batches are assembled
+ * ahead of the consumer, and they are delivered in order regardless of the
+ * number of workers. an epoch is only started once every batch of the
+ * previous one has been made, so begin_epoch never races with make_batch.
+ * exceptions thrown by the source are rethrown from next().
+ **/
+class batch_pipeline {
+ public:
+    batch_pipeline(batch_source& source, int epochs,
+                   size_t depth = 2, size_t workers = 1)
+        : source_(source),
+          batches_per_epoch_(source.batch_count()),
+          total_(batches_per_epoch_ * static_cast<size_t>(std::max(epochs, 0))),
+          slots_(std::max(depth, size_t(1))),
+          claimed_(0), made_(0), consumed_(0), in_flight_(0),
+          epoch_(-1), switching_(false), stop_(false) {
+        for (size_t i = 0; i < std::max(workers, size_t(1)); i++) {
+            workers_.emplace_back([this]() { worker_loop(); });
+        }
+    }
+
+    ~batch_pipeline() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cond_.notify_all();
+        for (auto& w : workers_) w.join();
+    }
+
+    size_t batches_per_epoch() const { return batches_per_epoch_; }
+
+    /**
+     * wait for the next minibatch and swap it into *batch. the buffers
+     * previously held by *batch are recycled for upcoming batches.
+     *
+     * @return false once all batches of all epochs have been delivered
+     **/
+    bool next(minibatch* batch) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (consumed_ == total_) return false;
+
+        slot& s = slots_[consumed_ % slots_.size()];
+        cond_.wait(lock, [&]() { return s.ready; });
+
+        if (s.error) {
+            std::exception_ptr e = s.error;
+            stop_ = true;
+            lock.unlock();
+            cond_.notify_all();
+            std::rethrow_exception(e);
+        }
+
+        std::swap(s.batch, *batch);
+        s.ready = false;
+        consumed_++;
+        lock.unlock();
+        cond_.notify_all();
+        return true;
+    }
+
+ private:
+    struct slot {
+        slot() : ready(false) {}
+        minibatch batch;
+        std::exception_ptr error;
+        bool ready;
+    };
+
+    void worker_loop() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;) {
+            // claim the next batch once its slot is free and its epoch began
+            cond_.wait(lock, [this]() {
+                return stop_ || claimable();
+            });
+            if (stop_ || claimed_ == total_) return;
+
+            const size_t seq = claimed_;
+            const int epoch = static_cast<int>(seq / batches_per_epoch_);
+
+            if (epoch != epoch_) {
+                epoch_ = epoch;
+                switching_ = true;
+                lock.unlock();
+                std::exception_ptr error;
+                try {
+                    source_.begin_epoch(epoch);
+                } catch (...) {
+                    error = std::current_exception();
+                }
+                lock.lock();
+                switching_ = false;
+                cond_.notify_all();
+                if (error) {
+                    fail(seq, error);
+                    continue;
+                }
+            }
+
+            claimed_++;
+            in_flight_++;
+            slot& s = slots_[seq % slots_.size()];
+            minibatch batch;
+            std::swap(batch, s.batch);
+            lock.unlock();
+
+            std::exception_ptr error;
+            try {
+                source_.make_batch(seq % batches_per_epoch_, &batch);
+            } catch (...) {
+                error = std::current_exception();
+            }
+
+            lock.lock();
+            std::swap(batch, s.batch);
+            s.error = error;
+            s.ready = true;
+            made_++;
+            in_flight_--;
+            cond_.notify_all();
+        }
+    }
+
+    bool claimable() const {
+        if (claimed_ == total_) return true;  // nothing left, let it exit
+        if (switching_ || claimed_ >= consumed_ + slots_.size()) return false;
+        // a new epoch starts only when the previous one is completely made
+        const int epoch = static_cast<int>(claimed_ / batches_per_epoch_);
+        if (epoch != epoch_) return in_flight_ == 0 && made_ == claimed_;
+        return true;
+    }
+
+    void fail(size_t seq, std::exception_ptr error) {
+        slot& s = slots_[seq % slots_.size()];
+        s.error = error;
+        s.ready = true;
+        claimed_ = total_;
+        cond_.notify_all();
+    }
+
+    batch_source& source_;
+    const size_t batches_per_epoch_;
+    const size_t total_;
+    std::vector<slot> slots_;
+    size_t claimed_;
+    size_t made_;
+    size_t consumed_;
+    size_t in_flight_;
+    int epoch_;
+    bool switching_;  // begin_epoch is running
+    bool stop_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::vector<std::thread> workers_;
+};
+
+}  // namespace tiny_dnn
@@ -0,0 +1,237 @@
+/*
+    Copyright (c) 2016, Taiga Nomi
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+#include "tiny_dnn/config.h"
+
+#if defined(__x86_64__) || defined(__i386__) || \
+    defined(_M_X64) || defined(_M_IX86)
+#define CNN_X86
+#endif
+
+/**
+ * CNN_MULTIVERSION is defined when kernels for several instruction sets are
+ * compiled into the same binary and chosen at runtime (CNN_USE_RUNTIME_DISPATCH
+ * on a x86 target with a compiler supporting per-function targets).
+ */
+#if defined(CNN_USE_RUNTIME_DISPATCH) && defined(CNN_X86) && \
+    (defined(__GNUC__) || defined(_MSC_VER))
+#define CNN_MULTIVERSION
+#endif
+
+#if defined(CNN_X86) && (defined(CNN_MULTIVERSION) || \
+    defined(CNN_USE_SSE) || defined(CNN_USE_AVX))
+#include <immintrin.h>
+#endif
+
+#if defined(CNN_MULTIVERSION) && defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(CNN_MULTIVERSION)
+#include <cpuid.h>
+#endif
+
+/**
+ * CNN_TARGET_PUSH(isa) / CNN_TARGET_POP enclose code which is compiled for
+ * the given instruction set (gcc target syntax, e.g. "avx2,fma") regardless
+ * of the command line flags. callers must check use_isa() before entering it.
+ * msvc accepts intrinsics anywhere, so the region is a no-op there.
+ */
+#define CNN_STR(x) #x
+#if defined(CNN_MULTIVERSION) && defined(__clang__)
+#define CNN_TARGET_PUSH(isa) \
+    _Pragma(CNN_STR(clang attribute push(__attribute__((target(isa))), apply_to = function)))
+#define CNN_TARGET_POP _Pragma("clang attribute pop")
+#elif defined(CNN_MULTIVERSION) && defined(__GNUC__)
+#define CNN_TARGET_PUSH(isa) \
+    _Pragma("GCC push_options") _Pragma(CNN_STR(GCC target(isa)))
+#define CNN_TARGET_POP _Pragma("GCC pop_options")
+#else
+#define CNN_TARGET_PUSH(isa)
+#define CNN_TARGET_POP
+#endif
+
+namespace tiny_dnn {
+
+/**
+ * instruction set levels, ordered: each one implies the previous ones.
+ * avx2 includes fma, avx512 means avx512f.
+ */
+enum class cpu_isa : int {
+    generic = 0,
+    sse2,
+    avx,
+    avx2,
+    avx512
+};
+
+inline const char* to_string(cpu_isa isa) {
+    switch (isa) {
+        case cpu_isa::sse2:   return "sse2";
+        case cpu_isa::avx:    return "avx";
+        case cpu_isa::avx2:   return "avx2";
+        case cpu_isa::avx512: return "avx512";
+        default:              return "generic";
+    }
+}
+
+/**
+ * highest instruction set enabled by the compile-time flags
+ */
+inline cpu_isa compiled_cpu_isa() {
+#if defined(CNN_USE_AVX)
+    return cpu_isa::avx;
+#elif defined(CNN_USE_SSE)
+    return cpu_isa::sse2;
+#else
+    return cpu_isa::generic;
+#endif
+}
+
+namespace detail {
+
+#ifdef CNN_MULTIVERSION
+inline void cpuid(unsigned leaf, unsigned sub, unsigned regs[4]) {
+#ifdef _MSC_VER
+    int r[4];
+    __cpuidex(r, static_cast<int>(leaf), static_cast<int>(sub));
+    for (int i = 0; i < 4; i++) regs[i] = static_cast<unsigned>(r[i]);
+#else
+    regs[0] = regs[1] = regs[2] = regs[3] = 0;
+    __get_cpuid_count(leaf, sub, &regs[0], &regs[1], &regs[2], &regs[3]);
+#endif
+}
+
+// register state enabled by the OS (XCR0)
+inline unsigned long long xgetbv0() {
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    unsigned lo, hi;
+    __asm__ __volatile__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return (static_cast<unsigned long long>(hi) << 32) | lo;
+#endif
+}
+#endif  // CNN_MULTIVERSION
+
+inline cpu_isa detect_cpu_isa() {
+#ifdef CNN_MULTIVERSION
+    unsigned r[4];
+    cpuid(0, 0, r);
+    const unsigned max_leaf = r[0];
+    if (max_leaf < 1) return cpu_isa::generic;
+
+    cpuid(1, 0, r);
+    const bool sse2    = (r[3] & (1u << 26)) != 0;
+    const bool fma     = (r[2] & (1u << 12)) != 0;
+    const bool osxsave = (r[2] & (1u << 27)) != 0;
+    const bool avx     = (r[2] & (1u << 28)) != 0;
+    if (!sse2) return cpu_isa::generic;
+    if (!osxsave || !avx) return cpu_isa::sse2;
+
+    const unsigned long long xcr0 = xgetbv0();
+    if ((xcr0 & 0x6) != 0x6) return cpu_isa::sse2;  // xmm/ymm not saved
+
+    bool avx2 = false, avx512f = false;
+    if (max_leaf >= 7) {
+        cpuid(7, 0, r);
+        avx2    = (r[1] & (1u << 5)) != 0;
+        avx512f = (r[1] & (1u << 16)) != 0;
+    }
+    if (!avx2 || !fma) return cpu_isa::avx;
+    if (!avx512f || (xcr0 & 0xe0) != 0xe0) return cpu_isa::avx2;  // opmask/zmm
+    return cpu_isa::avx512;
+#else
+    return compiled_cpu_isa();
+#endif
+}
+
+// TINY_DNN_ISA=generic|sse2|avx|avx2|avx512 caps the detected level
+inline cpu_isa env_cpu_isa(cpu_isa detected) {
+    const char* env = std::getenv("TINY_DNN_ISA");
+    if (!env) return detected;
+    const cpu_isa levels[] = { cpu_isa::generic, cpu_isa::sse2, cpu_isa::avx,
+                               cpu_isa::avx2, cpu_isa::avx512 };
+    for (cpu_isa isa : levels) {
+        if (std::strcmp(env, to_string(isa)) == 0)
+            return isa < detected ? isa : detected;
+    }
+    return detected;
+}
+
+inline std::atomic<int>& active_isa_storage() {
+    static std::atomic<int> isa(
+        static_cast<int>(env_cpu_isa(detect_cpu_isa())));
+    return isa;
+}
+
+}  // namespace detail
+
+/**
+ * highest instruction set supported by the running cpu (and os).
+ * without runtime dispatch this is the compile-time level.
+ */
+inline cpu_isa detected_cpu_isa() {
+    static const cpu_isa isa = detail::detect_cpu_isa();
+    return isa;
+}
+
+/**
+ * instruction set used by the dispatched kernels: the detected level,
+ * lowered by the TINY_DNN_ISA environment variable or set_cpu_isa()
+ */
+inline cpu_isa active_cpu_isa() {
+    return static_cast<cpu_isa>(
+        detail::active_isa_storage().load(std::memory_order_relaxed));
+}
+
+/**
+ * change the instruction set used by the dispatched kernels (e.g. to compare
+ * results between code paths). levels above detected_cpu_isa() are clamped.
+ */
+inline cpu_isa set_cpu_isa(cpu_isa isa) {
+    if (isa > detected_cpu_isa()) isa = detected_cpu_isa();
+    detail::active_isa_storage().store(static_cast<int>(isa),
+                                       std::memory_order_relaxed);
+    return isa;
+}
+
+/**
+ * true if kernels written for the given instruction set may run.
+ * with runtime dispatch this depends on the cpu, otherwise on the build flags.
+ */
+inline bool use_isa(cpu_isa isa) {
+#ifdef CNN_MULTIVERSION
+    return active_cpu_isa() >= isa;
+#else
+    return compiled_cpu_isa() >= isa;
+#endif
+}
+
+}  // namespace tiny_dnn
@@ -0,0 +1,126 @@
+/*
+    Copyright (c) 2016, Taiga Nomi
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+#include <cstddef>
+#include <string>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "tiny_dnn/util/nn_error.h"
+
+namespace tiny_dnn {
+
+/**
+ * a file mapped into memory, copy-on-write.
+ *
+ * pages are read lazily from the file and shared with every other process
+ * mapping the same file, until they are written: writes go to a private
+ * copy of the page and never reach the file.
+ **/
+class mapped_file {
+ public:
+    explicit mapped_file(const std::string& path) : data_(nullptr), size_(0) {
+#ifdef _WIN32
+        file_ = ::CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                              nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file_ == INVALID_HANDLE_VALUE) throw nn_error("failed to open:" + path);
+        LARGE_INTEGER size;
+        ::GetFileSizeEx(file_, &size);
+        size_ = static_cast<size_t>(size.QuadPart);
+        mapping_ = nullptr;
+        if (size_ > 0) {
+            mapping_ = ::CreateFileMappingA(file_, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+            if (mapping_) data_ = ::MapViewOfFile(mapping_, FILE_MAP_COPY, 0, 0, 0);
+            if (!data_) {
+                close();
+                throw nn_error("failed to map:" + path);
+            }
+        }
+#else
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw nn_error("failed to open:" + path);
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            ::close(fd);
+            throw nn_error("failed to open:" + path);
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        if (size_ > 0) {
+            void* p = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) {
+                ::close(fd);
+                throw nn_error("failed to map:" + path);
+            }
+            data_ = p;
+        }
+        // the mapping stays valid after the descriptor is closed
+        ::close(fd);
+#endif
+    }
+
+    ~mapped_file() { close(); }
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator =(const mapped_file&) = delete;
+
+    char* data() { return static_cast<char*>(data_); }
+    const char* data() const { return static_cast<const char*>(data_); }
+    size_t size() const { return size_; }
+
+ private:
+    void close() {
+#ifdef _WIN32
+        if (data_) ::UnmapViewOfFile(data_);
+        if (mapping_) ::CloseHandle(mapping_);
+        if (file_ != INVALID_HANDLE_VALUE) ::CloseHandle(file_);
+        mapping_ = nullptr;
+        file_ = INVALID_HANDLE_VALUE;
+#else
+        if (data_) ::munmap(data_, size_);
+#endif
+        data_ = nullptr;
+    }
+
+    void* data_;
+    size_t size_;
+#ifdef _WIN32
+    HANDLE file_;
+    HANDLE mapping_;
+#endif
+};
+
+} // namespace tiny_dnn
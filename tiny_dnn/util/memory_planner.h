@@ -0,0 +1,202 @@
+/*
+    Copyright (c) 2016, Taiga Nomi
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+#include "tiny_dnn/node.h"
+#include "tiny_dnn/layers/layer.h"
+
+namespace tiny_dnn {
+
+/**
+ * liveness based sharing of activation buffers at inference time.
+ *
+ * layers are given in execution (topological) order. an edge produced by
+ * a layer is live from its producer until its last consumer has run, and
+ * edges whose live ranges do not overlap are assigned to the same arena.
+ * during forward, an edge borrows the storage of its arena right before
+ * its producer runs and returns it right after its last consumer ran, so
+ * peak activation memory is bounded by the largest live set rather than
+ * the sum of all activations.
+ *
+ * network inputs, outputs of the output layers and weights are never
+ * planned and keep their own storage.
+ **/
+class memory_planner {
+ public:
+    /**
+     * build the plan and release the storage the planned edges own.
+     *
+     * @param order   layers in execution order
+     * @param outputs layers whose outputs must survive the forward pass
+     * @return number of bytes released
+     **/
+    size_t plan(const std::vector<layerptr_t>& order,
+                const std::vector<layerptr_t>& outputs) {
+        clear();
+
+        std::unordered_map<const node*, size_t> step_of;
+        for (size_t i = 0; i < order.size(); i++) step_of[order[i]] = i;
+
+        acquire_.resize(order.size());
+        release_.resize(order.size());
+
+        // live range of each planned edge: [producer step, last consumer step]
+        std::vector<edge*> edges;
+        std::vector<size_t> first, last;
+        for (size_t i = 0; i < order.size(); i++) {
+            if (std::find(outputs.begin(), outputs.end(), order[i]) != outputs.end()) {
+                continue;
+            }
+            for (auto& e : order[i]->next()) {
+                if (!e || e->next().empty()) continue;
+                size_t end = i;
+                bool consumed_in_order = true;
+                for (auto consumer : e->next()) {
+                    auto it = step_of.find(consumer);
+                    if (it == step_of.end()) {
+                        consumed_in_order = false;
+                        break;
+                    }
+                    end = std::max(end, it->second);
+                }
+                if (!consumed_in_order) continue;
+                edges.push_back(e.get());
+                first.push_back(i);
+                last.push_back(end);
+            }
+        }
+
+        // greedy assignment in execution order; outputs of a step are
+        // assigned before the inputs it consumes for the last time are freed
+        std::vector<size_t> arena_of(edges.size());
+        std::vector<bool> busy;
+        for (size_t step = 0; step < order.size(); step++) {
+            for (size_t k = 0; k < edges.size(); k++) {
+                if (first[k] != step) continue;
+                const size_t size = edges[k]->shape().size();
+                arena_of[k] = pick_arena(busy, size);
+                busy[arena_of[k]] = true;
+                arena_sizes_[arena_of[k]] = std::max(arena_sizes_[arena_of[k]], size);
+                acquire_[step].emplace_back(edges[k], arena_of[k]);
+                planned_size_ += size;
+            }
+            for (size_t k = 0; k < edges.size(); k++) {
+                if (last[k] != step) continue;
+                busy[arena_of[k]] = false;
+                release_[step].emplace_back(edges[k], arena_of[k]);
+            }
+        }
+        arenas_.resize(arena_sizes_.size());
+
+        size_t bytes = 0;
+        for (auto e : edges) bytes += e->release_data();
+        return bytes;
+    }
+
+    void clear() {
+        arenas_.clear();
+        arena_sizes_.clear();
+        acquire_.clear();
+        release_.clear();
+        planned_size_ = 0;
+    }
+
+    bool empty() const { return acquire_.empty(); }
+
+    /** number of shared buffers */
+    size_t arena_count() const { return arena_sizes_.size(); }
+
+    /** per-sample size of all planned edges, in elements */
+    size_t planned_size() const { return planned_size_; }
+
+    /** per-sample size of all arenas, in elements */
+    size_t arena_size() const {
+        size_t total = 0;
+        for (auto s : arena_sizes_) total += s;
+        return total;
+    }
+
+    /**
+     * hand arena storage to the outputs of order[step].
+     * @param sample_count batch size of the current forward pass
+     **/
+    void acquire(size_t step, serial_size_t sample_count) {
+        if (step >= acquire_.size()) return;
+        for (auto& a : acquire_[step]) {
+            tensor_t& storage = arenas_[a.second];
+            storage.resize(sample_count);
+            for (auto& v : storage) v.resize(a.first->shape().size());
+            std::swap(*a.first->get_data(), storage);  // the edge is empty
+        }
+    }
+
+    /**
+     * take storage back from the edges whose last consumer is order[step].
+     **/
+    void release(size_t step) {
+        if (step >= release_.size()) return;
+        for (auto& r : release_[step]) {
+            std::swap(*r.first->get_data(), arenas_[r.second]);
+        }
+    }
+
+ private:
+    // free arena that fits best, growing the largest free one if none fits
+    size_t pick_arena(std::vector<bool>& busy, size_t size) {
+        size_t best = arena_sizes_.size();
+        for (size_t a = 0; a < arena_sizes_.size(); a++) {
+            if (busy[a]) continue;
+            if (best == arena_sizes_.size()) {
+                best = a;
+                continue;
+            }
+            const bool fits = arena_sizes_[a] >= size;
+            const bool best_fits = arena_sizes_[best] >= size;
+            if (fits && (!best_fits || arena_sizes_[a] < arena_sizes_[best])) {
+                best = a;
+            } else if (!fits && !best_fits && arena_sizes_[a] > arena_sizes_[best]) {
+                best = a;
+            }
+        }
+        if (best == arena_sizes_.size()) {
+            arena_sizes_.push_back(0);
+            busy.push_back(false);
+        }
+        return best;
+    }
+
+    std::vector<tensor_t> arenas_;
+    std::vector<size_t> arena_sizes_;
+    std::vector<std::vector<std::pair<edge*, size_t>>> acquire_;
+    std::vector<std::vector<std::pair<edge*, size_t>>> release_;
+    size_t planned_size_ = 0;
+};
+
+}  // namespace tiny_dnn
@@ -0,0 +1,256 @@
+/*
+    Copyright (c) 2016, Taiga Nomi
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include "nn_error.h"
+
+namespace tiny_dnn {
+namespace detail {
+
+/**
+ * preallocated buffers vectors can live in instead of the heap, e.g. a
+ * parameter_arena or a mapped weight file.
+ *
+ * aligned_allocator carries no state: a vector is placed into a region by
+ * allocating it inside a region_placement, and the allocator asks detach()
+ * before it frees memory. a region keeps its owner alive until it has been
+ * released and the last vector placed in it is gone.
+ *
+ * regions live in a fixed table so that detach() can look them up without
+ * taking a lock; only adding and removing regions is serialized.
+ **/
+class memory_regions {
+ public:
+    static const size_t max_regions = 256;
+
+    static memory_regions& instance() {
+        static memory_regions regions;
+        return regions;
+    }
+
+    void add(const void* begin, size_t bytes, std::shared_ptr<void> owner) {
+        const char* b = static_cast<const char*>(begin);
+        std::lock_guard<std::mutex> lock(mtx_);
+        for (size_t i = 0; i < max_regions; i++) {
+            region& r = regions_[i];
+            if (r.begin.load(std::memory_order_relaxed)) continue;
+            r.owner    = std::move(owner);
+            r.released = false;
+            r.views.store(0, std::memory_order_relaxed);
+            r.end.store(b + bytes, std::memory_order_relaxed);
+            r.begin.store(b, std::memory_order_release);
+            if (i >= used_.load(std::memory_order_relaxed)) {
+                used_.store(i + 1, std::memory_order_release);
+            }
+            count_.fetch_add(1, std::memory_order_release);
+            return;
+        }
+        throw nn_error("too many memory regions");
+    }
+
+    /**
+     * the creator of the region at begin is done with it
+     **/
+    void release(const void* begin) {
+        std::shared_ptr<void> owner;  // dropped after the lock
+        std::lock_guard<std::mutex> lock(mtx_);
+        const size_t n = used_.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < n; i++) {
+            region& r = regions_[i];
+            if (r.begin.load(std::memory_order_relaxed) != begin ||
+                r.released) continue;
+            r.released = true;
+            if (r.views.load(std::memory_order_acquire) == 0) owner = erase(i);
+            return;
+        }
+    }
+
+    /**
+     * a vector was placed at p
+     **/
+    void attach(const void* p) {
+        const size_t i = find(p);
+        if (i < max_regions) {
+            regions_[i].views.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * false if p is not in a region. otherwise the vector placed at p
+     * is gone, and its memory must not be freed
+     **/
+    bool detach(const void* p) {
+        if (count_.load(std::memory_order_acquire) == 0) return false;
+
+        const size_t i = find(p);
+        if (i == max_regions) return false;
+        if (regions_[i].views.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            std::shared_ptr<void> owner;
+            std::lock_guard<std::mutex> lock(mtx_);
+            region& r = regions_[i];
+            if (r.released && r.begin.load(std::memory_order_relaxed) &&
+                r.views.load(std::memory_order_acquire) == 0) {
+                owner = erase(i);
+            }
+        }
+        return true;
+    }
+
+ private:
+    struct region {
+        std::atomic<const char*> begin;  // nullptr while the slot is free
+        std::atomic<const char*> end;
+        std::atomic<size_t> views;
+        std::shared_ptr<void> owner;     // guarded by mtx_
+        bool released;                   // guarded by mtx_
+    };
+
+    memory_regions() : used_(0), count_(0) {
+        for (auto& r : regions_) {
+            r.begin.store(nullptr, std::memory_order_relaxed);
+            r.end.store(nullptr, std::memory_order_relaxed);
+            r.views.store(0, std::memory_order_relaxed);
+            r.released = false;
+        }
+    }
+
+    size_t find(const void* p) const {
+        const char* c = static_cast<const char*>(p);
+        const size_t n = used_.load(std::memory_order_acquire);
+        for (size_t i = 0; i < n; i++) {
+            const region& r = regions_[i];
+            const char* b = r.begin.load(std::memory_order_acquire);
+            if (!b || c < b) continue;
+            const char* e = r.end.load(std::memory_order_acquire);
+            // a slot reused in between would have changed begin
+            if (c < e && r.begin.load(std::memory_order_acquire) == b) return i;
+        }
+        return max_regions;
+    }
+
+    std::shared_ptr<void> erase(size_t i) {
+        std::shared_ptr<void> owner = std::move(regions_[i].owner);
+        regions_[i].begin.store(nullptr, std::memory_order_release);
+        count_.fetch_sub(1, std::memory_order_release);
+        return owner;
+    }
+
+    std::mutex mtx_;
+    region regions_[max_regions];
+    std::atomic<size_t> used_;   // slots ever used, scanned by find()
+    std::atomic<size_t> count_;  // regions currently in the table
+};
+
+/**
+ * while alive, the first allocation of exactly `bytes` bytes on this thread
+ * is served from `begin`, which must lie in a region of memory_regions.
+ **/
+class region_placement {
+ public:
+    region_placement(void* begin, size_t bytes) {
+        state& s = current();
+        s.begin = static_cast<char*>(begin);
+        s.bytes = bytes;
+        s.taken = false;
+    }
+
+    ~region_placement() {
+        current().begin = nullptr;
+    }
+
+    static void* take(size_t bytes) {
+        state& s = current();
+        if (!s.begin || s.taken || s.bytes != bytes) return nullptr;
+        s.taken = true;
+        memory_regions::instance().attach(s.begin);
+        return s.begin;
+    }
+
+ private:
+    region_placement(const region_placement&) = delete;
+    region_placement& operator =(const region_placement&) = delete;
+
+    struct state {
+        char* begin;
+        size_t bytes;
+        bool taken;
+    };
+
+    static state& current() {
+        static thread_local state s;
+        return s;
+    }
+};
+
+/**
+ * element "value" aligned_allocator constructs by leaving the memory as it
+ * is. a vector built from a keep_contents_iterator range inside a placement
+ * views the region's existing contents without writing to them.
+ **/
+struct keep_contents {};
+
+class keep_contents_iterator {
+ public:
+    typedef std::random_access_iterator_tag iterator_category;
+    typedef keep_contents value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const keep_contents* pointer;
+    typedef const keep_contents& reference;
+
+    explicit keep_contents_iterator(size_t pos) : pos_(pos) {}
+
+    reference operator*() const { return value(); }
+    keep_contents_iterator& operator++() { ++pos_; return *this; }
+    keep_contents_iterator operator++(int) {
+        keep_contents_iterator tmp(*this); ++pos_; return tmp;
+    }
+    difference_type operator-(const keep_contents_iterator& rhs) const {
+        return static_cast<difference_type>(pos_) -
+               static_cast<difference_type>(rhs.pos_);
+    }
+    bool operator==(const keep_contents_iterator& rhs) const {
+        return pos_ == rhs.pos_;
+    }
+    bool operator!=(const keep_contents_iterator& rhs) const {
+        return pos_ != rhs.pos_;
+    }
+
+ private:
+    static const keep_contents& value() {
+        static const keep_contents v = {};
+        return v;
+    }
+
+    size_t pos_;
+};
+
+} // namespace detail
+} // namespace tiny_dnn
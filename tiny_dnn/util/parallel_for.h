@@ -43,9 +43,12 @@
 #include <tbb/task_group.h>
 #endif
 
-#ifndef CNN_USE_OMP
-#include <thread>
-#include <future>
+#ifdef CNN_USE_OMP
+#include <omp.h>
+#endif
+
+#if !defined(CNN_USE_TBB) && !defined(CNN_USE_OMP) && !defined(CNN_SINGLE_THREAD)
+#include "thread_pool.h"
 #endif
 
 namespace tiny_dnn {
@@ -65,6 +68,10 @@ void xparallel_for(int begin, int end, const Func& f) {
     f(blocked_range(begin, end, 100));
 }
 
+inline size_t num_threads() {
+    return static_cast<size_t>(tbb::task_scheduler_init::default_num_threads());
+}
+
 #else
 
 struct blocked_range {
@@ -95,6 +102,10 @@ void parallel_for(int begin, int end, const Func& f, int /*grainsize*/) {
         f(blocked_range(i,i+1));
 }
 
+inline size_t num_threads() {
+    return static_cast<size_t>(omp_get_max_threads());
+}
+
 #elif defined(CNN_SINGLE_THREAD)
 
 template<typename Func>
@@ -102,34 +113,29 @@ void parallel_for(int begin, int end, const Func& f, int /*grainsize*/) {
     xparallel_for(static_cast<size_t>(begin), static_cast<size_t>(end), f);
 }
 
+inline size_t num_threads() {
+    return 1;
+}
+
 #else
 
 template<typename Func>
-void parallel_for(int start, int end, const Func &f, int /*grainsize*/) {
-    int nthreads = std::thread::hardware_concurrency();
-    int blockSize = (end - start) / nthreads;
-    if (blockSize*nthreads < end - start)
-        blockSize++;
-
-    std::vector<std::future<void>> futures;
-
-    int blockStart = start;
-    int blockEnd = blockStart + blockSize;
-    if (blockEnd > end) blockEnd = end;
-
-    for (int i = 0; i < nthreads; i++) {
-        futures.push_back(std::move(std::async(std::launch::async, [blockStart, blockEnd, &f] {
-            f(blocked_range(blockStart, blockEnd));
-        })));
+void parallel_for(int begin, int end, const Func &f, int grainsize) {
+    thread_pool::instance().run(begin, end, grainsize, [&f](int b, int e) {
+        f(blocked_range(b, e));
+    });
+}
 
-        blockStart += blockSize;
-        blockEnd = blockStart + blockSize;
-        if (blockStart >= end) break;
-        if (blockEnd > end) blockEnd = end;
-    }
+/**
+ * set the number of threads used by parallel_for (including the calling thread).
+ * 0 means std::thread::hardware_concurrency().
+ **/
+inline void set_num_threads(size_t num_threads) {
+    thread_pool::instance().resize(num_threads);
+}
 
-    for (auto &future : futures)
-        future.wait();
+inline size_t num_threads() {
+    return thread_pool::instance().num_threads();
 }
 
 #endif
@@ -179,4 +185,22 @@ void for_i(T size, Func f, int grainsize = 100) {
     for_i(true, size, f, grainsize);
 }
 
+/**
+ * split samples [0, sample_count) into slot_count contiguous chunks and
+ * call f(slot, sample) for each sample. chunks run in parallel, samples of
+ * one chunk run in order on a single thread, so per-slot accumulators
+ * (e.g. weight gradients) can be updated without synchronization.
+ **/
+template <typename T, typename Func>
+void for_i_slotted(bool parallelize, T sample_count, size_t slot_count, Func f) {
+    const size_t n = static_cast<size_t>(sample_count);
+    for_i(parallelize, slot_count, [&](int slot) {
+        const size_t begin = slot * n / slot_count;
+        const size_t end = (slot + 1) * n / slot_count;
+        for (size_t sample = begin; sample < end; sample++) {
+            f(slot, static_cast<int>(sample));
+        }
+    }, 1);
+}
+
 } // namespace tiny_dnn
@@ -0,0 +1,239 @@
+/*
+    Copyright (c) 2016, Taiga Nomi
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "tiny_dnn/util/util.h"
+#include "tiny_dnn/util/product.h"
+
+namespace tiny_dnn {
+
+/**
+ * one contiguous, aligned buffer holding a set of parameter vectors.
+ *
+ * bind moves the vectors into the buffer, one after another, each padded
+ * to the 64 byte alignment of vec_t. they stay ordinary vec_t objects, so
+ * layers and kernels use them as before, but their elements are now views
+ * into the buffer (see detail::memory_regions): copying, averaging or
+ * restoring all parameters of a network is a single sweep over data()/size().
+ *
+ * the buffer lives as long as the arena or any of the views. copies of a
+ * view are allocated on the heap and copy assignment writes into the
+ * buffer, while a view detaches (and bound() turns false) when its vector
+ * is resized, or swapped or move-assigned with another vector.
+ *
+ * layers cache data derived from their weights (see
+ * layer::weights_version), so bulk writes into the buffer are announced
+ * through the hook set by set_on_modified. restore and average do this
+ * themselves, code writing through data() calls modified().
+ **/
+class parameter_arena {
+ public:
+    /**
+     * move params into a new buffer, keeping their contents.
+     * vectors listed more than once are placed once.
+     *
+     * @return number of elements of the buffer, padding included
+     **/
+    size_t bind(const std::vector<vec_t*>& params) {
+        const size_t size = layout(params);
+        auto buffer = std::make_shared<vec_t>(size, float_t(0));
+        use_region(buffer->data(), size, buffer);
+
+        for (size_t i = 0; i < params_.size(); i++) {
+            vec_t& p = *params_[i];
+            vec_t view = make_view(i);
+            std::copy(p.begin(), p.end(), view.begin());
+            p.swap(view);
+        }
+        return size;
+    }
+
+    /**
+     * let params view an existing buffer laid out as bind would, e.g. a
+     * mapped weight file. the contents of the buffer are used as they are
+     * and not touched. owner keeps the buffer alive.
+     **/
+    void adopt(const std::vector<vec_t*>& params,
+               float_t* data, size_t size, std::shared_ptr<void> owner) {
+        if (layout(params) != size) {
+            throw nn_error("parameter buffer does not match the arena layout");
+        }
+        use_region(data, size, std::move(owner));
+
+        for (size_t i = 0; i < params_.size(); i++) {
+            vec_t view = make_view(i);
+            params_[i]->swap(view);
+        }
+    }
+
+    /**
+     * number of elements a buffer holding params needs, padding included.
+     * as in bind, vectors listed more than once count once.
+     **/
+    static size_t required_size(const std::vector<const vec_t*>& params) {
+        size_t size = 0;
+        for (size_t i = 0; i < params.size(); i++) {
+            if (std::find(params.begin(), params.begin() + i, params[i]) !=
+                params.begin() + i) continue;
+            size += padded(params[i]->size());
+        }
+        return size;
+    }
+
+    /**
+     * elements one vector of the given size occupies in the buffer
+     **/
+    static size_t padded(size_t size) {
+        const size_t align = 64 / sizeof(float_t);
+        return (size + align - 1) / align * align;
+    }
+
+    /**
+     * true if every bound vector still views its range of the buffer
+     **/
+    bool bound() const {
+        for (size_t i = 0; i < params_.size(); i++) {
+            if (params_[i]->data() != data() + offsets_[i] &&
+                !params_[i]->empty()) return false;
+        }
+        return true;
+    }
+
+    /**
+     * hook run after the parameters have been written in bulk
+     **/
+    void set_on_modified(std::function<void()> f) { on_modified_ = std::move(f); }
+
+    /**
+     * announce a write through data() to the owners of the parameters
+     **/
+    void modified() {
+        if (on_modified_) on_modified_();
+    }
+
+    float_t* data() { return data_; }
+    const float_t* data() const { return data_; }
+    size_t size() const { return size_; }
+
+    const std::vector<vec_t*>& params() const { return params_; }
+
+    // offset of the i-th bound vector in the buffer
+    size_t offset(size_t i) const { return offsets_[i]; }
+
+    /**
+     * copy of all parameters (padding included)
+     **/
+    vec_t snapshot() const {
+        return vec_t(data(), data() + size());
+    }
+
+    /**
+     * overwrite all parameters with a snapshot of the same layout
+     **/
+    void restore(const vec_t& snapshot) {
+        if (snapshot.size() != size()) {
+            throw nn_error("parameter snapshot does not match the arena layout");
+        }
+        std::copy(snapshot.begin(), snapshot.end(), data());
+        modified();
+    }
+
+    /**
+     * set all parameters to the element-wise mean of snapshots, e.g. of
+     * replicas of the same network trained on different shards
+     **/
+    void average(const std::vector<vec_t>& snapshots) {
+        if (snapshots.empty()) return;
+        for (const auto& s : snapshots) {
+            if (s.size() != size()) {
+                throw nn_error("parameter snapshot does not match the arena layout");
+            }
+        }
+        const float_t scale = float_t(1) / float_t(snapshots.size());
+        float_t* dst = data();
+        for_(size() >= 4096, 0, size(), [&](const blocked_range& r) {
+            const size_t n = r.end() - r.begin();
+            float_t* d = dst + r.begin();
+            std::fill(d, d + n, float_t(0));
+            for (const auto& s : snapshots) {
+                vectorize::muladd<float_t>(&s[r.begin()], scale, n, d);
+            }
+        }, 1024);
+        modified();
+    }
+
+ private:
+    // assign offsets, returns the buffer size
+    size_t layout(const std::vector<vec_t*>& params) {
+        params_.clear();
+        offsets_.clear();
+        size_t size = 0;
+        for (auto p : params) {
+            if (std::find(params_.begin(), params_.end(), p) != params_.end()) continue;
+            params_.push_back(p);
+            offsets_.push_back(size);
+            size += padded(p->size());
+        }
+        return size;
+    }
+
+    // register the buffer as a memory region, releasing the previous one
+    void use_region(float_t* data, size_t size, std::shared_ptr<void> owner) {
+        region_.reset();
+        data_ = data;
+        size_ = size;
+        if (size == 0) return;
+
+        detail::memory_regions::instance().add(data, size * sizeof(float_t),
+                                               std::move(owner));
+        region_ = std::shared_ptr<void>(data, [](void* p) {
+            detail::memory_regions::instance().release(p);
+        });
+    }
+
+    // vector of the i-th parameter's size placed at its offset
+    vec_t make_view(size_t i) const {
+        detail::region_placement placement(data_ + offsets_[i],
+                                           params_[i]->size() * sizeof(float_t));
+        return vec_t(detail::keep_contents_iterator(0),
+                     detail::keep_contents_iterator(params_[i]->size()));
+    }
+
+    // released (shared by copies of the arena) when the arena lets go of it
+    std::shared_ptr<void> region_;
+    float_t* data_ = nullptr;
+    size_t size_ = 0;
+    std::vector<vec_t*> params_;
+    std::vector<size_t> offsets_;
+    std::function<void()> on_modified_;
+};
+
+} // namespace tiny_dnn
@@ -28,10 +28,13 @@
 #if defined(CNN_USE_SSE) || defined(CNN_USE_AVX)
 #include <immintrin.h>
 #endif
+#include <cmath>
 #include <cstdint>
 #include <cassert>
 #include <numeric>
 
+#include "tiny_dnn/util/cpu_features.h"
+
 #if defined(_MSC_VER)
 #define VECTORIZE_ALIGN(x) __declspec(align(x))
 #elif defined(__GNUC__)
@@ -67,6 +70,9 @@ struct generic_vec_type {
     static register_type zero() { return register_type(0); }
     static register_type mul(const register_type& v1, const register_type& v2) { return v1 * v2; }
     static register_type add(const register_type& v1, const register_type& v2) { return v1 + v2; }
+    static register_type sub(const register_type& v1, const register_type& v2) { return v1 - v2; }
+    static register_type div(const register_type& v1, const register_type& v2) { return v1 / v2; }
+    static register_type sqrt(const register_type& v) { return std::sqrt(v); }
     static register_type load(const value_type* px) { return *px; }
     static register_type loadu(const value_type* px) { return *px; }
     static void store(value_type* px, const register_type& v) { *px = v; }
@@ -86,6 +92,9 @@ struct float_sse {
     static register_type zero() { register_type v = {}; return v; }
     static register_type mul(const register_type& v1, const register_type& v2) { return _mm_mul_ps(v1, v2); }
     static register_type add(const register_type& v1, const register_type& v2) { return _mm_add_ps(v1, v2); }
+    static register_type sub(const register_type& v1, const register_type& v2) { return _mm_sub_ps(v1, v2); }
+    static register_type div(const register_type& v1, const register_type& v2) { return _mm_div_ps(v1, v2); }
+    static register_type sqrt(const register_type& v) { return _mm_sqrt_ps(v); }
     static register_type load(const value_type* px) { return _mm_load_ps(px); }
     static register_type loadu(const value_type* px) { return _mm_loadu_ps(px); }
     static void store(value_type* px, const register_type& v) { _mm_store_ps(px, v); }
@@ -107,6 +116,9 @@ struct double_sse {
     static register_type zero() { register_type v = {}; return v; }
     static register_type mul(const register_type& v1, const register_type& v2) { return _mm_mul_pd(v1, v2); }
     static register_type add(const register_type& v1, const register_type& v2) { return _mm_add_pd(v1, v2); }
+    static register_type sub(const register_type& v1, const register_type& v2) { return _mm_sub_pd(v1, v2); }
+    static register_type div(const register_type& v1, const register_type& v2) { return _mm_div_pd(v1, v2); }
+    static register_type sqrt(const register_type& v) { return _mm_sqrt_pd(v); }
     static register_type load(const value_type* px) { return _mm_load_pd(px); }
     static register_type loadu(const value_type* px) { return _mm_loadu_pd(px); }
     static void store(value_type* px, const register_type& v) { _mm_store_pd(px, v); }
@@ -144,6 +156,9 @@ struct float_avx {
     static register_type zero() { register_type v = {}; return v; }
     static register_type mul(const register_type& v1, const register_type& v2) { return _mm256_mul_ps(v1, v2); }
     static register_type add(const register_type& v1, const register_type& v2) { return _mm256_add_ps(v1, v2); }
+    static register_type sub(const register_type& v1, const register_type& v2) { return _mm256_sub_ps(v1, v2); }
+    static register_type div(const register_type& v1, const register_type& v2) { return _mm256_div_ps(v1, v2); }
+    static register_type sqrt(const register_type& v) { return _mm256_sqrt_ps(v); }
     static register_type load(const value_type* px) { return _mm256_load_ps(px); }
     static register_type loadu(const value_type* px) { return _mm256_loadu_ps(px); }
     static void store(value_type* px, const register_type& v) { _mm256_store_ps(px, v); }
@@ -165,6 +180,9 @@ struct double_avx {
     static register_type zero() { register_type v = {}; return v; }
     static register_type mul(const register_type& v1, const register_type& v2) { return _mm256_mul_pd(v1, v2); }
     static register_type add(const register_type& v1, const register_type& v2) { return _mm256_add_pd(v1, v2); }
+    static register_type sub(const register_type& v1, const register_type& v2) { return _mm256_sub_pd(v1, v2); }
+    static register_type div(const register_type& v1, const register_type& v2) { return _mm256_div_pd(v1, v2); }
+    static register_type sqrt(const register_type& v) { return _mm256_sqrt_pd(v); }
     static register_type load(const value_type* px) { return _mm256_load_pd(px); }
     static register_type loadu(const value_type* px) { return _mm256_loadu_pd(px); }
     static void store(value_type* px, const register_type& v) { _mm256_store_pd(px, v); }
@@ -315,4 +333,136 @@ void reduce(const T* src, std::size_t  size, T* dst) {
         return detail::reduce_nonaligned<VECTORIZE_TYPE(T)>(src, size, dst);
 }
 
+/// k(V(), i) for each register-wide chunk starting at i, k(scalar, i) for the tail.
+/// k is a functor with a templated operator() using unaligned loads/stores.
+template<typename T, typename Kernel>
+void elementwise(std::size_t size, const Kernel& k) {
+    typedef VECTORIZE_TYPE(T) V;
+    std::size_t i = 0;
+    for (; i + V::unroll_size <= size; i += V::unroll_size)
+        k(V(), i);
+    for (; i < size; i++)
+        k(detail::generic_vec_type<T>(), i);
+}
+
 } // namespace vectorize
+
+#ifdef CNN_MULTIVERSION
+
+// float kernels for each instruction set, selected by active_cpu_isa()
+
+CNN_TARGET_PUSH("sse2")
+namespace vectorize { namespace isa { namespace sse2 {
+struct ops {
+    typedef __m128 reg;
+    enum { width = 4 };
+    static reg zero() { return _mm_setzero_ps(); }
+    static reg set1(float x) { return _mm_set1_ps(x); }
+    static reg loadu(const float* p) { return _mm_loadu_ps(p); }
+    static void storeu(float* p, reg x) { _mm_storeu_ps(p, x); }
+    static reg add(reg a, reg b) { return _mm_add_ps(a, b); }
+    static reg fmadd(reg a, reg b, reg c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+    static float hsum(reg x) {
+        x = _mm_add_ps(x, _mm_movehl_ps(x, x));
+        x = _mm_add_ss(x, _mm_shuffle_ps(x, x, 1));
+        return _mm_cvtss_f32(x);
+    }
+};
+}}}
+#define VECTORIZE_ISA sse2
+#include "tiny_dnn/util/product_isa.h"
+#undef VECTORIZE_ISA
+CNN_TARGET_POP
+
+CNN_TARGET_PUSH("avx")
+namespace vectorize { namespace isa { namespace avx {
+struct ops {
+    typedef __m256 reg;
+    enum { width = 8 };
+    static reg zero() { return _mm256_setzero_ps(); }
+    static reg set1(float x) { return _mm256_set1_ps(x); }
+    static reg loadu(const float* p) { return _mm256_loadu_ps(p); }
+    static void storeu(float* p, reg x) { _mm256_storeu_ps(p, x); }
+    static reg add(reg a, reg b) { return _mm256_add_ps(a, b); }
+    static reg fmadd(reg a, reg b, reg c) { return _mm256_add_ps(_mm256_mul_ps(a, b), c); }
+    static float hsum(reg x) {
+        __m128 y = _mm_add_ps(_mm256_castps256_ps128(x), _mm256_extractf128_ps(x, 1));
+        y = _mm_add_ps(y, _mm_movehl_ps(y, y));
+        y = _mm_add_ss(y, _mm_shuffle_ps(y, y, 1));
+        return _mm_cvtss_f32(y);
+    }
+};
+}}}
+#define VECTORIZE_ISA avx
+#include "tiny_dnn/util/product_isa.h"
+#undef VECTORIZE_ISA
+CNN_TARGET_POP
+
+CNN_TARGET_PUSH("avx2,fma")
+namespace vectorize { namespace isa { namespace avx2 {
+struct ops : avx::ops {
+    static reg fmadd(reg a, reg b, reg c) { return _mm256_fmadd_ps(a, b, c); }
+};
+}}}
+#define VECTORIZE_ISA avx2
+#include "tiny_dnn/util/product_isa.h"
+#undef VECTORIZE_ISA
+CNN_TARGET_POP
+
+CNN_TARGET_PUSH("avx512f")
+namespace vectorize { namespace isa { namespace avx512 {
+struct ops {
+    typedef __m512 reg;
+    enum { width = 16 };
+    static reg zero() { return _mm512_setzero_ps(); }
+    static reg set1(float x) { return _mm512_set1_ps(x); }
+    static reg loadu(const float* p) { return _mm512_loadu_ps(p); }
+    static void storeu(float* p, reg x) { _mm512_storeu_ps(p, x); }
+    static reg add(reg a, reg b) { return _mm512_add_ps(a, b); }
+    static reg fmadd(reg a, reg b, reg c) { return _mm512_fmadd_ps(a, b, c); }
+    static float hsum(reg x) {
+        // through memory: _mm512_reduce_add_ps and the 512-bit extracts
+        // trip -Wuninitialized on gcc
+        float t[16];
+        _mm512_storeu_ps(t, x);
+        return avx::ops::hsum(_mm256_add_ps(_mm256_loadu_ps(t), _mm256_loadu_ps(t + 8)));
+    }
+};
+}}}
+#define VECTORIZE_ISA avx512
+#include "tiny_dnn/util/product_isa.h"
+#undef VECTORIZE_ISA
+CNN_TARGET_POP
+
+namespace vectorize {
+
+#define VECTORIZE_DISPATCH(call) \
+    switch (tiny_dnn::active_cpu_isa()) { \
+        case tiny_dnn::cpu_isa::avx512: return isa::avx512::call; \
+        case tiny_dnn::cpu_isa::avx2:   return isa::avx2::call; \
+        case tiny_dnn::cpu_isa::avx:    return isa::avx::call; \
+        case tiny_dnn::cpu_isa::sse2:   return isa::sse2::call; \
+        default: break; \
+    }
+
+template<>
+inline void muladd<float>(const float* src, float c, std::size_t size, float* dst) {
+    VECTORIZE_DISPATCH(muladd(src, c, size, dst))
+    detail::muladd_nonaligned<VECTORIZE_TYPE(float)>(src, c, size, dst);
+}
+
+template<>
+inline float dot<float>(const float* s1, const float* s2, std::size_t size) {
+    VECTORIZE_DISPATCH(dot(s1, s2, size))
+    return detail::dot_product_nonaligned<VECTORIZE_TYPE(float)>(s1, s2, size);
+}
+
+template<>
+inline void reduce<float>(const float* src, std::size_t size, float* dst) {
+    VECTORIZE_DISPATCH(reduce(src, size, dst))
+    detail::reduce_nonaligned<VECTORIZE_TYPE(float)>(src, size, dst);
+}
+
+} // namespace vectorize
+
+#endif // CNN_MULTIVERSION
@@ -0,0 +1,101 @@
+/*
+    Copyright (c) 2016, Taiga Nomi
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// no include guard: product.h includes this once per instruction set, inside
+// a CNN_TARGET_PUSH region, with VECTORIZE_ISA naming a namespace which
+// provides the register operations as `ops`.
+
+namespace vectorize {
+namespace isa {
+namespace VECTORIZE_ISA {
+
+// sum(s1[i] * s2[i])
+inline float dot(const float* s1, const float* s2, std::size_t size) {
+    typedef ops::reg reg;
+    const std::size_t W = ops::width;
+    reg acc0 = ops::zero(), acc1 = ops::zero();
+    std::size_t i = 0;
+    for (; i + 2 * W <= size; i += 2 * W) {
+        acc0 = ops::fmadd(ops::loadu(s1 + i), ops::loadu(s2 + i), acc0);
+        acc1 = ops::fmadd(ops::loadu(s1 + i + W), ops::loadu(s2 + i + W), acc1);
+    }
+    for (; i + W <= size; i += W)
+        acc0 = ops::fmadd(ops::loadu(s1 + i), ops::loadu(s2 + i), acc0);
+
+    float sum = ops::hsum(ops::add(acc0, acc1));
+    for (; i < size; i++) sum += s1[i] * s2[i];
+    return sum;
+}
+
+// dst[i] += c * src[i]
+inline void muladd(const float* src, float c, std::size_t size, float* dst) {
+    const ops::reg factor = ops::set1(c);
+    const std::size_t W = ops::width;
+    std::size_t i = 0;
+    for (; i + W <= size; i += W)
+        ops::storeu(dst + i, ops::fmadd(ops::loadu(src + i), factor, ops::loadu(dst + i)));
+    for (; i < size; i++) dst[i] += src[i] * c;
+}
+
+// dst[i] += src[i]
+inline void reduce(const float* src, std::size_t size, float* dst) {
+    const std::size_t W = ops::width;
+    std::size_t i = 0;
+    for (; i + W <= size; i += W)
+        ops::storeu(dst + i, ops::add(ops::loadu(dst + i), ops::loadu(src + i)));
+    for (; i < size; i++) dst[i] += src[i];
+}
+
+// tile[4 x 16] = Ap[kc x 4]^T * Bp[kc x 16], with A and B packed as in
+// kernels::gemm (4 values of A / 16 values of B per k)
+inline void gemm_tile_4x16(std::size_t kc, const float* ap, const float* bp,
+                           float* tile) {
+    typedef ops::reg reg;
+    enum { W = ops::width, NV = 16 / W };
+
+    reg acc[4][NV];
+    for (int r = 0; r < 4; r++)
+        for (int v = 0; v < NV; v++) acc[r][v] = ops::zero();
+
+    for (std::size_t p = 0; p < kc; p++) {
+        reg b[NV];
+        for (int v = 0; v < NV; v++) b[v] = ops::loadu(bp + v * W);
+        for (int r = 0; r < 4; r++) {
+            const reg a = ops::set1(ap[r]);
+            for (int v = 0; v < NV; v++) acc[r][v] = ops::fmadd(a, b[v], acc[r][v]);
+        }
+        ap += 4;
+        bp += 16;
+    }
+
+    for (int r = 0; r < 4; r++)
+        for (int v = 0; v < NV; v++) ops::storeu(tile + r * 16 + v * W, acc[r][v]);
+}
+
+}  // namespace VECTORIZE_ISA
+}  // namespace isa
+}  // namespace vectorize
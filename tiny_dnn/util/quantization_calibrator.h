@@ -0,0 +1,388 @@
+/*
+    Copyright (c) 2016, Taiga Nomi
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+
+#ifdef CNN_NO_SERIALIZATION
+#error "quantization_calibrator clones layers through the serializer, undef CNN_NO_SERIALIZATION to use it"
+#endif
+
+#include <algorithm>
+#include <iomanip>
+#include <memory>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "tiny_dnn/network.h"
+#include "tiny_dnn/layers/convolutional_layer.h"
+#include "tiny_dnn/layers/fully_connected_layer.h"
+#include "tiny_dnn/layers/quantized_convolutional_layer.h"
+#include "tiny_dnn/layers/quantized_fully_connected_layer.h"
+#include "tiny_dnn/util/serialization_helper.h"
+#include "tiny_dnn/util/deserialization_helper.h"
+
+#include "cereal/archives/binary.hpp"
+
+namespace tiny_dnn {
+
+/**
+ * how the activation range of a layer is derived from the calibration set
+ **/
+enum class calibration_method {
+    min_max,    // smallest/largest value seen over all samples
+    percentile  // percentile of the per-sample extrema, ignores outliers
+};
+
+/**
+ * calibration result of one layer
+ **/
+struct layer_calibration {
+    layer_calibration()
+        : quantized(false), max_error(0), mean_error(0) {}
+
+    std::string layer_type;
+    bool quantized;                   // replaced by a quantized layer
+    core::quantization_ranges ranges; // recorded ranges, always valid
+    float_t max_error;                // output drift measured by measure_drift
+    float_t mean_error;
+};
+
+namespace detail {
+
+template <typename Activation>
+std::shared_ptr<layer> make_quantized(const layer& l,
+                                      const core::quantization_ranges& ranges) {
+    typedef convolutional_layer<Activation>             conv;
+    typedef fully_connected_layer<Activation>           fully;
+    typedef quantized_convolutional_layer<Activation>   qconv;
+    typedef quantized_fully_connected_layer<Activation> qfully;
+
+    if (auto c = dynamic_cast<const conv*>(&l)) {
+        const core::conv_params& p = c->params();
+        auto q = std::make_shared<qconv>(p.in.width_, p.in.height_,
+                                         p.weight.width_, p.weight.height_,
+                                         p.in.depth_, p.out.depth_, p.tbl,
+                                         p.pad_type, p.has_bias,
+                                         p.w_stride, p.h_stride);
+        q->set_quantization_ranges(ranges);
+        return q;
+    }
+    if (auto f = dynamic_cast<const fully*>(&l)) {
+        const core::fully_params& p = f->params();
+        auto q = std::make_shared<qfully>(p.in_size_, p.out_size_, p.has_bias_);
+        q->set_quantization_ranges(ranges);
+        return q;
+    }
+    return nullptr;
+}
+
+/**
+ * quantized counterpart of a convolutional/fully-connected layer,
+ * nullptr for any other layer
+ **/
+inline std::shared_ptr<layer> make_quantized_layer(
+    const layer& l, const core::quantization_ranges& ranges) {
+    std::shared_ptr<layer> q;
+    if ((q = make_quantized<activation::tan_h>(l, ranges)))      return q;
+    if ((q = make_quantized<activation::softmax>(l, ranges)))    return q;
+    if ((q = make_quantized<activation::identity>(l, ranges)))   return q;
+    if ((q = make_quantized<activation::sigmoid>(l, ranges)))    return q;
+    if ((q = make_quantized<activation::relu>(l, ranges)))       return q;
+    if ((q = make_quantized<activation::leaky_relu>(l, ranges))) return q;
+    if ((q = make_quantized<activation::elu>(l, ranges)))        return q;
+    if ((q = make_quantized<activation::tan_hp1m2>(l, ranges)))  return q;
+    return nullptr;
+}
+
+/**
+ * deep copy of a layer (model and weights) through the serializer
+ **/
+inline std::shared_ptr<layer> clone_layer(layer& l) {
+    std::stringstream ss;
+    {
+        cereal::BinaryOutputArchive oa(ss);
+        layer::save_layer(oa, l);
+        oa(l);
+    }
+    cereal::BinaryInputArchive ia(ss);
+    std::shared_ptr<layer> c = layer::load_layer(ia);
+    ia(*c);
+    return c;
+}
+
+}  // namespace detail
+
+/**
+ * post-training quantization of sequential networks.
+ *
+ * calibrate() runs a trained float network over a calibration set and
+ * records the input, pre-activation and output range of each layer.
+ * convert() then emits an equivalent network in which convolutional and
+ * fully-connected layers are replaced by their quantized counterparts
+ * using these static ranges, so that the uint8 kernels no longer scan
+ * every tensor for its range. measure_drift() compares the outputs of
+ * both networks layer by layer.
+ *
+ * @code
+ * quantization_calibrator calib;
+ * calib.calibrate(net, calibration_images);
+ * network<sequential> qnet;
+ * calib.convert(net, qnet);
+ * qnet.set_quantized_execution();
+ * calib.measure_drift(net, qnet, validation_images);
+ * calib.print_report(std::cout);
+ * @endcode
+ **/
+class quantization_calibrator {
+ public:
+    /**
+     * @param method     how ranges are derived from the recorded values
+     * @param percentile percentile of the per-sample maxima (and 100-p of the
+     *                   per-sample minima) used by calibration_method::percentile
+     **/
+    explicit quantization_calibrator(calibration_method method = calibration_method::min_max,
+                                     float_t percentile = float_t(99.9))
+        : method_(method), percentile_(percentile) {
+        if (percentile <= float_t(0) || percentile > float_t(100)) {
+            throw nn_error("percentile must be in (0, 100]");
+        }
+    }
+
+    /**
+     * record the activation ranges of each layer of net over inputs.
+     * the network is switched to plain float execution in the test phase.
+     **/
+    void calibrate(network<sequential>& net,
+                   const std::vector<vec_t>& inputs,
+                   size_t batch_size = 32) {
+        if (inputs.empty()) throw nn_error("empty calibration set");
+        if (batch_size == 0) batch_size = 1;
+
+        // intermediate activations must stay readable after each batch
+        net.set_inference_only(false);
+        net.set_quantized_execution(false);
+        net.set_netphase(net_phase::test);
+
+        const size_t n_layers = net.layer_size();
+        std::vector<extrema> in(n_layers), a(n_layers), out(n_layers);
+
+        std::vector<tensor_t> batch;
+        for (size_t begin = 0; begin < inputs.size(); begin += batch_size) {
+            const size_t end = std::min(inputs.size(), begin + batch_size);
+            batch.clear();
+            for (size_t i = begin; i < end; i++) {
+                batch.push_back(tensor_t{ inputs[i] });
+            }
+            net.predict(batch);
+
+            for (size_t i = 0; i < n_layers; i++) {
+                layer* l = net[i];
+                const std::vector<vector_type> types = l->out_types();
+                const std::vector<edgeptr_t> outputs = l->outputs();
+
+                record(*l->inputs()[0]->get_data(), &in[i]);
+                record(*outputs[0]->get_data(), &out[i]);
+                // feedforward layers keep the pre-activation values in out[1]
+                record(*outputs[types.size() > 1 &&
+                                types[1] == vector_type::aux ? 1 : 0]->get_data(),
+                       &a[i]);
+            }
+        }
+
+        layers_.assign(n_layers, layer_calibration());
+        for (size_t i = 0; i < n_layers; i++) {
+            core::quantization_ranges& r = layers_[i].ranges;
+            layers_[i].layer_type = net[i]->layer_type();
+            range_of(&in[i], &r.in_min, &r.in_max);
+            range_of(&a[i], &r.a_min, &r.a_max);
+            range_of(&out[i], &r.out_min, &r.out_max);
+            r.valid = true;
+        }
+    }
+
+    /**
+     * build the quantized equivalent of net into dst (which should be empty).
+     * layers without a quantized counterpart are copied as they are.
+     * requires a prior calibrate() on the same network.
+     **/
+    void convert(network<sequential>& net, network<sequential>& dst) {
+        if (layers_.size() != net.layer_size()) {
+            throw nn_error("network does not match the calibration");
+        }
+
+        for (size_t i = 0; i < net.layer_size(); i++) {
+            layer* l = net[i];
+            std::shared_ptr<layer> q =
+                detail::make_quantized_layer(*l, layers_[i].ranges);
+
+            layers_[i].quantized = static_cast<bool>(q);
+            if (q) {
+                std::vector<float_t> flat;
+                for (const vec_t* w : static_cast<const layer*>(l)->weights()) {
+                    flat.insert(flat.end(), w->begin(), w->end());
+                }
+                int idx = 0;
+                q->load(flat, idx);
+            } else {
+                q = detail::clone_layer(*l);
+            }
+            dst << q;
+        }
+    }
+
+    /**
+     * run inputs through both networks and record, for each layer, the
+     * largest and mean absolute difference of its outputs. the drift is
+     * cumulative: the quantized layer i runs on the quantized output of
+     * layer i-1. quantized is switched to per-layer execution for this.
+     **/
+    const std::vector<layer_calibration>& measure_drift(network<sequential>& net,
+                                                        network<sequential>& quantized,
+                                                        const std::vector<vec_t>& inputs,
+                                                        size_t batch_size = 32) {
+        const size_t n_layers = net.layer_size();
+        if (layers_.size() != n_layers || quantized.layer_size() != n_layers) {
+            throw nn_error("network does not match the calibration");
+        }
+        if (batch_size == 0) batch_size = 1;
+
+        // outputs of intermediate layers must be materialized in float
+        for (network<sequential>* n : { &net, &quantized }) {
+            n->set_inference_only(false);
+            n->set_quantized_execution(false);
+            n->set_netphase(net_phase::test);
+        }
+
+        std::vector<double> sum(n_layers, 0.0);
+        std::vector<size_t> count(n_layers, 0);
+        for (auto& c : layers_) c.max_error = c.mean_error = float_t(0);
+
+        std::vector<tensor_t> batch;
+        for (size_t begin = 0; begin < inputs.size(); begin += batch_size) {
+            const size_t end = std::min(inputs.size(), begin + batch_size);
+            batch.clear();
+            for (size_t i = begin; i < end; i++) {
+                batch.push_back(tensor_t{ inputs[i] });
+            }
+            net.predict(batch);
+            quantized.predict(batch);
+
+            for (size_t i = 0; i < n_layers; i++) {
+                const tensor_t& f = *net[i]->outputs()[0]->get_data();
+                const tensor_t& q = *quantized[i]->outputs()[0]->get_data();
+                for (size_t s = 0; s < f.size(); s++) {
+                    for (size_t k = 0; k < f[s].size(); k++) {
+                        const float_t d = std::abs(f[s][k] - q[s][k]);
+                        layers_[i].max_error = std::max(layers_[i].max_error, d);
+                        sum[i] += d;
+                    }
+                    count[i] += f[s].size();
+                }
+            }
+        }
+
+        for (size_t i = 0; i < n_layers; i++) {
+            if (count[i]) layers_[i].mean_error = static_cast<float_t>(sum[i] / count[i]);
+        }
+        return layers_;
+    }
+
+    /**
+     * per-layer calibration results, in layer order
+     **/
+    const std::vector<layer_calibration>& layers() const {
+        return layers_;
+    }
+
+    void print_report(std::ostream& os) const {
+        os << std::setw(4) << "#" << std::setw(18) << "layer"
+           << std::setw(6) << "q"
+           << std::setw(24) << "input range"
+           << std::setw(24) << "output range"
+           << std::setw(12) << "max err"
+           << std::setw(12) << "mean err" << "\n";
+
+        for (size_t i = 0; i < layers_.size(); i++) {
+            const layer_calibration& c = layers_[i];
+            os << std::setw(4) << i << std::setw(18) << c.layer_type
+               << std::setw(6) << (c.quantized ? "yes" : "no")
+               << std::setw(24) << range_str(c.ranges.in_min, c.ranges.in_max)
+               << std::setw(24) << range_str(c.ranges.out_min, c.ranges.out_max)
+               << std::setw(12) << c.max_error
+               << std::setw(12) << c.mean_error << "\n";
+        }
+    }
+
+ private:
+    // per-sample minimum and maximum of one tensor
+    struct extrema {
+        std::vector<float_t> mins;
+        std::vector<float_t> maxs;
+    };
+
+    static void record(const tensor_t& t, extrema* e) {
+        for (const vec_t& v : t) {
+            if (v.empty()) continue;
+            auto mm = std::minmax_element(v.begin(), v.end());
+            e->mins.push_back(*mm.first);
+            e->maxs.push_back(*mm.second);
+        }
+    }
+
+    void range_of(extrema* e, float_t* min_value, float_t* max_value) const {
+        if (e->mins.empty()) {
+            *min_value = *max_value = float_t(0);
+        } else if (method_ == calibration_method::min_max) {
+            *min_value = *std::min_element(e->mins.begin(), e->mins.end());
+            *max_value = *std::max_element(e->maxs.begin(), e->maxs.end());
+        } else {
+            *min_value = nth(&e->mins, float_t(100) - percentile_);
+            *max_value = nth(&e->maxs, percentile_);
+        }
+        core::kernels::quantized_range_with_zero(min_value, max_value);
+    }
+
+    static float_t nth(std::vector<float_t>* v, float_t p) {
+        const size_t k = std::min(v->size() - 1, static_cast<size_t>(
+            p / float_t(100) * static_cast<float_t>(v->size() - 1) + float_t(0.5)));
+        std::nth_element(v->begin(), v->begin() + k, v->end());
+        return (*v)[k];
+    }
+
+    static std::string range_str(float_t min_value, float_t max_value) {
+        std::ostringstream ss;
+        ss << "[" << min_value << ", " << max_value << "]";
+        return ss.str();
+    }
+
+    calibration_method method_;
+    float_t percentile_;
+    std::vector<layer_calibration> layers_;
+};
+
+}  // namespace tiny_dnn
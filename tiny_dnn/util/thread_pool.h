@@ -0,0 +1,322 @@
+/*
+    Copyright (c) 2016, Taiga Nomi
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+#include <algorithm>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <exception>
+#include <condition_variable>
+#include "tiny_dnn/config.h"
+
+namespace tiny_dnn {
+
+/**
+ * process-wide pool of persistent worker threads, used as the default
+ * (non-TBB/OMP) backend of parallel_for.
+ *
+ * each worker owns a deque of range-tasks. a worker pops from the back of
+ * its own deque and steals from the front of the others when it runs dry.
+ * the deques are ring buffers which only grow, so once warmed up scheduling
+ * a parallel_for doesn't allocate.
+ * the thread which calls run() never blocks: it executes pending tasks until
+ * its own job is finished, so nested parallel_for calls can not deadlock.
+ *
+ * the number of threads (including the calling thread) is taken from
+ * CNN_THREAD_POOL_SIZE, or from std::thread::hardware_concurrency() if it is 0,
+ * and can be changed at runtime by resize().
+ **/
+class thread_pool {
+ public:
+    static thread_pool& instance() {
+        static thread_pool pool(CNN_THREAD_POOL_SIZE);
+        return pool;
+    }
+
+    ~thread_pool() {
+        stop();
+    }
+
+    /**
+     * number of threads which execute tasks, including the calling thread
+     **/
+    size_t num_threads() const {
+        return queues_.size() + 1;
+    }
+
+    /**
+     * change the number of threads (including the calling thread).
+     * 0 means std::thread::hardware_concurrency().
+     * must not be called while parallel_for is running.
+     **/
+    void resize(size_t num_threads) {
+        stop();
+        start(num_threads);
+    }
+
+    /**
+     * split [begin, end) into chunks of at least grainsize iterations and
+     * execute f(begin_of_chunk, end_of_chunk) for each of them.
+     * returns after all chunks have been executed, and rethrows the first
+     * exception thrown by f.
+     **/
+    template <typename Func>
+    void run(int begin, int end, int grainsize, const Func& f) {
+        if (end <= begin) return;
+
+        const int total = end - begin;
+        // ranges smaller than the grain are still split, like tbb does
+        if (grainsize <= 0 || total <= grainsize) grainsize = 1;
+
+        // a few more tasks than threads, to give stealing room for balancing
+        const int max_tasks = static_cast<int>(num_threads()) * 4;
+        int chunk = (total + max_tasks - 1) / max_tasks;
+        if (chunk < grainsize) chunk = grainsize;
+        const int num_tasks = (total + chunk - 1) / chunk;
+
+        if (num_tasks == 1 || queues_.empty()) {
+            f(begin, end);
+            return;
+        }
+
+        job j;
+        j.func = &f;
+        j.invoke = [](const void* func, int b, int e) {
+            (*static_cast<const Func*>(func))(b, e);
+        };
+        j.remaining = num_tasks;
+
+        push_tasks(&j, begin, end, chunk);
+
+        // help until every chunk of our job is done
+        while (j.remaining.load(std::memory_order_acquire) > 0) {
+            task t;
+            if (try_pop(&t)) {
+                execute(t);
+            } else {
+                std::this_thread::yield();
+            }
+        }
+
+        if (j.error) std::rethrow_exception(j.error);
+    }
+
+ private:
+    struct job {
+        void (*invoke)(const void*, int, int);
+        const void* func;
+        std::atomic<int> remaining;
+        std::mutex error_mutex;
+        std::exception_ptr error;
+    };
+
+    struct task {
+        job* owner;
+        int begin;
+        int end;
+    };
+
+    // double-ended queue of tasks in a ring buffer of power-of-two size
+    class task_ring {
+     public:
+        task_ring() : buf_(64), head_(0), size_(0) {}
+
+        bool empty() const { return size_ == 0; }
+
+        void push_back(const task& t) {
+            if (size_ == buf_.size()) grow();
+            buf_[(head_ + size_) & (buf_.size() - 1)] = t;
+            size_++;
+        }
+
+        task pop_back() {
+            size_--;
+            return buf_[(head_ + size_) & (buf_.size() - 1)];
+        }
+
+        task pop_front() {
+            const task t = buf_[head_];
+            head_ = (head_ + 1) & (buf_.size() - 1);
+            size_--;
+            return t;
+        }
+
+     private:
+        void grow() {
+            std::vector<task> bigger(buf_.size() * 2);
+            for (size_t i = 0; i < size_; i++) {
+                bigger[i] = buf_[(head_ + i) & (buf_.size() - 1)];
+            }
+            buf_.swap(bigger);
+            head_ = 0;
+        }
+
+        std::vector<task> buf_;
+        size_t head_;
+        size_t size_;
+    };
+
+    struct task_queue {
+        std::mutex mutex;
+        task_ring tasks;
+    };
+
+    explicit thread_pool(size_t num_threads) : queued_(0), stop_(false) {
+        start(num_threads);
+    }
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator = (const thread_pool&) = delete;
+
+    // index of the worker running on this thread, -1 for non-worker threads
+    static int& worker_index() {
+        static thread_local int index = -1;
+        return index;
+    }
+
+    void start(size_t num_threads) {
+        if (num_threads == 0) num_threads = std::thread::hardware_concurrency();
+        if (num_threads == 0) num_threads = 1;
+
+        stop_ = false;
+        queued_ = 0;
+        queues_.clear();
+        for (size_t i = 0; i + 1 < num_threads; i++) {
+            queues_.emplace_back(new task_queue());
+        }
+        for (size_t i = 0; i + 1 < num_threads; i++) {
+            workers_.emplace_back([this, i]() { worker_loop(static_cast<int>(i)); });
+        }
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex_);
+            stop_ = true;
+        }
+        wakeup_.notify_all();
+        for (auto& w : workers_) w.join();
+        workers_.clear();
+    }
+
+    void worker_loop(int index) {
+        worker_index() = index;
+
+        for (;;) {
+            task t;
+            if (try_pop(&t)) {
+                execute(t);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleep_mutex_);
+            wakeup_.wait(lock, [this]() {
+                return stop_ || queued_.load(std::memory_order_acquire) > 0;
+            });
+            if (stop_) return;
+        }
+    }
+
+    void push_tasks(job* j, int begin, int end, int chunk) {
+        const int self = worker_index();
+        const size_t n = queues_.size();
+        size_t count = 0;
+
+        if (self >= 0) {
+            // nested call: keep the tasks local, idle workers will steal them
+            task_queue& q = *queues_[self];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            for (int b = begin; b < end; b += chunk, count++) {
+                q.tasks.push_back(task{ j, b, std::min(b + chunk, end) });
+            }
+        } else {
+            // external call: deal the tasks out to all workers
+            for (int b = begin; b < end; b += chunk, count++) {
+                task_queue& q = *queues_[count % n];
+                std::lock_guard<std::mutex> lock(q.mutex);
+                q.tasks.push_back(task{ j, b, std::min(b + chunk, end) });
+            }
+        }
+
+        queued_.fetch_add(static_cast<int>(count), std::memory_order_release);
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex_);
+        }
+        wakeup_.notify_all();
+    }
+
+    bool try_pop(task* t) {
+        const int self = worker_index();
+        const size_t n = queues_.size();
+
+        // newest task from our own deque first (hot in cache)
+        if (self >= 0) {
+            task_queue& q = *queues_[self];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if (!q.tasks.empty()) {
+                *t = q.tasks.pop_back();
+                queued_.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+
+        // then steal the oldest task of somebody else
+        const size_t start = self >= 0 ? static_cast<size_t>(self) + 1 : 0;
+        for (size_t k = 0; k < n; k++) {
+            task_queue& q = *queues_[(start + k) % n];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if (!q.tasks.empty()) {
+                *t = q.tasks.pop_front();
+                queued_.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void execute(const task& t) {
+        job* j = t.owner;
+        try {
+            j->invoke(j->func, t.begin, t.end);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(j->error_mutex);
+            if (!j->error) j->error = std::current_exception();
+        }
+        // the job may be destroyed right after this line
+        j->remaining.fetch_sub(1, std::memory_order_release);
+    }
+
+    std::vector<std::unique_ptr<task_queue>> queues_;
+    std::vector<std::thread> workers_;
+    std::atomic<int> queued_;
+    std::mutex sleep_mutex_;
+    std::condition_variable wakeup_;
+    bool stop_;
+};
+
+}  // namespace tiny_dnn
@@ -70,6 +70,20 @@ typedef std::vector<float_t, aligned_allocator<float_t, 64>> vec_t;
 
 typedef std::vector<vec_t> tensor_t;
 
+/**
+ * uint8 activations of one sample, together with the float range they
+ * encode. used between quantized layers (see layer::forward_quantized).
+ **/
+struct quantized_vec {
+    quantized_vec() : min(0), max(0) {}
+
+    std::vector<uint8_t> data;
+    float_t min;
+    float_t max;
+};
+
+typedef std::vector<quantized_vec> quantized_tensor;
+
 enum class net_phase {
     train,
     test
@@ -0,0 +1,192 @@
+/*
+    Copyright (c) 2016, Taiga Nomi
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+    names of its contributors may be used to endorse or promote products
+    derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+#include <cmath>
+#include <cstddef>
+
+#include "tiny_dnn/util/cpu_features.h"
+
+// elementwise transcendental functions over spans, used by the activation
+// functions. float spans are processed 8 elements at a time when AVX is
+// enabled (or, with runtime dispatch, supported by the cpu); the polynomial approximations (from Cephes) stay within a few
+// ulp of std::exp / std::tanh, inputs beyond the float range saturate.
+// other types fall back to the standard library.
+
+namespace vectorize {
+namespace detail {
+
+#if defined(CNN_USE_AVX) || defined(CNN_MULTIVERSION)
+
+CNN_TARGET_PUSH("avx")
+
+inline __m256 exp_ps(__m256 x) {
+    // exp(x) = 2^n * exp(r), r = x - n * ln2 in [-ln2/2, ln2/2]
+    x = _mm256_min_ps(x, _mm256_set1_ps(88.7228391f));
+    x = _mm256_max_ps(x, _mm256_set1_ps(-87.3365447f));
+
+    __m256 fx = _mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(1.44269504088896341f)),
+                              _mm256_set1_ps(0.5f));
+    fx = _mm256_floor_ps(fx);
+
+    // ln2 split in two so that the reduction is exact
+    x = _mm256_sub_ps(x, _mm256_mul_ps(fx, _mm256_set1_ps(0.693359375f)));
+    x = _mm256_sub_ps(x, _mm256_mul_ps(fx, _mm256_set1_ps(-2.12194440e-4f)));
+
+    const __m256 z = _mm256_mul_ps(x, x);
+    __m256 y = _mm256_set1_ps(1.9875691500e-4f);
+    y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(1.3981999507e-3f));
+    y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(8.3334519073e-3f));
+    y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(4.1665795894e-2f));
+    y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(1.6666665459e-1f));
+    y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(5.0000001201e-1f));
+    y = _mm256_add_ps(_mm256_mul_ps(y, z), x);
+    y = _mm256_add_ps(y, _mm256_set1_ps(1.0f));
+
+    // 2^(n-1) built in the exponent field (AVX has no 256-bit integer ops),
+    // doubled afterwards so that n = 128 does not overflow the exponent
+    const __m256i n = _mm256_cvttps_epi32(fx);
+    const __m128i bias = _mm_set1_epi32(126);
+    __m128i lo = _mm_slli_epi32(_mm_add_epi32(_mm256_castsi256_si128(n), bias), 23);
+    __m128i hi = _mm_slli_epi32(_mm_add_epi32(_mm256_extractf128_si256(n, 1), bias), 23);
+    const __m256 pow2n = _mm256_castsi256_ps(
+        _mm256_insertf128_si256(_mm256_castsi128_si256(lo), hi, 1));
+
+    return _mm256_mul_ps(_mm256_mul_ps(y, pow2n), _mm256_set1_ps(2.0f));
+}
+
+inline __m256 tanh_ps(__m256 x) {
+    const __m256 sign_mask = _mm256_set1_ps(-0.0f);
+    const __m256 ax = _mm256_andnot_ps(sign_mask, x);
+
+    // |x| < 0.625: odd polynomial
+    const __m256 z = _mm256_mul_ps(x, x);
+    __m256 p = _mm256_set1_ps(-5.70498872745e-3f);
+    p = _mm256_add_ps(_mm256_mul_ps(p, z), _mm256_set1_ps(2.06390887954e-2f));
+    p = _mm256_add_ps(_mm256_mul_ps(p, z), _mm256_set1_ps(-5.37397155531e-2f));
+    p = _mm256_add_ps(_mm256_mul_ps(p, z), _mm256_set1_ps(1.33314422036e-1f));
+    p = _mm256_add_ps(_mm256_mul_ps(p, z), _mm256_set1_ps(-3.33332819422e-1f));
+    p = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(p, z), x), x);
+
+    // otherwise: 1 - 2 / (exp(2|x|) + 1), with the sign of x
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 e = exp_ps(_mm256_add_ps(ax, ax));
+    __m256 r = _mm256_sub_ps(one, _mm256_div_ps(_mm256_set1_ps(2.0f),
+                                                _mm256_add_ps(e, one)));
+    r = _mm256_or_ps(r, _mm256_and_ps(sign_mask, x));
+
+    const __m256 small = _mm256_cmp_ps(ax, _mm256_set1_ps(0.625f), _CMP_LT_OQ);
+    return _mm256_blendv_ps(r, p, small);
+}
+
+inline __m256 sigmoid_ps(__m256 x) {
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 e = exp_ps(_mm256_sub_ps(_mm256_setzero_ps(), x));
+    return _mm256_div_ps(one, _mm256_add_ps(one, e));
+}
+
+inline void exp_avx(const float* src, std::size_t size, float* dst) {
+    std::size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        _mm256_storeu_ps(dst + i, exp_ps(_mm256_loadu_ps(src + i)));
+    }
+    for (; i < size; i++) dst[i] = std::exp(src[i]);
+}
+
+inline void tanh_avx(const float* src, std::size_t size, float* dst) {
+    std::size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        _mm256_storeu_ps(dst + i, tanh_ps(_mm256_loadu_ps(src + i)));
+    }
+    for (; i < size; i++) dst[i] = std::tanh(src[i]);
+}
+
+inline void sigmoid_avx(const float* src, std::size_t size, float* dst) {
+    std::size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        _mm256_storeu_ps(dst + i, sigmoid_ps(_mm256_loadu_ps(src + i)));
+    }
+    for (; i < size; i++) dst[i] = 1.0f / (1.0f + std::exp(-src[i]));
+}
+
+CNN_TARGET_POP
+
+#endif  // CNN_USE_AVX || CNN_MULTIVERSION
+
+}  // namespace detail
+
+/// dst[i] = exp(src[i]), src and dst may alias
+template <typename T>
+void exp(const T* src, std::size_t size, T* dst) {
+    for (std::size_t i = 0; i < size; i++) dst[i] = std::exp(src[i]);
+}
+
+/// dst[i] = tanh(src[i]), src and dst may alias
+template <typename T>
+void tanh(const T* src, std::size_t size, T* dst) {
+    for (std::size_t i = 0; i < size; i++) dst[i] = std::tanh(src[i]);
+}
+
+/// dst[i] = 1 / (1 + exp(-src[i])), src and dst may alias
+template <typename T>
+void sigmoid(const T* src, std::size_t size, T* dst) {
+    for (std::size_t i = 0; i < size; i++) {
+        dst[i] = T(1) / (T(1) + std::exp(-src[i]));
+    }
+}
+
+#if defined(CNN_USE_AVX) || defined(CNN_MULTIVERSION)
+
+template <>
+inline void exp<float>(const float* src, std::size_t size, float* dst) {
+    if (tiny_dnn::use_isa(tiny_dnn::cpu_isa::avx)) {
+        detail::exp_avx(src, size, dst);
+        return;
+    }
+    for (std::size_t i = 0; i < size; i++) dst[i] = std::exp(src[i]);
+}
+
+template <>
+inline void tanh<float>(const float* src, std::size_t size, float* dst) {
+    if (tiny_dnn::use_isa(tiny_dnn::cpu_isa::avx)) {
+        detail::tanh_avx(src, size, dst);
+        return;
+    }
+    for (std::size_t i = 0; i < size; i++) dst[i] = std::tanh(src[i]);
+}
+
+template <>
+inline void sigmoid<float>(const float* src, std::size_t size, float* dst) {
+    if (tiny_dnn::use_isa(tiny_dnn::cpu_isa::avx)) {
+        detail::sigmoid_avx(src, size, dst);
+        return;
+    }
+    for (std::size_t i = 0; i < size; i++) dst[i] = 1.0f / (1.0f + std::exp(-src[i]));
+}
+
+#endif  // CNN_USE_AVX || CNN_MULTIVERSION
+
+}  // namespace vectorize